@@ -0,0 +1,91 @@
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+
+// External headers
+#include <stdlib.h>
+
+// Internal headers
+#include "adaptive.h"
+
+adaptive* init_adaptive(arena* a, uint64_t window_ns, uint64_t high, uint64_t low, uint64_t now) {
+    adaptive* ad = (adaptive*) arena_malloc(a, sizeof(adaptive));
+    if (ad == NULL) {
+        fprintf(stderr, "Failed to allocate adaptive state\n");
+        return NULL;
+    }
+    ad->arena = a;
+    atomic_init(&ad->serial, false);
+    ad->window_ns = window_ns;
+    ad->high = high;
+    ad->low = low < high ? low : high;
+    ad->created_ns = now;
+    ad->window_start = now;
+    ad->commits = 0;
+    ad->aborts = 0;
+    ad->probing = false;
+    ad->hold = ADAPTIVE_HOLD_MIN;
+    ad->held = 0;
+    ad->nb_switches = 0;
+    return ad;
+}
+
+void destroy_adaptive(adaptive* ad) {
+    if (ad == NULL) return;
+    arena_free(ad->arena, ad);
+}
+
+static void switch_mode(adaptive* ad, uint64_t now, uint64_t epoch, bool to_serial) {
+    ad->log[ad->nb_switches++ % ADAPTIVE_LOG_SIZE] = (mode_switch) {
+        .at_ns = now - ad->created_ns,
+        .epoch = epoch,
+        .to_serial = to_serial,
+        .commits = ad->commits,
+        .aborts = ad->aborts,
+        .window_ns = now - ad->window_start,
+    };
+    atomic_store_explicit(&ad->serial, to_serial, memory_order_relaxed);
+    ad->held = 0;
+}
+
+void adaptive_end_epoch(adaptive* ad, uint64_t now, uint64_t epoch, uint64_t commits, uint64_t aborts) {
+    ad->commits += commits;
+    ad->aborts += aborts;
+    uint64_t total = ad->commits + ad->aborts;
+    if (now - ad->window_start < ad->window_ns || total < ADAPTIVE_MIN_SAMPLES)
+        return;
+
+    uint64_t ratio = 100 * ad->aborts / total;
+    if (adaptive_serial(ad)) {
+        if (++ad->held >= ad->hold) {
+            switch_mode(ad, now, epoch, false);
+            ad->probing = true;
+        }
+    } else if (ad->probing) {
+        ad->probing = false;
+        if (ratio >= ad->low) { // Still contended: back to serial, for longer
+            ad->hold = 2 * ad->hold < ADAPTIVE_HOLD_MAX ? 2 * ad->hold : ADAPTIVE_HOLD_MAX;
+            switch_mode(ad, now, epoch, true);
+        } else {
+            ad->hold = ADAPTIVE_HOLD_MIN;
+        }
+    } else if (ratio >= ad->high) {
+        switch_mode(ad, now, epoch, true);
+    }
+    ad->window_start = now;
+    ad->commits = 0;
+    ad->aborts = 0;
+}
+
+void print_adaptive_log(adaptive* ad, FILE* stream) {
+    fprintf(stream, "###### Mode switches ######\n");
+    fprintf(stream, "Switches: %lu, now in %s mode\n", (unsigned long) ad->nb_switches, adaptive_serial(ad) ? "serial" : "batcher");
+    uint64_t first = ad->nb_switches > ADAPTIVE_LOG_SIZE ? ad->nb_switches - ADAPTIVE_LOG_SIZE : 0;
+    for (uint64_t i = first; i < ad->nb_switches; i++) {
+        mode_switch* sw = &ad->log[i % ADAPTIVE_LOG_SIZE];
+        uint64_t total = sw->commits + sw->aborts;
+        fprintf(stream, "    - %10.3f ms, epoch %lu: %s (%lu/%lu aborted over %.3f ms)\n", sw->at_ns / 1e6, (unsigned long) sw->epoch,
+            sw->to_serial ? "batcher -> serial" : "serial -> batcher", (unsigned long) sw->aborts, (unsigned long) total, sw->window_ns / 1e6);
+    }
+    fprintf(stream, "###########################\n");
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+
+// Minimum number of read-write transactions in a window before deciding on it (the window is extended otherwise)
+#define ADAPTIVE_MIN_SAMPLES 16
+// Number of windows spent in serial mode before trying the batcher mode again, at first and at most
+#define ADAPTIVE_HOLD_MIN    2
+#define ADAPTIVE_HOLD_MAX    8
+// Number of switches kept in the log
+#define ADAPTIVE_LOG_SIZE    64
+
+/**
+ * @brief Switch between the batcher and the serial modes.
+ */
+typedef struct mode_switch {
+    uint64_t at_ns;                     // Time since the region was created
+    uint64_t epoch;
+    bool to_serial;
+    uint64_t commits;                   // Read-write transactions of the window that led to the switch
+    uint64_t aborts;
+    uint64_t window_ns;
+} mode_switch;
+
+/**
+ * @brief Adaptive choice, at epoch boundaries, between the batcher mode and a serial mode
+ * in which every transaction runs in an epoch of its own.
+ *
+ * The abort ratio of the read-write transactions is sampled per window. The batcher mode
+ * switches to serial when it reaches the high threshold. Since nothing aborts in serial mode,
+ * the batcher mode is tried again after a hold, and kept only if its first window stays
+ * under the low threshold; otherwise the hold doubles, up to ADAPTIVE_HOLD_MAX windows.
+ */
+typedef struct adaptive {
+    arena* arena;                       // Arena the state is allocated in, NULL if private
+    atomic_bool serial;                 // Current mode, read when transactions begin
+    uint64_t window_ns;
+    uint64_t high;                      // Abort ratio thresholds (in percent)
+    uint64_t low;
+    uint64_t created_ns;
+    uint64_t window_start;
+    uint64_t commits;                   // Read-write transactions of the current window
+    uint64_t aborts;
+    bool probing;                       // First window in batcher mode after serial mode
+    uint64_t hold;                      // Windows to spend in serial mode
+    uint64_t held;
+    uint64_t nb_switches;
+    mode_switch log[ADAPTIVE_LOG_SIZE]; // Most recent switches, indexed by 'nb_switches' modulo the size
+} adaptive;
+
+/** Create the adaptive state of a region, starting in batcher mode.
+ * @param a         Arena to allocate the state in, NULL for the C allocator
+ * @param window_ns Length of a sampling window
+ * @param high      Abort ratio (in percent) from which the batcher mode switches to serial
+ * @param low       Abort ratio (in percent) under which a return to the batcher mode is kept
+ * @param now       Current time (in ns)
+ * @return Adaptive state, NULL on failure
+**/
+adaptive* init_adaptive(arena* a, uint64_t window_ns, uint64_t high, uint64_t low, uint64_t now);
+void destroy_adaptive(adaptive* ad);
+
+/** Whether transactions beginning now run in serial mode.
+ * @param ad Adaptive state
+ * @return Whether the region is in serial mode
+**/
+static inline bool adaptive_serial(adaptive* ad) {
+    return atomic_load_explicit(&ad->serial, memory_order_relaxed);
+}
+
+/** Account for the read-write transactions of an epoch, and switch modes at the end of a window. Called during the end of epoch.
+ * @param ad      Adaptive state
+ * @param now     Current time (in ns)
+ * @param epoch   Epoch ending
+ * @param commits Read-write transactions that committed in the epoch
+ * @param aborts  Read-write transactions that aborted in the epoch
+**/
+void adaptive_end_epoch(adaptive* ad, uint64_t now, uint64_t epoch, uint64_t commits, uint64_t aborts);
+
+/** Print the log of switches.
+ * @param ad     Adaptive state
+ * @param stream Output stream
+**/
+void print_adaptive_log(adaptive* ad, FILE* stream);
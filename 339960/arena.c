@@ -0,0 +1,253 @@
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+
+// External headers
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Internal headers
+#include "arena.h"
+#include "macros.h"
+
+#define ARENA_MAGIC  UINT64_C(0x64766172656e6131)
+// Alignment of the blocks carved from the end of the allocated part
+#define ARENA_ALIGN  64
+// Mapping addresses tried first, one per 4 GiB slot chosen by the name, away from where the kernel maps by default
+#define ARENA_HINT_BASE  UINT64_C(0x200000000000)
+#define ARENA_HINT_SLOTS 8192
+
+/**
+ * @brief Header right before every allocated block, to find its size class and the start of the block.
+ */
+typedef struct block_header {
+    uint32_t size_class;
+    uint32_t shift;                     // Distance from the start of the block to the header
+    uint64_t padding;
+} block_header;
+
+static void* hint_address(char const* name) {
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    for (char const* c = name; *c != '\0'; c++)
+        hash = (hash ^ (uint8_t) *c) * UINT64_C(0x100000001b3);
+    return (void*) (uintptr_t) (ARENA_HINT_BASE + ((hash % ARENA_HINT_SLOTS) << 32));
+}
+
+/**
+ * @brief Opens the shared memory object or the file of an arena.
+ * @return File descriptor, -1 on failure
+ */
+static int open_object(char const* name, int flags, bool file) {
+    int fd = file ? open(name, flags, 0600) : shm_open(name, flags, 0600);
+    if (fd < 0)
+        perror(name);
+    return fd;
+}
+
+static void remove_object(char const* name, bool file) {
+    if (file)
+        unlink(name);
+    else
+        shm_unlink(name);
+}
+
+arena* create_arena(char const* name, size_t capacity, bool file) {
+    if (strlen(name) >= sizeof(((arena*) NULL)->name) || capacity < 2 * sizeof(arena)) {
+        fprintf(stderr, "Invalid name or capacity for shared memory object\n");
+        return NULL;
+    }
+    int fd = open_object(name, O_CREAT | O_EXCL | O_RDWR, file);
+    if (fd < 0)
+        return NULL;
+    if (ftruncate(fd, (off_t) capacity) != 0) {
+        perror("ftruncate");
+        close(fd);
+        remove_object(name, file);
+        return NULL;
+    }
+    void* base = mmap(hint_address(name), capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    if (base == MAP_FAILED)
+        base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        remove_object(name, file);
+        return NULL;
+    }
+
+    arena* a = (arena*) base;
+    a->base = base;
+    a->capacity = capacity;
+    a->top = (sizeof(arena) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    memset(a->free_lists, 0, sizeof(a->free_lists));
+    a->root = NULL;
+    a->file = file;
+    strcpy(a->name, name);
+    if (!arena_init_mutex(a, &a->lock)) {
+        fprintf(stderr, "Failed to initialize mutex for arena\n");
+        munmap(base, capacity);
+        remove_object(name, file);
+        return NULL;
+    }
+    __atomic_store_n(&a->magic, ARENA_MAGIC, __ATOMIC_RELEASE);
+    return a;
+}
+
+arena* attach_arena(char const* name, bool file) {
+    int fd = open_object(name, O_RDWR, file);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    arena* header = NULL;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(arena))
+        header = (arena*) mmap(NULL, sizeof(arena), PROT_READ, MAP_SHARED, fd, 0);
+    if (header == NULL || header == MAP_FAILED || __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != ARENA_MAGIC) {
+        fprintf(stderr, "'%s' is not an initialized shared region\n", name);
+        if (header != NULL && header != MAP_FAILED)
+            munmap(header, sizeof(arena));
+        close(fd);
+        return NULL;
+    }
+    void* base = header->base;
+    size_t capacity = header->capacity;
+    munmap(header, sizeof(arena));
+
+    void* mapped = mmap(base, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    close(fd);
+    if (mapped != base) {
+        fprintf(stderr, "Address %p of shared region '%s' is not available in this process\n", base, name);
+        if (mapped != MAP_FAILED)
+            munmap(mapped, capacity);
+        return NULL;
+    }
+    return (arena*) base;
+}
+
+void sync_arena(arena* a) {
+    if (a->file)
+        msync(a->base, a->top, MS_SYNC);
+}
+
+void detach_arena(arena* a) {
+    munmap(a->base, a->capacity);
+}
+
+void destroy_arena(arena* a) {
+    char name[sizeof(a->name)];
+    bool file = a->file;
+    strcpy(name, a->name);
+    pthread_mutex_destroy(&a->lock);
+    munmap(a->base, a->capacity);
+    remove_object(name, file);
+}
+
+bool arena_init_mutex(arena* a, pthread_mutex_t* lock) {
+    if (a == NULL)
+        return pthread_mutex_init(lock, NULL) == 0;
+    pthread_mutexattr_t attr;
+    if (pthread_mutexattr_init(&attr) != 0)
+        return false;
+    bool success = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 && pthread_mutex_init(lock, &attr) == 0;
+    pthread_mutexattr_destroy(&attr);
+    return success;
+}
+
+/**
+ * @brief Takes a block of the given size class, from its free list or from the end of the allocated part.
+ * @return The block, NULL if the arena is full
+ */
+static uint8_t* take_block(arena* a, uint32_t size_class) {
+    pthread_mutex_lock(&a->lock);
+    uint8_t* block = (uint8_t*) a->free_lists[size_class];
+    if (block != NULL) {
+        a->free_lists[size_class] = *(void**) block;
+    } else if (a->capacity - a->top >= (size_t) 1 << size_class) {
+        block = (uint8_t*) a->base + a->top;
+        a->top += (((size_t) 1 << size_class) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    }
+    pthread_mutex_unlock(&a->lock);
+    return block;
+}
+
+void* arena_memalign(arena* a, size_t align, size_t size) {
+    if (a == NULL) {
+        void* ptr;
+        return posix_memalign(&ptr, align < sizeof(void*) ? sizeof(void*) : align, size) == 0 ? ptr : NULL;
+    }
+    if (align < sizeof(block_header))
+        align = sizeof(block_header);
+    size_t need = sizeof(block_header) + size + (align > sizeof(block_header) ? align - 1 : 0);
+    uint32_t size_class = ARENA_MIN_CLASS;
+    while (size_class < ARENA_CLASSES && ((size_t) 1 << size_class) < need)
+        size_class++;
+    if (unlikely(size_class == ARENA_CLASSES))
+        return NULL;
+    uint8_t* block = take_block(a, size_class);
+    if (unlikely(block == NULL))
+        return NULL;
+    uintptr_t user = ((uintptr_t) block + sizeof(block_header) + align - 1) & ~(uintptr_t) (align - 1);
+    block_header* header = (block_header*) user - 1;
+    header->size_class = size_class;
+    header->shift = (uint32_t) ((uint8_t*) header - block);
+    return (void*) user;
+}
+
+void* arena_malloc(arena* a, size_t size) {
+    if (a == NULL)
+        return malloc(size);
+    return arena_memalign(a, sizeof(block_header), size);
+}
+
+void* arena_calloc(arena* a, size_t nb, size_t size) {
+    if (a == NULL)
+        return calloc(nb, size);
+    void* ptr = arena_malloc(a, nb * size);
+    if (ptr != NULL)
+        memset(ptr, 0, nb * size);
+    return ptr;
+}
+
+/**
+ * @brief Usable size of a block allocated in an arena.
+ */
+static size_t block_capacity(void* ptr) {
+    block_header* header = (block_header*) ptr - 1;
+    return ((size_t) 1 << header->size_class) - header->shift - sizeof(block_header);
+}
+
+void* arena_realloc(arena* a, void* ptr, size_t size) {
+    if (a == NULL)
+        return realloc(ptr, size);
+    if (ptr == NULL)
+        return arena_malloc(a, size);
+    size_t capacity = block_capacity(ptr);
+    if (size <= capacity)
+        return ptr;
+    void* grown = arena_malloc(a, size);
+    if (unlikely(grown == NULL))
+        return NULL;
+    memcpy(grown, ptr, capacity);
+    arena_free(a, ptr);
+    return grown;
+}
+
+void arena_free(arena* a, void* ptr) {
+    if (a == NULL) {
+        free(ptr);
+        return;
+    }
+    if (ptr == NULL)
+        return;
+    block_header* header = (block_header*) ptr - 1;
+    uint8_t* block = (uint8_t*) header - header->shift;
+    uint32_t size_class = header->size_class;
+    pthread_mutex_lock(&a->lock);
+    *(void**) block = a->free_lists[size_class];
+    a->free_lists[size_class] = block;
+    pthread_mutex_unlock(&a->lock);
+}
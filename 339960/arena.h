@@ -0,0 +1,83 @@
+#pragma once
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Size classes of the allocator: blocks of 2^ARENA_MIN_CLASS to 2^(ARENA_CLASSES - 1) bytes
+#define ARENA_MIN_CLASS 5
+#define ARENA_CLASSES   48
+
+/**
+ * @brief Allocator over a named POSIX shared memory object or a file, mapped at the same address in every process using it.
+ *
+ * The arena header is the start of the mapping. Blocks are powers of two, carved from
+ * the end of the allocated part and recycled through one free list per size class.
+ * Every structure allocated in the arena can be used from all the processes that mapped
+ * it, so that they run transactions on the same region without copying data between them.
+ * An arena over a file keeps its content when unmapped, so that a later process can map it again.
+ * The functions taking an arena fall back to the C allocator when it is NULL.
+ */
+typedef struct arena {
+    uint64_t magic;
+    void* base;                         // Address of the mapping in every process
+    size_t capacity;                    // Size of the object (in bytes)
+    pthread_mutex_t lock;               // Process-shared, protects the allocation state
+    size_t top;                         // Offset of the first byte never allocated
+    void* free_lists[ARENA_CLASSES];    // Free blocks of each size class, linked through their first word
+    void* root;                         // Structure other processes start from when attaching
+    bool file;                          // Whether the name is the path of a file rather than a shared memory object
+    char name[PATH_MAX];                // Name of the object
+} arena;
+
+/** Create a named shared memory object or a file and map it as an arena.
+ * @param name     Name of the object (as for 'shm_open') or path of the file, which must not exist
+ * @param capacity Size of the object (in bytes)
+ * @param file     Whether to create a file rather than a shared memory object
+ * @return The arena, NULL on failure
+**/
+arena* create_arena(char const* name, size_t capacity, bool file);
+
+/** Map an arena created by another process, at the address it has there.
+ * @param name Name of the object or path of the file
+ * @param file Whether the arena is a file rather than a shared memory object
+ * @return The arena, NULL on failure (including if the address is taken in this process)
+**/
+arena* attach_arena(char const* name, bool file);
+
+/** Write the allocated part of an arena over a file back to the file.
+ * @param a Arena
+**/
+void sync_arena(arena* a);
+
+/** Unmap an arena from the calling process. The object and its content are kept.
+ * @param a Arena
+**/
+void detach_arena(arena* a);
+
+/** Unmap an arena and remove its object or file. No other process must use it anymore.
+ * @param a Arena
+**/
+void destroy_arena(arena* a);
+
+/** Initialize a mutex usable from every process mapping the arena (a private mutex if it is NULL).
+ * @param a    Arena holding the mutex, or NULL
+ * @param lock Mutex to initialize
+ * @return Whether the operation is a success
+**/
+bool arena_init_mutex(arena* a, pthread_mutex_t* lock);
+
+void* arena_malloc(arena* a, size_t size);
+void* arena_calloc(arena* a, size_t nb, size_t size);
+void* arena_realloc(arena* a, void* ptr, size_t size);
+
+/** Allocate a block whose address is a multiple of the given alignment.
+ * @param a     Arena, or NULL
+ * @param align Alignment (in bytes, a power of 2)
+ * @param size  Size of the block (in bytes)
+ * @return The block, NULL on failure
+**/
+void* arena_memalign(arena* a, size_t align, size_t size);
+void arena_free(arena* a, void* ptr);
@@ -0,0 +1,343 @@
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+
+// External headers
+#include <linux/futex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Internal headers
+#include "batcher.h"
+#include "macros.h"
+
+bool init_blocked_thread(blocked_thread* bt, int id) {
+    bt->id = id;
+    bt->alone = false;
+    bt->key = 0;
+    bt->is_static = false;
+    bt->keys = NULL;
+    bt->notify = NULL;
+    bt->next = NULL;
+    atomic_init(&bt->admitted, 0);
+    return true;
+}
+
+void destroy_blocked_thread(blocked_thread* bt) {
+    (void) bt;
+}
+
+batcher* init_batcher(arena* a) {
+    batcher* batcher_ptr = (batcher*) arena_malloc(a, sizeof(batcher));
+    if (batcher_ptr == NULL) {
+        fprintf(stderr, "Failed to allocate memory for batcher\n");
+        return NULL;
+    }
+
+    batcher_ptr->epoch = 0;
+    batcher_ptr->remaining = 0;
+    batcher_ptr->blocked_threads_head = NULL;
+    batcher_ptr->blocked_threads_tail = NULL;
+    batcher_ptr->arena = a;
+    memset(batcher_ptr->key_epochs, 0, sizeof(batcher_ptr->key_epochs));
+    memset(&batcher_ptr->static_keys, 0, sizeof(batcher_ptr->static_keys));
+    batcher_ptr->static_keys_epoch = 0;
+    batcher_ptr->static_epoch = false;
+
+    batcher_ptr->lock = (pthread_mutex_t*) arena_malloc(a, sizeof(pthread_mutex_t));
+    if (batcher_ptr->lock == NULL) {
+        fprintf(stderr, "Failed to allocate memory for mutex\n");
+        arena_free(a, batcher_ptr);
+        return NULL;
+    }
+
+    if (!arena_init_mutex(a, batcher_ptr->lock)) {
+        fprintf(stderr, "Failed to initialize mutex for batcher\n");
+        arena_free(a, batcher_ptr->lock);
+        arena_free(a, batcher_ptr);
+        return NULL;
+    }
+
+    return batcher_ptr;
+}
+
+/**
+ * @brief Destroys the batcher. No thread must be running or waiting in it.
+ * The blocked thread nodes are owned by their threads and are not freed here.
+ */
+void destroy_batcher(batcher* batcher) {
+    if (batcher == NULL) return;
+
+    arena* a = batcher->arena;
+    if (batcher->lock != NULL) {
+        pthread_mutex_destroy(batcher->lock);
+        arena_free(a, batcher->lock);
+        batcher->lock = NULL;
+    }
+
+    arena_free(a, batcher);
+}
+
+bool recover_batcher(batcher* batcher) {
+    batcher->remaining = 0;
+    batcher->blocked_threads_head = NULL;
+    batcher->blocked_threads_tail = NULL;
+    return arena_init_mutex(batcher->arena, batcher->lock);
+}
+
+/**
+ * @brief Futex operations on the word a thread waits on, process-shared if the batcher is in an arena.
+ */
+static void futex_wait(batcher* batcher, _Atomic(uint32_t)* word, uint32_t expected, struct timespec const* timeout) {
+    syscall(SYS_futex, word, batcher->arena != NULL ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, expected, timeout, NULL, 0);
+}
+
+static void futex_wake(batcher* batcher, _Atomic(uint32_t)* word) {
+    syscall(SYS_futex, word, batcher->arena != NULL ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/**
+ * @brief Removes a waiting thread from the queue and admits it into the current epoch.
+ * @param prev Thread before it in the queue, NULL if it is the head
+ * @param bt   Thread to admit, which must not be accessed afterwards
+ */
+static void admit(batcher* batcher, blocked_thread* prev, blocked_thread* bt) {
+    if (prev == NULL) {
+        batcher->blocked_threads_head = bt->next;
+    } else {
+        prev->next = bt->next;
+    }
+    if (batcher->blocked_threads_tail == bt)
+        batcher->blocked_threads_tail = prev;
+    batcher->remaining++;
+    _Atomic(uint32_t)* notify = bt->notify;
+    atomic_store_explicit(&bt->admitted, 1, memory_order_release);
+    if (notify != NULL) { // Stays valid until the owner of the node took the lock after seeing it admitted
+        atomic_fetch_add_explicit(notify, 1, memory_order_release);
+        futex_wake(batcher, notify);
+    } else {
+        futex_wake(batcher, &bt->admitted);
+    }
+}
+
+/**
+ * @brief Takes the keys of a waiting thread in the current epoch, unless they conflict with those of a thread admitted in it:
+ * an exclusive key conflicts with any key taken, a shared one (of a word a static thread only reads) with exclusive keys only.
+ * @return Whether the thread can be admitted
+ */
+static bool take_keys(batcher* batcher, blocked_thread* bt) {
+    uint64_t epoch = batcher->epoch;
+    if (!bt->is_static) {
+        if (bt->key == 0) return true;
+        if (batcher->key_epochs[bt->key] == epoch) return false;
+        batcher->key_epochs[bt->key] = epoch;
+        return true;
+    }
+    key_set* taken = &batcher->static_keys;
+    if (batcher->static_keys_epoch != epoch) {
+        memset(taken, 0, sizeof(*taken));
+        batcher->static_keys_epoch = epoch;
+    }
+    key_set const* keys = bt->keys;
+    for (size_t i = 0; i < BATCHER_KEY_WORDS; i++) {
+        if ((keys->exclusive[i] & (taken->exclusive[i] | taken->shared[i])) != 0 || (keys->shared[i] & taken->exclusive[i]) != 0)
+            return false;
+    }
+    for (size_t i = 0; i < BATCHER_KEY_WORDS; i++) {
+        taken->exclusive[i] |= keys->exclusive[i];
+        taken->shared[i] |= keys->shared[i];
+    }
+    return true;
+}
+
+/**
+ * @brief Admits every waiting thread into the (new) current epoch. Must be called with the batcher lock held.
+ *
+ * If a thread waits for an epoch of its own, it is admitted alone instead, and the
+ * others keep waiting for the next epoch. Static threads run in epochs of their own kind,
+ * alternating with the others when both wait, and only with static threads sharing none
+ * of their keys. Otherwise, a thread waiting with a key is only admitted if no other thread
+ * with the same key was in this epoch. The first waiting thread of the chosen kind
+ * is always admitted, so that the queue only holds threads while an epoch is running.
+ * The next node is read before waking, since a woken thread may run its whole
+ * transaction and release its node before we continue the traversal.
+ */
+void wake_up_threads(batcher* batcher) {
+    blocked_thread* prev = NULL;
+    for (blocked_thread* bt = batcher->blocked_threads_head; bt != NULL; prev = bt, bt = bt->next) {
+        if (!bt->alone) continue;
+        admit(batcher, prev, bt);
+        return;
+    }
+
+    bool statics = false, others = false;
+    for (blocked_thread* bt = batcher->blocked_threads_head; bt != NULL; bt = bt->next) {
+        statics |= bt->is_static;
+        others |= !bt->is_static;
+    }
+    batcher->static_epoch = statics && (!others || !batcher->static_epoch);
+
+    prev = NULL;
+    blocked_thread* bt = batcher->blocked_threads_head;
+    while (bt != NULL) {
+        blocked_thread* next = bt->next;
+        if (bt->is_static != batcher->static_epoch || !take_keys(batcher, bt)) { // Keeps waiting
+            prev = bt;
+            bt = next;
+            continue;
+        }
+        admit(batcher, prev, bt);
+        bt = next;
+    }
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Takes a thread that timed out out of the queue, unless it was admitted in the meantime.
+ * Admissions happen with the lock held, so the thread is either still in the queue or already counted in the epoch.
+ * @return Whether the thread was admitted
+ */
+static bool give_up(batcher* batcher, blocked_thread* bt) {
+    pthread_mutex_lock(batcher->lock);
+    bool admitted = atomic_load_explicit(&bt->admitted, memory_order_acquire) != 0;
+    if (!admitted) {
+        blocked_thread* prev = NULL;
+        for (blocked_thread* node = batcher->blocked_threads_head; node != bt; node = node->next)
+            prev = node;
+        if (prev == NULL) {
+            batcher->blocked_threads_head = bt->next;
+        } else {
+            prev->next = bt->next;
+        }
+        if (batcher->blocked_threads_tail == bt)
+            batcher->blocked_threads_tail = prev;
+    }
+    pthread_mutex_unlock(batcher->lock);
+    return admitted;
+}
+
+/**
+ * @brief Enters the batcher: returns immediately if no epoch is running, otherwise sleeps until the current epoch ends.
+ *
+ * The thread that closes the epoch counts the woken threads in 'remaining' before
+ * setting their futex words, so that a thread cannot miss its wake-up nor let an epoch end early.
+ * Threads only wait while an epoch is running, so an epoch entered directly holds every later arrival.
+ * A thread that times out leaves the queue, which still only holds threads while an epoch is running.
+ * A node with a counter to notify does not wait at all.
+ * @return Whether the thread was admitted before the timeout
+ */
+static bool enter(batcher* batcher, blocked_thread* blocked_thread, bool alone, unsigned int key, bool is_static, key_set const* keys, uint64_t timeout_ns, _Atomic(uint32_t)* notify) {
+    uint64_t deadline = 0;
+    if (timeout_ns != BATCHER_NO_TIMEOUT) {
+        deadline = monotonic_ns();
+        deadline += timeout_ns < UINT64_MAX - deadline ? timeout_ns : UINT64_MAX - deadline;
+    }
+    pthread_mutex_lock(batcher->lock);
+
+    if (batcher->remaining == 0) {
+        batcher->remaining++;
+        if (key != 0)
+            batcher->key_epochs[key] = batcher->epoch;
+        batcher->static_epoch = is_static;
+        pthread_mutex_unlock(batcher->lock);
+        return true;
+    }
+
+    blocked_thread->alone = alone;
+    blocked_thread->key = key;
+    blocked_thread->is_static = is_static;
+    blocked_thread->keys = keys;
+    blocked_thread->notify = notify;
+    blocked_thread->next = NULL;
+    atomic_store_explicit(&blocked_thread->admitted, 0, memory_order_relaxed);
+    if (batcher->blocked_threads_tail == NULL) {
+        batcher->blocked_threads_head = blocked_thread;
+    } else {
+        batcher->blocked_threads_tail->next = blocked_thread;
+    }
+    batcher->blocked_threads_tail = blocked_thread;
+
+    pthread_mutex_unlock(batcher->lock);
+    if (notify != NULL)
+        return false;
+
+    while (atomic_load_explicit(&blocked_thread->admitted, memory_order_acquire) == 0) {
+        if (timeout_ns == BATCHER_NO_TIMEOUT) {
+            futex_wait(batcher, &blocked_thread->admitted, 0, NULL); // Returns at once if already admitted, retried on spurious wake-ups
+            continue;
+        }
+        uint64_t now = monotonic_ns();
+        if (now >= deadline)
+            return give_up(batcher, blocked_thread);
+        struct timespec left = { .tv_sec = (time_t) ((deadline - now) / 1000000000), .tv_nsec = (long) ((deadline - now) % 1000000000) };
+        futex_wait(batcher, &blocked_thread->admitted, 0, &left);
+    }
+    return true;
+}
+
+void enter_batcher(batcher* batcher, blocked_thread* blocked_thread) {
+    enter(batcher, blocked_thread, false, 0, false, NULL, BATCHER_NO_TIMEOUT, NULL);
+}
+
+void enter_batcher_alone(batcher* batcher, blocked_thread* blocked_thread) {
+    enter(batcher, blocked_thread, true, 0, false, NULL, BATCHER_NO_TIMEOUT, NULL);
+}
+
+void enter_batcher_keyed(batcher* batcher, blocked_thread* blocked_thread, unsigned int key) {
+    enter(batcher, blocked_thread, false, key, false, NULL, BATCHER_NO_TIMEOUT, NULL);
+}
+
+void enter_batcher_static(batcher* batcher, blocked_thread* blocked_thread, key_set const* keys) {
+    enter(batcher, blocked_thread, false, 0, true, keys, BATCHER_NO_TIMEOUT, NULL);
+}
+
+bool enter_batcher_timed(batcher* batcher, blocked_thread* blocked_thread, bool alone, unsigned int key, uint64_t timeout_ns) {
+    return enter(batcher, blocked_thread, alone, key, false, NULL, timeout_ns, NULL);
+}
+
+bool enter_batcher_async(batcher* batcher, blocked_thread* blocked_thread, bool alone, unsigned int key, _Atomic(uint32_t)* notify) {
+    return enter(batcher, blocked_thread, alone, key, false, NULL, BATCHER_NO_TIMEOUT, notify);
+}
+
+bool batcher_admitted(batcher* batcher, blocked_thread* blocked_thread) {
+    if (atomic_load_explicit(&blocked_thread->admitted, memory_order_acquire) == 0)
+        return false;
+    // The thread that admitted the node holds the lock until done with its counter
+    pthread_mutex_lock(batcher->lock);
+    pthread_mutex_unlock(batcher->lock);
+    return true;
+}
+
+uint32_t wait_batcher_notify(batcher* batcher, _Atomic(uint32_t)* notify, uint32_t seen) {
+    uint32_t value;
+    while ((value = atomic_load_explicit(notify, memory_order_acquire)) == seen)
+        futex_wait(batcher, notify, seen, NULL);
+    return value;
+}
+
+/**
+ * @brief Leaves the batcher. The last thread to leave runs the end of epoch callback, then opens the next epoch.
+ */
+void leave_batcher(batcher* batcher, epoch_end_fn on_epoch_end, void* arg) {
+    pthread_mutex_lock(batcher->lock);
+
+    batcher->remaining--;
+    if (batcher->remaining == 0) {
+        /* Update the memory since no thread is able to access it. I.e. all other threads are sleeping */
+        if (on_epoch_end != NULL)
+            on_epoch_end(arg);
+        batcher->epoch++;
+        wake_up_threads(batcher);
+    }
+
+    pthread_mutex_unlock(batcher->lock);
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+// Number of keys threads can wait with, key 0 meaning no key
+#define BATCHER_KEYS 1024
+// Number of 64-bit words of a key set
+#define BATCHER_KEY_WORDS (BATCHER_KEYS / 64)
+
+// Timeout of threads that wait until they are admitted, however long it takes
+#define BATCHER_NO_TIMEOUT UINT64_MAX
+
+/**
+ * @brief Keys of the footprint of a static thread, one bit per key.
+ */
+typedef struct key_set {
+    uint64_t exclusive[BATCHER_KEY_WORDS];  // Keys of the words written, which no other static thread of the epoch may have
+    uint64_t shared[BATCHER_KEY_WORDS];     // Keys of the words only read, which no other static thread of the epoch may write
+} key_set;
+
+/**
+ * @brief A thread waiting in the batcher for the current epoch to end.
+ * Each waiting thread sleeps on its own futex word, set and woken by the thread that closes the epoch.
+ */
+typedef struct blocked_thread {
+    int id;                          // Identifier for the thread (debugging only)
+    bool alone;                      // Waits for an epoch of its own
+    unsigned int key;                // If not 0, admitted with no other thread of the same key
+    bool is_static;                  // Admitted in an epoch of static threads only, none of which conflicts with its keys
+    key_set const* keys;             // Static thread only: keys of its footprint
+    _Atomic(uint32_t)* notify;       // If not NULL, the node does not wait: this counter is incremented and woken instead once it is admitted
+    _Atomic(uint32_t) admitted;      // Futex word, set to 1 when the thread is admitted into an epoch
+    struct blocked_thread* next;     // Pointer to the next node
+} blocked_thread;
+
+/**
+ * @brief Function called by the last thread leaving an epoch, while no other thread is running.
+ * It is given when leaving rather than stored in the batcher, whose state may be shared by
+ * processes that map the code at different addresses.
+ */
+typedef void (*epoch_end_fn)(void* arg);
+
+/**
+ * @brief Batcher: lets threads run by epochs. Threads arriving during an epoch wait until it ends.
+ */
+typedef struct batcher {
+    uint64_t epoch;                                 // Current epoch number
+    int remaining;                                  // Number of threads still running in the current epoch
+    struct blocked_thread* blocked_threads_head;    // Threads waiting for the next epoch
+    struct blocked_thread* blocked_threads_tail;
+    pthread_mutex_t* lock;
+    arena* arena;                                   // Arena holding the batcher and the nodes of the waiting threads, NULL if private
+    uint64_t key_epochs[BATCHER_KEYS];              // Last epoch in which a thread waiting with each key was admitted
+    key_set static_keys;                            // Keys taken by the static threads admitted in epoch 'static_keys_epoch'
+    uint64_t static_keys_epoch;
+    bool static_epoch;                              // Whether the current epoch only admitted static threads
+} batcher;
+
+/** Initialize a blocked thread node.
+ * @param bt Node to initialize
+ * @param id Identifier of the thread (debugging only)
+ * @return Whether the operation is a success
+**/
+bool init_blocked_thread(blocked_thread* bt, int id);
+
+/** Clean up a blocked thread node.
+ * @param bt Node to clean up
+**/
+void destroy_blocked_thread(blocked_thread* bt);
+/** Create a batcher.
+ * @param a Arena to allocate the batcher in, so that threads of every process mapping it can wait in it; NULL if private
+ * @return The batcher, NULL on failure
+**/
+batcher* init_batcher(arena* a);
+void destroy_batcher(batcher* batcher);
+
+/** Reset a batcher left by threads that no longer exist: no epoch running, no thread waiting, lock released.
+ * @param batcher Batcher, in an arena no process is using
+ * @return Whether the operation is a success
+**/
+bool recover_batcher(batcher* batcher);
+void wake_up_threads(batcher* batcher);
+void enter_batcher(batcher* batcher, blocked_thread* blocked_thread);
+
+/** Enter the batcher in an epoch of its own: no other thread is admitted until it leaves.
+ * @param batcher        Batcher to enter
+ * @param blocked_thread Node of the calling thread
+**/
+void enter_batcher_alone(batcher* batcher, blocked_thread* blocked_thread);
+
+/** Enter the batcher with a key: among the threads waiting with the same key, only one is admitted per epoch.
+ * @param batcher        Batcher to enter
+ * @param blocked_thread Node of the calling thread
+ * @param key            Key in [1, BATCHER_KEYS)
+**/
+void enter_batcher_keyed(batcher* batcher, blocked_thread* blocked_thread, unsigned int key);
+
+/** Enter the batcher as a static thread: in an epoch of static threads only, where no other one has a key of the words
+ * it writes, nor writes words of a key it reads. When both static and other threads wait, the epochs alternate between the two kinds.
+ * @param batcher        Batcher to enter
+ * @param blocked_thread Node of the calling thread
+ * @param keys           Keys of the words written and of the words only read, read until the thread is admitted
+**/
+void enter_batcher_static(batcher* batcher, blocked_thread* blocked_thread, key_set const* keys);
+
+/** Enter the batcher as 'enter_batcher', 'enter_batcher_alone' or 'enter_batcher_keyed', giving up if not admitted in time.
+ * @param batcher        Batcher to enter
+ * @param blocked_thread Node of the calling thread, out of the queue again on timeout
+ * @param alone          Whether to enter in an epoch of its own
+ * @param key            Key in [1, BATCHER_KEYS), 0 for none
+ * @param timeout_ns     Longest time to wait (in ns), BATCHER_NO_TIMEOUT for no limit
+ * @return Whether the thread was admitted
+**/
+bool enter_batcher_timed(batcher* batcher, blocked_thread* blocked_thread, bool alone, unsigned int key, uint64_t timeout_ns);
+/** Enter the batcher as 'enter_batcher_timed' without waiting: if not admitted at once, the node stays in the queue until
+ * an epoch admits it, which 'batcher_admitted' tells. Only for private batchers.
+ * @param batcher        Batcher to enter
+ * @param blocked_thread Node, not to be reused until admitted
+ * @param alone          Whether to enter in an epoch of its own
+ * @param key            Key in [1, BATCHER_KEYS), 0 for none
+ * @param notify         Counter incremented then woken when the node is admitted, until 'batcher_admitted' told it was
+ * @return Whether the node was admitted at once
+**/
+bool enter_batcher_async(batcher* batcher, blocked_thread* blocked_thread, bool alone, unsigned int key, _Atomic(uint32_t)* notify);
+
+/** Tell whether a node that entered the batcher without waiting was admitted. Once it was, its counter is no longer accessed.
+ * @param batcher        Batcher
+ * @param blocked_thread Node
+ * @return Whether the node was admitted
+**/
+bool batcher_admitted(batcher* batcher, blocked_thread* blocked_thread);
+
+/** Wait until a counter given to 'enter_batcher_async' differs from a value.
+ * @param batcher Batcher
+ * @param notify  Counter
+ * @param seen    Value the counter is waited to differ from
+ * @return The value of the counter
+**/
+uint32_t wait_batcher_notify(batcher* batcher, _Atomic(uint32_t)* notify, uint32_t seen);
+
+/** Leave the batcher. The last thread to leave calls the end of epoch function, then opens the next epoch.
+ * @param batcher      Batcher to leave
+ * @param on_epoch_end Function called if the epoch ends, NULL for none
+ * @param arg          Argument of the function
+**/
+void leave_batcher(batcher* batcher, epoch_end_fn on_epoch_end, void* arg);
@@ -0,0 +1,355 @@
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+
+// External headers
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Internal headers
+#include "checkpoint.h"
+#include "macros.h"
+
+static inline size_t words_per_page(size_t align) {
+    return align < CHECKPOINT_PAGE_SIZE ? CHECKPOINT_PAGE_SIZE / align : 1;
+}
+
+static inline size_t nb_pages_of(size_t nb_words, size_t align) {
+    return (nb_words + words_per_page(align) - 1) / words_per_page(align);
+}
+
+/**
+ * @brief Checksum of an increment, eight bytes at a time.
+ */
+static uint64_t checksum(uint8_t const* data, size_t size) {
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * UINT64_C(0x100000001b3);
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ data[i]) * UINT64_C(0x100000001b3);
+    return hash;
+}
+
+checkpoints* init_checkpoints(memory* mem, stats* st) {
+    checkpoints* cps = (checkpoints*) calloc(1, sizeof(checkpoints));
+    if (cps == NULL) {
+        fprintf(stderr, "Failed to allocate checkpoint state\n");
+        return NULL;
+    }
+    cps->dirty = (uint64_t**) calloc(MAX_SEGMENTS, sizeof(uint64_t*));
+    if (cps->dirty == NULL) {
+        fprintf(stderr, "Failed to allocate checkpoint state\n");
+        free(cps);
+        return NULL;
+    }
+    cps->stats = st;
+    for (int id = 1; id < mem->next_free_id; id++) {
+        segment* seg = get_segment(mem, id);
+        if (seg != NULL)
+            checkpoint_track_alloc(cps, seg);
+    }
+    return cps;
+}
+
+void destroy_checkpoints(checkpoints* cps) {
+    if (cps == NULL) return;
+    for (int id = 0; id < MAX_SEGMENTS; id++)
+        free(cps->dirty[id]);
+    free(cps->dirty);
+    free(cps->freed);
+    free(cps->image);
+    free(cps);
+}
+
+/**
+ * @brief A segment whose bitmap cannot be allocated is not tracked, and is missing from later checkpoints.
+ */
+void checkpoint_track_alloc(checkpoints* cps, segment* seg) {
+    size_t nb_pages = nb_pages_of(seg->nb_words, seg->align);
+    uint64_t* dirty = (uint64_t*) malloc((nb_pages + 63) / 64 * sizeof(uint64_t));
+    if (unlikely(dirty == NULL)) {
+        fprintf(stderr, "Failed to track segment %d for checkpoints\n", seg->id);
+        return;
+    }
+    memset(dirty, 0xff, (nb_pages + 63) / 64 * sizeof(uint64_t));
+    free(cps->dirty[seg->id]);
+    cps->dirty[seg->id] = dirty;
+}
+
+void checkpoint_track_free(checkpoints* cps, int id) {
+    free(cps->dirty[id]);
+    cps->dirty[id] = NULL;
+    if (cps->nb_freed == cps->freed_capacity) {
+        size_t capacity = cps->freed_capacity == 0 ? 16 : 2 * cps->freed_capacity;
+        int* freed = (int*) realloc(cps->freed, capacity * sizeof(int));
+        if (unlikely(freed == NULL)) {
+            fprintf(stderr, "Failed to record freed segment %d for checkpoints\n", id);
+            return;
+        }
+        cps->freed = freed;
+        cps->freed_capacity = capacity;
+    }
+    cps->freed[cps->nb_freed++] = id;
+}
+
+/**
+ * @brief Reserves room at the end of the increment being captured.
+ * @return Where to write, NULL on failure
+ */
+static uint8_t* extend(checkpoints* cps, size_t size) {
+    if (cps->image_size + size > cps->image_capacity) {
+        size_t capacity = cps->image_capacity == 0 ? 65536 : cps->image_capacity;
+        while (capacity < cps->image_size + size)
+            capacity *= 2;
+        uint8_t* image = (uint8_t*) realloc(cps->image, capacity);
+        if (unlikely(image == NULL)) return NULL;
+        cps->image = image;
+        cps->image_capacity = capacity;
+    }
+    uint8_t* at = cps->image + cps->image_size;
+    cps->image_size += size;
+    return at;
+}
+
+/**
+ * @brief Appends the modified pages of a segment, reading each word from its readable copy.
+ * @return Whether the operation is a success
+ */
+static bool capture_segment(checkpoints* cps, segment* seg, bool full, uint64_t* nb_segments) {
+    uint64_t* dirty = cps->dirty[seg->id];
+    size_t wpp = words_per_page(seg->align);
+    size_t nb_pages = nb_pages_of(seg->nb_words, seg->align);
+    size_t nb_dirty = 0;
+    for (size_t p = 0; p < nb_pages; p++)
+        nb_dirty += full || (dirty[p / 64] >> (p % 64) & 1);
+    if (nb_dirty == 0) return true;
+
+    size_t data_size = 0;
+    for (size_t p = 0; p < nb_pages; p++) {
+        if (full || (dirty[p / 64] >> (p % 64) & 1))
+            data_size += ((p + 1) * wpp < seg->nb_words ? wpp : seg->nb_words - p * wpp) * seg->align;
+    }
+    size_t offset = cps->image_size;
+    if (extend(cps, sizeof(checkpoint_segment) + nb_dirty * sizeof(uint64_t) + data_size) == NULL)
+        return false;
+    checkpoint_segment header = { .id = (uint64_t) seg->id, .size = seg->size, .nb_pages = nb_dirty };
+    memcpy(cps->image + offset, &header, sizeof(header));
+    uint8_t* indexes = cps->image + offset + sizeof(header);
+    uint8_t* data = indexes + nb_dirty * sizeof(uint64_t);
+    for (size_t p = 0; p < nb_pages; p++) {
+        if (!full && !(dirty[p / 64] >> (p % 64) & 1)) continue;
+        uint64_t index = p;
+        memcpy(indexes, &index, sizeof(index));
+        indexes += sizeof(index);
+        size_t last = (p + 1) * wpp < seg->nb_words ? (p + 1) * wpp : seg->nb_words;
+        for (size_t w = p * wpp; w < last; w++) {
+            int readable = (atomic_load_explicit(&seg->controls[w], memory_order_relaxed) & CONTROL_READABLE) ? 1 : 0;
+            memcpy(data, seg->copies[readable] + w * seg->align, seg->align);
+            data += seg->align;
+        }
+    }
+    memset(dirty, 0, (nb_pages + 63) / 64 * sizeof(uint64_t));
+    (*nb_segments)++;
+    return true;
+}
+
+bool capture_checkpoint(checkpoints* cps, memory* mem, bool full, uint64_t epoch) {
+    cps->image_size = 0;
+    size_t nb_freed = full ? 0 : cps->nb_freed;
+    if (extend(cps, sizeof(checkpoint_header) + nb_freed * sizeof(uint64_t)) == NULL) {
+        fprintf(stderr, "Failed to allocate checkpoint\n");
+        return false;
+    }
+    for (size_t i = 0; i < nb_freed; i++) {
+        uint64_t id = (uint64_t) cps->freed[i];
+        memcpy(cps->image + sizeof(checkpoint_header) + i * sizeof(uint64_t), &id, sizeof(id));
+    }
+    uint64_t nb_segments = 0;
+    for (int id = 1; id < MAX_SEGMENTS; id++) {
+        if (cps->dirty[id] == NULL) continue;
+        segment* seg = get_segment(mem, id);
+        if (seg == NULL) continue;
+        if (!capture_segment(cps, seg, full, &nb_segments)) {
+            fprintf(stderr, "Failed to allocate checkpoint\n");
+            return false;
+        }
+    }
+    cps->nb_freed = 0;
+    checkpoint_header header = { .epoch = epoch, .nb_freed = nb_freed, .nb_segments = nb_segments,
+        .length = cps->image_size - sizeof(checkpoint_header), .checksum = 0 };
+    memcpy(cps->image, &header, sizeof(header));
+    return true;
+}
+
+static bool write_all(int fd, uint8_t const* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= (size_t) written;
+    }
+    return true;
+}
+
+/**
+ * @brief A full checkpoint is written to a temporary file renamed over the previous one, so that a crash leaves either.
+ */
+bool write_checkpoint(checkpoints* cps, char const* path, bool full, size_t size, size_t align) {
+    checkpoint_header* header = (checkpoint_header*) cps->image;
+    header->checksum = checksum(cps->image + sizeof(checkpoint_header), header->length);
+
+    char temporary[PATH_MAX + 8];
+    if (full && snprintf(temporary, sizeof(temporary), "%s.tmp", path) >= (int) sizeof(temporary))
+        return false;
+    int fd = full ? open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0600) : open(path, O_WRONLY | O_APPEND);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+    checkpoint_file_header file_header = { .magic = CHECKPOINT_MAGIC, .size = size, .align = align };
+    bool success = (!full || write_all(fd, (uint8_t const*) &file_header, sizeof(file_header)))
+        && write_all(fd, cps->image, cps->image_size) && fdatasync(fd) == 0;
+    close(fd);
+    if (success && full)
+        success = rename(temporary, path) == 0;
+    if (!success) {
+        perror("Failed to write checkpoint");
+        return false;
+    }
+    stats_add(&cps->stats->checkpoints, 1);
+    stats_add(&cps->stats->checkpoint_bytes, cps->image_size);
+    return true;
+}
+
+/**
+ * @brief Reads a whole checkpoint file.
+ * @return Content of the file, to free, NULL on failure
+ */
+static uint8_t* read_file(char const* path, size_t* length) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    struct stat st;
+    uint8_t* data = NULL;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(checkpoint_file_header))
+        data = (uint8_t*) malloc((size_t) st.st_size);
+    size_t done = 0;
+    while (data != NULL && done < (size_t) st.st_size) {
+        ssize_t nb = pread(fd, data + done, (size_t) st.st_size - done, (off_t) done);
+        if (nb < 0 && errno == EINTR) continue;
+        if (nb <= 0) {
+            free(data);
+            data = NULL;
+            break;
+        }
+        done += (size_t) nb;
+    }
+    close(fd);
+    checkpoint_file_header header;
+    if (data != NULL) {
+        memcpy(&header, data, sizeof(header));
+        if (header.magic != CHECKPOINT_MAGIC) {
+            free(data);
+            data = NULL;
+        }
+    }
+    if (data == NULL)
+        fprintf(stderr, "'%s' is not a checkpoint file\n", path);
+    *length = done;
+    return data;
+}
+
+bool read_checkpoint_shape(char const* path, size_t* size, size_t* align) {
+    size_t length;
+    uint8_t* data = read_file(path, &length);
+    if (data == NULL) return false;
+    checkpoint_file_header header;
+    memcpy(&header, data, sizeof(header));
+    free(data);
+    *size = header.size;
+    *align = header.align;
+    return true;
+}
+
+/**
+ * @brief Applies one increment, whose checksum was verified.
+ * @return Whether the increment matches the region
+ */
+static bool apply_increment(uint8_t const* data, checkpoint_header const* header, memory* mem, size_t align) {
+    for (uint64_t i = 0; i < header->nb_freed; i++) {
+        uint64_t id;
+        memcpy(&id, data, sizeof(id));
+        data += sizeof(id);
+        if (get_segment(mem, id) != NULL)
+            deallocate_segment(mem, (int) id);
+    }
+    size_t wpp = words_per_page(align);
+    for (uint64_t s = 0; s < header->nb_segments; s++) {
+        checkpoint_segment seg_header;
+        memcpy(&seg_header, data, sizeof(seg_header));
+        data += sizeof(seg_header);
+        segment* seg = get_segment(mem, seg_header.id);
+        if (seg != NULL && seg->size != seg_header.size) {
+            deallocate_segment(mem, (int) seg_header.id);
+            seg = NULL;
+        }
+        if (seg == NULL) {
+            if (!allocate_segment_at(mem, (int) seg_header.id, seg_header.size, align))
+                return false;
+            seg = get_segment(mem, seg_header.id);
+        }
+        uint8_t const* indexes = data;
+        data += seg_header.nb_pages * sizeof(uint64_t);
+        for (uint64_t p = 0; p < seg_header.nb_pages; p++) {
+            uint64_t page;
+            memcpy(&page, indexes + p * sizeof(page), sizeof(page));
+            if (page * wpp >= seg->nb_words)
+                return false;
+            size_t nb_words = (page + 1) * wpp < seg->nb_words ? wpp : seg->nb_words - page * wpp;
+            for (size_t w = page * wpp; w < page * wpp + nb_words; w++) {
+                int readable = (atomic_load_explicit(&seg->controls[w], memory_order_relaxed) & CONTROL_READABLE) ? 1 : 0;
+                memcpy(seg->copies[readable] + w * align, data, align);
+                data += align;
+            }
+        }
+    }
+    return true;
+}
+
+bool restore_checkpoint(char const* path, memory* mem) {
+    size_t length;
+    uint8_t* data = read_file(path, &length);
+    if (data == NULL) return false;
+    checkpoint_file_header file_header;
+    memcpy(&file_header, data, sizeof(file_header));
+    size_t offset = sizeof(file_header);
+    bool success = true;
+    while (success && length - offset >= sizeof(checkpoint_header)) {
+        checkpoint_header header;
+        memcpy(&header, data + offset, sizeof(header));
+        uint8_t const* body = data + offset + sizeof(header);
+        if (header.length > length - offset - sizeof(header) || checksum(body, header.length) != header.checksum)
+            break; // Torn by a crash while appending
+        success = apply_increment(body, &header, mem, file_header.align);
+        offset += sizeof(header) + header.length;
+    }
+    free(data);
+    if (!success)
+        fprintf(stderr, "The checkpoint '%s' does not match the region it is restored into\n", path);
+    return success;
+}
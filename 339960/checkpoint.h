@@ -0,0 +1,126 @@
+#pragma once
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memory.h"
+#include "stats.h"
+
+// Size of the pages tracked and saved by checkpoints (in bytes, rounded up to a word)
+#define CHECKPOINT_PAGE_SIZE 4096
+
+/* FILE FORMAT */
+
+// The file starts with a header, followed by one increment per checkpoint, the first one holding
+// every page. An increment lists the segments freed since the previous one, then the segments
+// with modified pages, each followed by the indexes and the content of those pages.
+// Restoring stops at the first incomplete increment or wrong checksum.
+
+#define CHECKPOINT_MAGIC UINT64_C(0x64762d636b707431)
+
+typedef struct checkpoint_file_header {
+    uint64_t magic;
+    uint64_t size;                      // Size of the first segment of the region
+    uint64_t align;                     // Size of a word
+} checkpoint_file_header;
+
+typedef struct checkpoint_header {
+    uint64_t epoch;                     // Number of completed epochs the increment is as of
+    uint64_t nb_freed;                  // Number of freed segment ids, each on 8 bytes
+    uint64_t nb_segments;
+    uint64_t length;                    // Size of what follows the header (in bytes)
+    uint64_t checksum;                  // Of what follows the header
+} checkpoint_header;
+
+typedef struct checkpoint_segment {
+    uint64_t id;
+    uint64_t size;
+    uint64_t nb_pages;                  // Followed by the index of each page, then their content
+} checkpoint_segment;
+
+/**
+ * @brief Pages modified since the last checkpoint, as of the last completed epoch.
+ * The end of each epoch marks the pages of the words committed transactions wrote, and
+ * the whole segments they allocated; the checkpoints clear the marks of the pages they save.
+ */
+typedef struct checkpoints {
+    uint64_t** dirty;                   // Per segment id: bitmap of the modified pages, NULL if no segment is tracked
+    int* freed;                         // Segments freed since the last checkpoint
+    size_t nb_freed;
+    size_t freed_capacity;
+    char path[PATH_MAX];                // File of the last checkpoint, to which the next one is an increment
+    uint8_t* image;                     // Increment being captured
+    size_t image_size;
+    size_t image_capacity;
+    stats* stats;
+} checkpoints;
+
+/** Start tracking the modifications of a region, from the segments in its table, all considered modified.
+ * @param mem Segment table, with no transaction running
+ * @param st  Counters of the region
+ * @return Tracking state, NULL on failure
+**/
+checkpoints* init_checkpoints(memory* mem, stats* st);
+void destroy_checkpoints(checkpoints* cps);
+
+/** Track a segment allocated by a committed transaction, all its pages considered modified. Called during the end of epoch.
+ * @param cps Tracking state
+ * @param seg Segment
+**/
+void checkpoint_track_alloc(checkpoints* cps, segment* seg);
+
+/** Stop tracking a segment freed by a committed transaction. Called during the end of epoch.
+ * @param cps Tracking state
+ * @param id  Segment id
+**/
+void checkpoint_track_free(checkpoints* cps, int id);
+
+/** Mark the page of a word written by a committed transaction. Called during the end of epoch.
+ * @param cps  Tracking state
+ * @param seg  Segment
+ * @param word Word index
+**/
+static inline void checkpoint_mark(checkpoints* cps, segment* seg, size_t word) {
+    uint64_t* dirty = cps->dirty[seg->id];
+    size_t page = word / (seg->align < CHECKPOINT_PAGE_SIZE ? CHECKPOINT_PAGE_SIZE / seg->align : 1);
+    if (dirty != NULL)
+        dirty[page / 64] |= UINT64_C(1) << (page % 64);
+}
+
+/** Copy the modified pages from the readable copies into an increment, and clear their marks.
+ * Must be called while no epoch can end, e.g. from inside the batcher.
+ * @param cps   Tracking state
+ * @param mem   Segment table
+ * @param full  Whether to save every page, as the first increment of a file
+ * @param epoch Number of completed epochs
+ * @return Whether the operation is a success
+**/
+bool capture_checkpoint(checkpoints* cps, memory* mem, bool full, uint64_t epoch);
+
+/** Write the captured increment: as the first one of a new file if 'full', appended to the file otherwise.
+ * @param cps   Tracking state
+ * @param path  Path of the file
+ * @param full  Whether to create the file
+ * @param size  Size of the first segment of the region
+ * @param align Size of a word
+ * @return Whether the operation is a success
+**/
+bool write_checkpoint(checkpoints* cps, char const* path, bool full, size_t size, size_t align);
+
+/** Read the shape of the region a checkpoint file was taken from.
+ * @param path  Path of the file
+ * @param size  Receives the size of the first segment
+ * @param align Receives the size of a word
+ * @return Whether the file is a checkpoint file
+**/
+bool read_checkpoint_shape(char const* path, size_t* size, size_t* align);
+
+/** Apply the complete increments of a checkpoint file to a new region of the same shape.
+ * @param path Path of the file
+ * @param mem  Segment table of the region, holding only its first segment
+ * @return Whether the operation is a success
+**/
+bool restore_checkpoint(char const* path, memory* mem);
@@ -0,0 +1,98 @@
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+
+// External headers
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+// Internal headers
+#include "config.h"
+
+/**
+ * @brief Reads an unsigned integer from the environment.
+ * @param name    Variable name
+ * @param default_value Value returned if the variable is unset or invalid
+ * @return The value of the variable
+ */
+static uint64_t env_uint(char const* name, uint64_t default_value) {
+    char const* value = getenv(name);
+    if (value == NULL || *value == '\0') return default_value;
+    char* end;
+    unsigned long long parsed = strtoull(value, &end, 10);
+    if (*end != '\0') return default_value;
+    return (uint64_t) parsed;
+}
+
+void load_config(config* cfg) {
+    cfg->multiversion = env_uint("DV_MULTIVERSION", 0) != 0;
+    cfg->max_versions = env_uint("DV_MAX_VERSIONS", 1 << 20);
+    cfg->snapshot = env_uint("DV_SNAPSHOT", 0) != 0;
+    if (cfg->snapshot)
+        cfg->multiversion = false;
+    cfg->irrevocable_after = env_uint("DV_IRREVOCABLE_AFTER", 0);
+    cfg->run_irrevocable_after = env_uint("DV_RUN_IRREVOCABLE_AFTER", 8);
+    cfg->run_backoff_ns = env_uint("DV_RUN_BACKOFF_NS", 100000);
+    cfg->park = env_uint("DV_PARK", 0) != 0;
+    cfg->stats = env_uint("DV_STATS", 0) != 0;
+    cfg->adaptive = env_uint("DV_ADAPTIVE", 0) != 0;
+    cfg->adaptive_window_us = env_uint("DV_ADAPTIVE_WINDOW_US", 1000);
+    cfg->adaptive_high = env_uint("DV_ADAPTIVE_HIGH", 50);
+    cfg->adaptive_low = env_uint("DV_ADAPTIVE_LOW", 20);
+    cfg->wal = getenv("DV_WAL");
+    if (cfg->wal != NULL && *cfg->wal == '\0')
+        cfg->wal = NULL;
+    cfg->wal_async = env_uint("DV_WAL_ASYNC", 0) != 0;
+    cfg->checkpoint = getenv("DV_CHECKPOINT");
+    if (cfg->checkpoint != NULL && *cfg->checkpoint == '\0')
+        cfg->checkpoint = NULL;
+    cfg->checkpoint_ms = env_uint("DV_CHECKPOINT_MS", 1000);
+}
+
+int claim_file(char const* base, char const* suffix, char** path) {
+    size_t length = strlen(base) + strlen(suffix) + 16;
+    char* candidate = (char*) malloc(length);
+    char* locked = (char*) malloc(length);
+    if (candidate == NULL || locked == NULL) {
+        fprintf(stderr, "Failed to allocate the path of '%s'\n", base);
+        free(candidate);
+        free(locked);
+        return -1;
+    }
+    for (unsigned int i = 0; i < CLAIM_MAX_FILES; i++) {
+        if (i == 0)
+            snprintf(candidate, length, "%s", base);
+        else
+            snprintf(candidate, length, "%s.%u", base, i);
+        snprintf(locked, length, "%s%s", candidate, suffix);
+        int fd = open(locked, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            perror(locked);
+            free(candidate);
+            free(locked);
+            return -1;
+        }
+        if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+            free(locked);
+            *path = candidate;
+            return fd;
+        }
+        int error = errno;
+        close(fd);
+        if (error != EWOULDBLOCK) {
+            fprintf(stderr, "Failed to lock '%s': %s\n", locked, strerror(error));
+            free(candidate);
+            free(locked);
+            return -1;
+        }
+    }
+    fprintf(stderr, "Every file of '%s' is held by another region\n", base);
+    free(candidate);
+    free(locked);
+    return -1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Engine options, read from the environment when a region is created.
+ */
+typedef struct config {
+    bool multiversion;      // DV_MULTIVERSION: read-only transactions read a pinned snapshot instead of joining the batcher
+    uint64_t max_versions;  // DV_MAX_VERSIONS: bound on the number of old versions kept for pinned snapshots
+    bool snapshot;          // DV_SNAPSHOT: read-only transactions read a copy-on-write snapshot (takes precedence over DV_MULTIVERSION)
+    uint64_t irrevocable_after; // DV_IRREVOCABLE_AFTER: consecutive aborts of a thread after which it runs irrevocably, 0 to never
+    uint64_t run_irrevocable_after; // DV_RUN_IRREVOCABLE_AFTER: aborts of a transaction run by 'tm_run' after which it runs irrevocably, 0 to never
+    uint64_t run_backoff_ns; // DV_RUN_BACKOFF_NS: longest wait of a transaction run by 'tm_run' before it is admitted again after an abort, 0 to never wait
+    bool park;              // DV_PARK: a transaction aborted on a conflict waits for an epoch with no other such transaction on the same word
+    bool stats;             // DV_STATS: print the counters of the region when it is destroyed
+    bool adaptive;          // DV_ADAPTIVE: switch between the batcher and a serial mode depending on the abort ratio
+    uint64_t adaptive_window_us; // DV_ADAPTIVE_WINDOW_US: length of the windows the abort ratio is sampled over
+    uint64_t adaptive_high; // DV_ADAPTIVE_HIGH: abort ratio (in percent) from which the batcher mode switches to serial
+    uint64_t adaptive_low;  // DV_ADAPTIVE_LOW: abort ratio (in percent) under which a return to the batcher mode is kept
+    char const* wal;        // DV_WAL: path of the redo log the region is recovered from then appended to, NULL for none (only valid while creating the region)
+    bool wal_async;         // DV_WAL_ASYNC: the log is written and synced on a background thread instead of at the end of each epoch
+    char const* checkpoint; // DV_CHECKPOINT: path of the file a background thread checkpoints the region to, NULL for none (only valid while creating the region)
+    uint64_t checkpoint_ms; // DV_CHECKPOINT_MS: interval between two background checkpoints
+} config;
+
+/** Fill the configuration from the environment, using defaults for unset variables.
+ * @param cfg Configuration to fill
+**/
+void load_config(config* cfg);
+
+// Number of files of a family that 'claim_file' tries before giving up
+#define CLAIM_MAX_FILES 1024
+
+/** Claim the first file of a family named in the environment that no region holds: 'base', then 'base.1', 'base.2'...
+ * Regions created with the same variable thus get a file each (the same ones when created again in the same
+ * order), in one process or several. The claim is an exclusive 'flock', released when the descriptor is closed.
+ * @param base   Path named in the environment
+ * @param suffix Suffix of the file locked to hold the claim, "" to lock the claimed file itself (opened read-write)
+ * @param path   Receives the path of the claimed file, to free
+ * @return Descriptor of the locked file, -1 on failure
+**/
+int claim_file(char const* base, char const* suffix, char** path);
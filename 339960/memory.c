@@ -0,0 +1,198 @@
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+
+// External headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Internal headers
+#include "macros.h"
+#include "memory.h"
+
+memory* init_memory(arena* a) {
+    memory* mem = (memory*) arena_malloc(a, sizeof(memory));
+    if (mem == NULL) {
+        fprintf(stderr, "Failed to allocate memory structure\n");
+        return NULL;
+    }
+    mem->arena = a;
+    mem->nb_segments = 0;
+    mem->next_free_id = 1;
+    mem->nb_free_ids = 0;
+    mem->multiversion = false;
+    mem->free_ids = (int*) arena_malloc(a, sizeof(int) * MAX_SEGMENTS);
+    mem->segments = (segment* _Atomic*) arena_calloc(a, MAX_SEGMENTS, sizeof(segment*));
+    mem->alloc_lock = (pthread_mutex_t*) arena_malloc(a, sizeof(pthread_mutex_t));
+    if (mem->free_ids == NULL || mem->segments == NULL || mem->alloc_lock == NULL) {
+        fprintf(stderr, "Failed to allocate segment table\n");
+        arena_free(a, mem->free_ids);
+        arena_free(a, mem->segments);
+        arena_free(a, mem->alloc_lock);
+        arena_free(a, mem);
+        return NULL;
+    }
+
+    if (!arena_init_mutex(a, mem->alloc_lock)) {
+        fprintf(stderr, "Failed to initialize mutex for memory\n");
+        arena_free(a, mem->free_ids);
+        arena_free(a, mem->segments);
+        arena_free(a, mem->alloc_lock);
+        arena_free(a, mem);
+        return NULL;
+    }
+
+    return mem;
+}
+
+/**
+ * @brief Frees every remaining segment and the segment table.
+ */
+void destroy_memory(memory* mem) {
+    if (mem == NULL) return;
+    arena* a = mem->arena;
+    for (int i = 1; i < mem->next_free_id; i++)
+        arena_free(a, mem->segments[i]);
+    pthread_mutex_destroy(mem->alloc_lock);
+    arena_free(a, mem->alloc_lock);
+    arena_free(a, mem->free_ids);
+    arena_free(a, mem->segments);
+    arena_free(a, mem);
+}
+
+/**
+ * @brief The writes of interrupted transactions only reached the writable copies, so keeping
+ * the readable bit of each control word restores the state of the last completed epoch.
+ */
+bool recover_memory(memory* mem, bool interrupted) {
+    if (interrupted) {
+        for (int i = 1; i < mem->next_free_id; i++) {
+            segment* seg = get_segment(mem, i);
+            if (seg == NULL) continue;
+            for (size_t w = 0; w < seg->nb_words; w++)
+                atomic_store_explicit(&seg->controls[w], atomic_load_explicit(&seg->controls[w], memory_order_relaxed) & CONTROL_READABLE, memory_order_relaxed);
+        }
+    }
+    return arena_init_mutex(mem->arena, mem->alloc_lock);
+}
+
+/**
+ * @brief Allocates a zeroed segment (header, control words and both copies in a single block), not registered yet.
+ * @return The segment, NULL on failure
+ */
+static segment* new_segment(memory* mem, size_t size, size_t align) {
+    size_t nb_words = size / align;
+    size_t copy_align = align < sizeof(void*) ? sizeof(void*) : align;
+    size_t header_size = (sizeof(segment) + copy_align - 1) / copy_align * copy_align;
+    size_t controls_size = (nb_words * sizeof(control_word) + copy_align - 1) / copy_align * copy_align;
+    size_t versions_size = 0;
+    if (mem->multiversion)
+        versions_size = (nb_words * (sizeof(uint64_t) + sizeof(void*)) + copy_align - 1) / copy_align * copy_align;
+    segment* seg = (segment*) arena_memalign(mem->arena, copy_align, header_size + controls_size + versions_size + 2 * size);
+    if (unlikely(seg == NULL)) {
+        fprintf(stderr, "Failed to allocate memory for dual memory segment\n");
+        return NULL;
+    }
+    memset((uint8_t*) seg + header_size, 0, controls_size + versions_size + 2 * size);
+    seg->size = size;
+    seg->align = align;
+    seg->nb_words = nb_words;
+    seg->controls = (control_word*) ((uint8_t*) seg + header_size);
+    seg->stamps = NULL;
+    seg->versions = NULL;
+    if (mem->multiversion) {
+        seg->stamps = (_Atomic(uint64_t)*) ((uint8_t*) seg + header_size + controls_size);
+        seg->versions = (struct version_node* _Atomic*) (seg->stamps + nb_words);
+    }
+    seg->copies[0] = (uint8_t*) seg + header_size + controls_size + versions_size;
+    seg->copies[1] = seg->copies[0] + size;
+    return seg;
+}
+
+/**
+ * @brief Registers a segment under an id, with the allocation lock held.
+ */
+static void publish_segment(memory* mem, segment* seg, int id) {
+    mem->nb_segments++;
+    seg->id = id;
+    atomic_store_explicit(&mem->segments[id], seg, memory_order_release);
+}
+
+/**
+ * @brief Allocates a segment and registers it in the table.
+ *
+ * Only the id allocation is done under the lock; the zeroing happens before the
+ * segment is published, so readers of the table never see a partially initialized segment.
+ */
+int allocate_segment(memory* mem, size_t size, size_t align) {
+    if (mem == NULL) return -1;
+    segment* seg = new_segment(mem, size, align);
+    if (unlikely(seg == NULL)) return -1;
+
+    pthread_mutex_lock(mem->alloc_lock);
+    int id;
+    if (mem->nb_free_ids > 0) {
+        id = mem->free_ids[--mem->nb_free_ids];
+    } else if (mem->next_free_id < MAX_SEGMENTS) {
+        id = mem->next_free_id++;
+    } else {
+        pthread_mutex_unlock(mem->alloc_lock);
+        arena_free(mem->arena, seg);
+        return -1;
+    }
+    publish_segment(mem, seg, id);
+    pthread_mutex_unlock(mem->alloc_lock);
+    return id;
+}
+
+/**
+ * @brief The ids skipped to reach the requested one become free ids, so that the table is the same as if they had been allocated and freed.
+ */
+bool allocate_segment_at(memory* mem, int id, size_t size, size_t align) {
+    if (mem == NULL || id <= 0 || id >= MAX_SEGMENTS) return false;
+    segment* seg = new_segment(mem, size, align);
+    if (unlikely(seg == NULL)) return false;
+
+    pthread_mutex_lock(mem->alloc_lock);
+    bool available = false;
+    if (id >= mem->next_free_id) {
+        while (mem->next_free_id < id)
+            mem->free_ids[mem->nb_free_ids++] = mem->next_free_id++;
+        mem->next_free_id++;
+        available = true;
+    } else {
+        for (int i = 0; i < mem->nb_free_ids; i++) {
+            if (mem->free_ids[i] != id) continue;
+            mem->free_ids[i] = mem->free_ids[--mem->nb_free_ids];
+            available = true;
+            break;
+        }
+    }
+    if (available)
+        publish_segment(mem, seg, id);
+    pthread_mutex_unlock(mem->alloc_lock);
+    if (!available)
+        arena_free(mem->arena, seg);
+    return available;
+}
+
+void deallocate_segment(memory* mem, int id) {
+    if (mem == NULL) {
+        fprintf(stderr, "Memory structure is NULL\n");
+        return;
+    }
+
+    segment* seg = get_segment(mem, id);
+    if (seg == NULL) {
+        fprintf(stderr, "Segment %d does not exist\n", id);
+        return;
+    }
+
+    pthread_mutex_lock(mem->alloc_lock);
+    atomic_store_explicit(&mem->segments[id], NULL, memory_order_relaxed);
+    mem->free_ids[mem->nb_free_ids++] = id;
+    mem->nb_segments--;
+    pthread_mutex_unlock(mem->alloc_lock);
+    arena_free(mem->arena, seg);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+/* ADDRESSING */
+
+// Shared addresses are virtual: the segment id lives in the 16 upper bits, the offset in the 48 lower bits.
+#define SEGMENT_SHIFT 48
+#define OFFSET_MASK   ((UINT64_C(1) << SEGMENT_SHIFT) - 1)
+#define MAX_SEGMENTS  (1 << 16) // Segment id 0 is never used, so that no valid address is NULL
+
+/* CONTROL WORDS */
+
+// Each word of a segment has one control word:
+//  - bit 63: index of the readable copy (only modified at the end of an epoch)
+//  - bit 62: whether the word has been written during the current epoch
+//  - bits 0-61: access set, i.e. none (0), the id of the only transaction that accessed the word, or ACCESS_MULTI
+// A word that transactions only added to during the epoch is marked written, with ACCESS_ADDED as its access set.
+typedef _Atomic(uint64_t) control_word;
+
+#define CONTROL_READABLE  (UINT64_C(1) << 63)
+#define CONTROL_WRITTEN   (UINT64_C(1) << 62)
+#define ACCESS_MASK       (CONTROL_WRITTEN - 1)
+#define ACCESS_NONE       UINT64_C(0)
+#define ACCESS_MULTI      ACCESS_MASK
+#define ACCESS_ADDED      (ACCESS_MASK - 1)
+
+struct version_node;
+
+/**
+ * @brief A dual-versioned segment: two copies of the data (readable and writable) and one control word per word.
+ * The header, the control words and both copies are allocated in one block.
+ */
+typedef struct segment {
+    int id;              // Index in the segment table
+    size_t size;         // Size of each copy (in bytes)
+    size_t align;        // Size of a word (in bytes)
+    size_t nb_words;
+    control_word* controls;
+    _Atomic(uint64_t)* stamps;                  // Multi-version mode only: version at which each readable word was installed
+    struct version_node* _Atomic* versions;     // Multi-version mode only: old values of each word, newest first
+    uint8_t* copies[2];
+} segment;
+
+/**
+ * @brief Segment table of a shared memory region.
+ */
+typedef struct memory {
+    arena* arena;                        // Arena holding the table and the segments, NULL for the C allocator
+    int nb_segments;                     // Number of live segments
+    _Atomic(int) next_free_id;           // First id never used so far, read without the lock by prefetching
+    int* free_ids;                       // Stack of ids released by deallocated segments
+    int nb_free_ids;
+    segment* _Atomic* segments;          // Segment table, indexed by segment id
+    pthread_mutex_t* alloc_lock;         // Protects the id allocation
+    bool multiversion;                   // Whether segments carry version stamps and chains
+} memory;
+
+/** Create an empty segment table.
+ * @param a Arena to allocate the table and the segments in, NULL for the C allocator
+ * @return The segment table, NULL on failure
+**/
+memory* init_memory(arena* a);
+void destroy_memory(memory* mem);
+
+/** Allocate and register a new zeroed segment.
+ * @param mem   Segment table
+ * @param size  Size of the segment (in bytes)
+ * @param align Size of a word (in bytes)
+ * @return The id of the new segment, -1 on failure
+**/
+int allocate_segment(memory* mem, size_t size, size_t align);
+
+/** Allocate and register a new zeroed segment under a given id, as when replaying a log.
+ * @param mem   Segment table
+ * @param id    Id of the segment, which must be unused
+ * @param size  Size of the segment (in bytes)
+ * @param align Size of a word (in bytes)
+ * @return Whether the operation is a success
+**/
+bool allocate_segment_at(memory* mem, int id, size_t size, size_t align);
+
+/** Unregister and free a segment. No transaction must be running.
+ * @param mem Segment table
+ * @param id  Id of the segment
+**/
+void deallocate_segment(memory* mem, int id);
+
+/** Reset a segment table left by threads that no longer exist: lock released, and if the
+ * transactions were interrupted, access sets and written marks cleared from every control word.
+ * @param mem         Segment table, in an arena no process is using
+ * @param interrupted Whether transactions may have been running
+ * @return Whether the operation is a success
+**/
+bool recover_memory(memory* mem, bool interrupted);
+
+/** Get the segment with the given id.
+ * @param mem Segment table
+ * @param id  Segment id
+ * @return The segment, NULL if none
+**/
+static inline segment* get_segment(memory* mem, uint64_t id) {
+    if (id == 0 || id >= MAX_SEGMENTS) return NULL;
+    return atomic_load_explicit(&mem->segments[id], memory_order_acquire);
+}
+
+/** Build the virtual address of a word.
+ * @param id     Segment id
+ * @param offset Offset in the segment (in bytes)
+ * @return The virtual address
+**/
+static inline void* segment_address(int id, size_t offset) {
+    return (void*) (((uintptr_t) id << SEGMENT_SHIFT) | (uintptr_t) offset);
+}
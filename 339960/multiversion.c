@@ -0,0 +1,240 @@
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+
+// External headers
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Internal headers
+#include "macros.h"
+#include "multiversion.h"
+
+multiversion* init_multiversion(uint64_t max_versions) {
+    multiversion* mv = (multiversion*) malloc(sizeof(multiversion));
+    if (mv == NULL) {
+        fprintf(stderr, "Failed to allocate multi-version state\n");
+        return NULL;
+    }
+    atomic_init(&mv->version, 0);
+    atomic_init(&mv->pending, 0);
+    for (int i = 0; i < MV_MAX_READERS; i++)
+        atomic_init(&mv->pins[i], MV_PIN_FREE);
+    mv->oldest = 0;
+    mv->oldest_node = NULL;
+    mv->newest_node = NULL;
+    mv->nb_versions = 0;
+    mv->max_versions = max_versions;
+    mv->retired_head = NULL;
+    mv->retired_tail = NULL;
+    return mv;
+}
+
+/**
+ * @brief Frees the saved values and the retired segment records. The retired segments
+ * themselves are still in the segment table, and are freed with it.
+ */
+void destroy_multiversion(multiversion* mv) {
+    if (mv == NULL) return;
+    while (mv->oldest_node != NULL) {
+        version_node* node = mv->oldest_node;
+        mv->oldest_node = node->next_created;
+        free(node);
+    }
+    while (mv->retired_head != NULL) {
+        retired_segment* retired = mv->retired_head;
+        mv->retired_head = retired->next;
+        free(retired);
+    }
+    free(mv);
+}
+
+/**
+ * @brief Pins the current version in a free slot.
+ *
+ * The slot is written before checking that no end of epoch started in between: either
+ * the end of epoch sees the pin when looking for the oldest one, or we see its
+ * announced version and pin again once it is published.
+ */
+bool mv_pin(multiversion* mv, int* slot, uint64_t* version) {
+    int start = (int) (((uintptr_t) slot >> 6) % MV_MAX_READERS);
+    int found = -1;
+    for (int i = 0; i < MV_MAX_READERS; i++) {
+        int candidate = (start + i) % MV_MAX_READERS;
+        uint64_t expected = MV_PIN_FREE;
+        uint64_t current = atomic_load_explicit(&mv->version, memory_order_acquire);
+        if (atomic_load_explicit(&mv->pins[candidate], memory_order_relaxed) == MV_PIN_FREE
+         && atomic_compare_exchange_strong_explicit(&mv->pins[candidate], &expected, current, memory_order_seq_cst, memory_order_relaxed)) {
+            found = candidate;
+            break;
+        }
+    }
+    if (found < 0) return false;
+
+    while (true) {
+        uint64_t current = atomic_load_explicit(&mv->pins[found], memory_order_relaxed);
+        if (atomic_load_explicit(&mv->pending, memory_order_seq_cst) == current)
+            break;
+        while (atomic_load_explicit(&mv->version, memory_order_acquire) != atomic_load_explicit(&mv->pending, memory_order_acquire))
+            sched_yield(); // End of epoch in progress, wait for the new version to be published
+        atomic_store_explicit(&mv->pins[found], atomic_load_explicit(&mv->version, memory_order_acquire), memory_order_seq_cst);
+    }
+    *slot = found;
+    *version = atomic_load_explicit(&mv->pins[found], memory_order_relaxed);
+    return true;
+}
+
+void mv_unpin(multiversion* mv, int slot) {
+    atomic_store_explicit(&mv->pins[slot], MV_PIN_FREE, memory_order_release);
+}
+
+/**
+ * @brief Reads a word as of a version, seqlock-style on the stamp of the word.
+ *
+ * The stamp is locked while the end of epoch swaps the copies, so an unchanged
+ * stamp around the copy guarantees that the copy read was the readable one.
+ */
+bool mv_read_word(segment* seg, size_t word, uint64_t version, void* target) {
+    _Atomic(uint64_t)* stamp = &seg->stamps[word];
+    while (true) {
+        uint64_t before = atomic_load_explicit(stamp, memory_order_acquire);
+        if (unlikely(before == MV_STAMP_LOCKED)) {
+            sched_yield();
+            continue;
+        }
+        if (before > version)
+            break;
+        int readable = (atomic_load_explicit(&seg->controls[word], memory_order_acquire) & CONTROL_READABLE) ? 1 : 0;
+        memcpy(target, seg->copies[readable] + word * seg->align, seg->align);
+        atomic_thread_fence(memory_order_acquire);
+        if (likely(atomic_load_explicit(stamp, memory_order_relaxed) == before))
+            return true;
+    }
+
+    // The readable value is too recent: look for an old value valid in our version
+    for (version_node* node = atomic_load_explicit(&seg->versions[word], memory_order_acquire); node != NULL; node = atomic_load_explicit(&node->older, memory_order_acquire)) {
+        if (node->valid_from <= version && version < node->valid_until) {
+            memcpy(target, node->value, seg->align);
+            return true;
+        }
+        if (node->valid_from <= version)
+            break;
+    }
+    return false;
+}
+
+void mv_begin_epoch_end(multiversion* mv) {
+    uint64_t next = atomic_load_explicit(&mv->version, memory_order_relaxed) + 1;
+    atomic_store_explicit(&mv->pending, next, memory_order_seq_cst);
+    uint64_t oldest = next;
+    for (int i = 0; i < MV_MAX_READERS; i++) {
+        uint64_t pinned = atomic_load_explicit(&mv->pins[i], memory_order_seq_cst);
+        if (pinned < oldest)
+            oldest = pinned;
+    }
+    mv->oldest = oldest;
+}
+
+/**
+ * @brief Saves the readable value before swapping the copies, when a pinned snapshot may need it.
+ *
+ * A value that is not saved leaves a gap in the chain of the word, past which a snapshot
+ * could walk into nodes that the end of epoch is free to reclaim. The chain is then cut
+ * (under the stamp lock), so that every chain reachable from a word stays contiguous.
+ */
+void mv_install_word(multiversion* mv, segment* seg, size_t word, uint64_t control) {
+    uint64_t next = atomic_load_explicit(&mv->pending, memory_order_relaxed);
+    _Atomic(uint64_t)* stamp = &seg->stamps[word];
+    uint64_t installed = atomic_load_explicit(stamp, memory_order_relaxed);
+    bool saved = false;
+
+    if (mv->oldest < next && mv->nb_versions < mv->max_versions) { // Some pinned snapshot may need the current readable value
+        version_node* node = (version_node*) malloc(sizeof(version_node) + seg->align);
+        if (likely(node != NULL)) {
+            int readable = (atomic_load_explicit(&seg->controls[word], memory_order_relaxed) & CONTROL_READABLE) ? 1 : 0;
+            memcpy(node->value, seg->copies[readable] + word * seg->align, seg->align);
+            node->valid_from = installed;
+            node->valid_until = next;
+            node->seg = seg;
+            node->word = word;
+            node->newer = NULL;
+            node->next_created = NULL;
+            version_node* head = atomic_load_explicit(&seg->versions[word], memory_order_relaxed);
+            atomic_init(&node->older, head);
+            if (head != NULL)
+                head->newer = node;
+            atomic_store_explicit(&seg->versions[word], node, memory_order_release);
+            if (mv->newest_node == NULL) {
+                mv->oldest_node = node;
+            } else {
+                mv->newest_node->next_created = node;
+            }
+            mv->newest_node = node;
+            mv->nb_versions++;
+            saved = true;
+        }
+    }
+
+    atomic_store_explicit(stamp, MV_STAMP_LOCKED, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    if (!saved) // The detached nodes stay in the creation order, and are reclaimed from there
+        atomic_store_explicit(&seg->versions[word], NULL, memory_order_relaxed);
+    atomic_store_explicit(&seg->controls[word], control, memory_order_relaxed);
+    atomic_store_explicit(stamp, next, memory_order_release);
+}
+
+void mv_retire_segment(multiversion* mv, int id) {
+    retired_segment* retired = (retired_segment*) malloc(sizeof(retired_segment));
+    if (unlikely(retired == NULL)) {
+        fprintf(stderr, "Failed to retire segment %d, leaking it\n", id);
+        return;
+    }
+    retired->id = id;
+    retired->version = atomic_load_explicit(&mv->pending, memory_order_relaxed);
+    retired->next = NULL;
+    if (mv->retired_tail == NULL) {
+        mv->retired_head = retired;
+    } else {
+        mv->retired_tail->next = retired;
+    }
+    mv->retired_tail = retired;
+}
+
+/**
+ * @brief Publishes the new version, then reclaims old values and freed segments.
+ *
+ * A snapshot pinned on version v never goes past the first node valid from v or
+ * before. Chains are contiguous (see 'mv_install_word'), so every node it walks is
+ * still valid in v, and a node whose validity ends at or before the oldest pinned
+ * version is unreachable. Nodes are reclaimed by creation order, so a reclaimed node
+ * is always the oldest of its chain; the head of a cut chain is no longer the head of its word.
+ */
+void mv_finish_epoch_end(multiversion* mv, memory* mem) {
+    atomic_store_explicit(&mv->version, atomic_load_explicit(&mv->pending, memory_order_relaxed), memory_order_seq_cst);
+
+    while (mv->oldest_node != NULL && mv->oldest_node->valid_until <= mv->oldest) {
+        version_node* node = mv->oldest_node;
+        mv->oldest_node = node->next_created;
+        if (node->newer == NULL) {
+            if (atomic_load_explicit(&node->seg->versions[node->word], memory_order_relaxed) == node)
+                atomic_store_explicit(&node->seg->versions[node->word], NULL, memory_order_relaxed);
+        } else {
+            atomic_store_explicit(&node->newer->older, NULL, memory_order_relaxed);
+        }
+        free(node);
+        mv->nb_versions--;
+    }
+    if (mv->oldest_node == NULL)
+        mv->newest_node = NULL;
+
+    while (mv->retired_head != NULL && mv->retired_head->version <= mv->oldest) {
+        retired_segment* retired = mv->retired_head;
+        mv->retired_head = retired->next;
+        deallocate_segment(mem, retired->id);
+        free(retired);
+    }
+    if (mv->retired_head == NULL)
+        mv->retired_tail = NULL;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memory.h"
+
+// Maximum number of read-only transactions pinning a snapshot at the same time
+#define MV_MAX_READERS 256
+// Value of a free pin slot
+#define MV_PIN_FREE    UINT64_MAX
+// Value of a stamp while the end of the epoch swaps the copies of its word
+#define MV_STAMP_LOCKED UINT64_MAX
+
+/**
+ * @brief Old value of a word, readable by the snapshots in [valid_from, valid_until).
+ */
+typedef struct version_node {
+    uint64_t valid_from;
+    uint64_t valid_until;
+    struct version_node* _Atomic older;     // Next node in the chain of the word
+    struct version_node* newer;             // Previous node in the chain of the word, NULL if head
+    segment* seg;                           // Word of the chain
+    size_t word;
+    struct version_node* next_created;      // Reclamation order, oldest first
+    uint8_t value[];
+} version_node;
+
+/**
+ * @brief Segment freed by a committed transaction, kept until no pinned snapshot can still reach it.
+ */
+typedef struct retired_segment {
+    int id;
+    uint64_t version;                       // First version in which the segment is freed
+    struct retired_segment* next;
+} retired_segment;
+
+/**
+ * @brief Multi-version state of a region.
+ *
+ * The version of the region is the number of completed epochs. A read-only transaction
+ * pins the current version at begin, then reads each word from the readable copy if it
+ * was installed at or before its version, and from the chain of old values otherwise.
+ * Old values are only saved while some snapshot is pinned, and only up to a bound;
+ * a snapshot that misses a value aborts and restarts on a newer version.
+ */
+typedef struct multiversion {
+    atomic_uint_fast64_t version;           // Last completed version
+    atomic_uint_fast64_t pending;           // Version being installed by the end of epoch in progress (== version otherwise)
+    _Atomic(uint64_t) pins[MV_MAX_READERS]; // Pinned versions, MV_PIN_FREE if slot unused
+    uint64_t oldest;                        // Oldest pinned version, computed at the start of each end of epoch
+    version_node* oldest_node;              // Saved old values, by creation order
+    version_node* newest_node;
+    uint64_t nb_versions;
+    uint64_t max_versions;
+    retired_segment* retired_head;          // Freed segments, by version order
+    retired_segment* retired_tail;
+} multiversion;
+
+multiversion* init_multiversion(uint64_t max_versions);
+void destroy_multiversion(multiversion* mv);
+
+/** Pin the current version.
+ * @param mv      Multi-version state
+ * @param slot    Receives the pin slot
+ * @param version Receives the pinned version
+ * @return Whether a slot was available
+**/
+bool mv_pin(multiversion* mv, int* slot, uint64_t* version);
+
+/** Release a pin slot.
+ * @param mv   Multi-version state
+ * @param slot Pin slot
+**/
+void mv_unpin(multiversion* mv, int slot);
+
+/** Read one word as of the given version, without synchronizing with the batcher.
+ * @param seg     Segment
+ * @param word    Word index
+ * @param version Pinned version
+ * @param target  Private target
+ * @return Whether the value was still available
+**/
+bool mv_read_word(segment* seg, size_t word, uint64_t version, void* target);
+
+/** Start of the end of epoch: announce the next version and find the oldest pinned one.
+ * @param mv Multi-version state
+**/
+void mv_begin_epoch_end(multiversion* mv);
+
+/** Swap the copies of a word written by a committed transaction, saving the old value if a snapshot may need it.
+ * @param mv      Multi-version state
+ * @param seg     Segment
+ * @param word    Word index
+ * @param control New control word value
+**/
+void mv_install_word(multiversion* mv, segment* seg, size_t word, uint64_t control);
+
+/** Defer the freeing of a segment until no pinned snapshot can reach it.
+ * @param mv Multi-version state
+ * @param id Segment id
+**/
+void mv_retire_segment(multiversion* mv, int id);
+
+/** End of the end of epoch: publish the new version and reclaim what no pinned snapshot needs anymore.
+ * @param mv  Multi-version state
+ * @param mem Segment table
+**/
+void mv_finish_epoch_end(multiversion* mv, memory* mem);
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "adaptive.h"
+#include "arena.h"
+#include "batcher.h"
+#include "checkpoint.h"
+#include "config.h"
+#include "memory.h"
+#include "multiversion.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "wal.h"
+
+/**
+ * @brief One word accessed (read or written) by a read-write transaction during the current epoch.
+ * The end of the epoch resets the control word, and swaps the copies if the transaction committed a write.
+ */
+typedef struct access_entry {
+    segment* seg;
+    size_t word;
+    bool written;
+} access_entry;
+
+// Number of most recent elastic reads kept, and tracked when the transaction first writes
+#define ELASTIC_WINDOW 2
+
+/**
+ * @brief Commutative add of a read-write transaction to a word, merged with the others at the end of the epoch if it committed.
+ */
+typedef struct add_entry {
+    segment* seg;
+    size_t word;
+    int64_t delta;
+} add_entry;
+
+/**
+ * @brief Word read elastically, i.e. without joining its access set.
+ */
+typedef struct elastic_read {
+    segment* seg;
+    size_t word;
+} elastic_read;
+
+/**
+ * @brief Transaction descriptor. The opaque 'tx_t' is the address of this structure.
+ */
+typedef struct transaction {
+    uint64_t id;                        // Unique id, stored in the access sets of the control words
+    arena* arena;                       // Arena of the region, in which the logs are allocated, NULL if private
+    bool is_ro;
+    bool committed;
+    bool kept;                          // Run by 'tm_run': left to its thread rather than destroyed if it aborts, to retry with the same logs
+    bool pending;                       // Begun by 'tm_begin_async', and not known to be admitted into its epoch yet
+    bool live;                          // Read-write: admitted into its epoch, and not retired from it yet
+    bool irrevocable;                   // Runs alone in its epoch, hence cannot abort
+    bool is_static;                     // Runs with static transactions whose footprints do not conflict with its own, hence cannot abort
+    key_set* keys;                      // Static transaction only: batcher keys of its footprint
+    unsigned int conflict_key;          // Batcher key of the word the transaction aborted on, 0 if none
+    uint64_t start_ns;                  // Time it entered its epoch, if the region keeps stats
+    blocked_thread waiter;              // Used to wait in the batcher
+    int mv_slot;                        // Pin slot of a read-only transaction reading a snapshot, -1 if in the batcher
+    uint64_t snapshot;                  // Pinned version
+    struct snapshot* snap;              // Copy-on-write snapshot read by a read-only transaction, NULL if in the batcher
+
+    access_entry* accesses;             // Words whose control word was modified by this transaction
+    size_t nb_accesses;
+    size_t accesses_capacity;
+    int* allocs;                        // Segments allocated (freed at the end of the epoch if aborted)
+    size_t nb_allocs;
+    size_t allocs_capacity;
+    int* frees;                         // Segments to free at the end of the epoch if committed
+    size_t nb_frees;
+    size_t frees_capacity;
+    add_entry* adds;                    // Commutative adds, to words no transaction reads or writes in this epoch
+    size_t nb_adds;
+    size_t adds_capacity;
+    bool plain_adds;                    // Adds are plain read-modify-writes: irrevocable, or the previous attempt mixed them with accesses
+    bool mixed_adds;                    // Accessed a word being added to, while adding itself
+
+    bool long_scan;                     // Hinted as a long scan: prefetches ahead from the first read
+
+    bool wrote;                         // Whether the transaction wrote, after which reads are no longer elastic
+    elastic_read elastic[ELASTIC_WINDOW]; // Most recent elastic reads, indexed by 'nb_elastic' modulo the window
+    size_t nb_elastic;
+
+    struct transaction* next_retired;   // Link in the list of transactions that left the current epoch
+} transaction;
+
+/**
+ * @brief Dual-versioned shared memory region.
+ */
+typedef struct region {
+    arena* arena;                       // Shared memory object or file holding the whole region, NULL unless created with 'tm_create_shared' or 'tm_create_file'
+    bool closed;                        // File-backed region only: closed with no transaction running
+    atomic_bool ending_epoch;           // File-backed region only: an end of epoch is modifying the control words
+    config config;
+    batcher* batcher;
+    memory* memory;
+    int start_id;                       // Id of the first, non-deallocable segment
+    size_t size;                        // Size of the first segment (in bytes)
+    size_t align;                       // Size of a word (in bytes)
+    atomic_uint_fast64_t next_tx_id;
+    transaction* _Atomic retired;       // Read-write transactions that left the current epoch
+    multiversion* mv;                   // Multi-version state, NULL unless enabled
+    snapshots* snaps;                   // Copy-on-write snapshots, NULL unless enabled
+    adaptive* adaptive;                 // Choice between the batcher and serial modes, NULL unless enabled
+    wal* wal;                           // Redo log, NULL unless enabled
+    checkpoints* checkpoints;           // Pages modified since the last checkpoint, NULL until the first one
+    pthread_mutex_t checkpoint_lock;    // Serializes the checkpoints, and guards the background checkpointer
+    pthread_cond_t checkpoint_cond;     // Wakes the background checkpointer up to stop
+    char* checkpoint_path;              // File of the background checkpointer, NULL if none runs
+    int checkpoint_claim;               // Lock on the file of the background checkpointer (see 'claim_file')
+    bool checkpoint_stop;
+    pthread_t checkpointer;
+    bool replica;                       // Created by 'tm_replica': only runs read-only transactions
+    wal_receiver replica_rx;            // Stream from the primary, whose fd is -1 unless replicating
+    atomic_uint_fast64_t replica_epoch; // Epoch of the primary of the last batch applied
+    pthread_t replicator;
+    stats stats;
+} region;
@@ -0,0 +1,258 @@
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+
+// External headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Internal headers
+#include "macros.h"
+#include "snapshot.h"
+
+static inline size_t words_per_page(segment* seg) {
+    return seg->align < SNAPSHOT_PAGE_SIZE ? SNAPSHOT_PAGE_SIZE / seg->align : 1;
+}
+
+snapshots* init_snapshots(stats* st) {
+    snapshots* snaps = (snapshots*) malloc(sizeof(snapshots));
+    if (snaps == NULL) {
+        fprintf(stderr, "Failed to allocate snapshots\n");
+        return NULL;
+    }
+    if (pthread_mutex_init(&snaps->lock, NULL) != 0) {
+        fprintf(stderr, "Failed to initialize mutex for snapshots\n");
+        free(snaps);
+        return NULL;
+    }
+    snaps->version = 0;
+    snaps->active = NULL;
+    snaps->nb_active = 0;
+    snaps->spare = NULL;
+    snaps->deferred = NULL;
+    snaps->stats = st;
+    return snaps;
+}
+
+/**
+ * @brief Frees the clones of a snapshot, leaving its clone table empty so that it can be reused.
+ */
+static void clear_snapshot(snapshot* snap) {
+    for (size_t i = 0; i < snap->nb_cloned_segments; i++) {
+        uint8_t* _Atomic* pages = snap->pages[snap->cloned_segments[i].id];
+        for (size_t p = 0; p < snap->cloned_segments[i].nb_pages; p++)
+            free(pages[p]);
+        free(pages);
+        snap->pages[snap->cloned_segments[i].id] = NULL;
+    }
+    snap->nb_cloned_segments = 0;
+    snap->nb_clones = 0;
+    snap->bytes_copied = 0;
+    atomic_store_explicit(&snap->broken, false, memory_order_relaxed);
+}
+
+static void free_snapshot(snapshot* snap) {
+    clear_snapshot(snap);
+    free(snap->cloned_segments);
+    free(snap->pages);
+    free(snap);
+}
+
+/**
+ * @brief Frees the remaining snapshots and deferred segment records. The deferred
+ * segments themselves are still in the segment table, and are freed with it.
+ */
+void destroy_snapshots(snapshots* snaps) {
+    if (snaps == NULL) return;
+    while (snaps->active != NULL) {
+        snapshot* snap = snaps->active;
+        snaps->active = snap->next;
+        free_snapshot(snap);
+    }
+    while (snaps->spare != NULL) {
+        snapshot* snap = snaps->spare;
+        snaps->spare = snap->next;
+        free_snapshot(snap);
+    }
+    while (snaps->deferred != NULL) {
+        deferred_segment* deferred = snaps->deferred;
+        snaps->deferred = deferred->next;
+        free(deferred);
+    }
+    pthread_mutex_destroy(&snaps->lock);
+    free(snaps);
+}
+
+snapshot* acquire_snapshot(snapshots* snaps) {
+    pthread_mutex_lock(&snaps->lock);
+    for (snapshot* snap = snaps->active; snap != NULL; snap = snap->next) {
+        if (snap->version == snaps->version) { // Still as of the last completed epoch: share it
+            snap->readers++;
+            pthread_mutex_unlock(&snaps->lock);
+            return snap;
+        }
+    }
+    if (snaps->nb_active >= SNAPSHOT_MAX) {
+        pthread_mutex_unlock(&snaps->lock);
+        return NULL;
+    }
+    snapshot* snap = snaps->spare;
+    if (snap != NULL) {
+        snaps->spare = snap->next;
+    } else {
+        snap = (snapshot*) calloc(1, sizeof(snapshot));
+        if (unlikely(snap == NULL)) {
+            pthread_mutex_unlock(&snaps->lock);
+            return NULL;
+        }
+        snap->pages = (uint8_t* _Atomic* _Atomic*) calloc(MAX_SEGMENTS, sizeof(*snap->pages));
+        if (unlikely(snap->pages == NULL)) {
+            free(snap);
+            pthread_mutex_unlock(&snaps->lock);
+            return NULL;
+        }
+    }
+    snap->version = snaps->version;
+    snap->readers = 1;
+    snap->next = snaps->active;
+    snaps->active = snap;
+    snaps->nb_active++;
+    pthread_mutex_unlock(&snaps->lock);
+    return snap;
+}
+
+void release_snapshot(snapshots* snaps, snapshot* snap) {
+    pthread_mutex_lock(&snaps->lock);
+    if (--snap->readers > 0) {
+        pthread_mutex_unlock(&snaps->lock);
+        return;
+    }
+    snapshot** link = &snaps->active;
+    while (*link != snap)
+        link = &(*link)->next;
+    *link = snap->next;
+    snaps->nb_active--;
+    stats_add(&snaps->stats->snapshots, 1);
+    stats_add(&snaps->stats->snapshot_clones, snap->nb_clones);
+    stats_add(&snaps->stats->snapshot_bytes, snap->bytes_copied);
+    clear_snapshot(snap);
+    snap->next = snaps->spare; // At most SNAPSHOT_MAX snapshots are ever allocated
+    snaps->spare = snap;
+    pthread_mutex_unlock(&snaps->lock);
+}
+
+/**
+ * @brief Reads a word from the clone of its page, or from the live readable copy if the page was not cloned.
+ *
+ * The end of epoch publishes a clone before swapping any word of its page, so if the
+ * page is still not cloned after reading the live copy, that copy was not swapped in between.
+ */
+bool snapshot_read_word(snapshot* snap, segment* seg, size_t word, void* target) {
+    if (unlikely(atomic_load_explicit(&snap->broken, memory_order_relaxed)))
+        return false;
+    size_t wpp = words_per_page(seg);
+    size_t page = word / wpp;
+    uint8_t* _Atomic* pages = atomic_load_explicit(&snap->pages[seg->id], memory_order_acquire);
+    uint8_t* clone = pages != NULL ? atomic_load_explicit(&pages[page], memory_order_acquire) : NULL;
+    if (clone == NULL) {
+        int readable = (atomic_load_explicit(&seg->controls[word], memory_order_acquire) & CONTROL_READABLE) ? 1 : 0;
+        memcpy(target, seg->copies[readable] + word * seg->align, seg->align);
+        atomic_thread_fence(memory_order_acquire);
+        pages = atomic_load_explicit(&snap->pages[seg->id], memory_order_acquire);
+        clone = pages != NULL ? atomic_load_explicit(&pages[page], memory_order_acquire) : NULL;
+        if (likely(clone == NULL))
+            return true;
+    }
+    memcpy(target, clone + (word - page * wpp) * seg->align, seg->align);
+    return true;
+}
+
+void snapshots_begin_epoch_end(snapshots* snaps) {
+    pthread_mutex_lock(&snaps->lock);
+}
+
+void snapshots_before_install(snapshots* snaps, segment* seg, size_t word) {
+    size_t wpp = words_per_page(seg);
+    size_t page = word / wpp;
+    size_t nb_pages = (seg->nb_words + wpp - 1) / wpp;
+    for (snapshot* snap = snaps->active; snap != NULL; snap = snap->next) {
+        uint8_t* _Atomic* pages = atomic_load_explicit(&snap->pages[seg->id], memory_order_relaxed);
+        if (atomic_load_explicit(&snap->broken, memory_order_relaxed))
+            continue;
+        if (pages == NULL) {
+            if (!(snap->nb_cloned_segments < snap->cloned_segments_capacity)) {
+                size_t capacity = snap->cloned_segments_capacity == 0 ? 16 : 2 * snap->cloned_segments_capacity;
+                cloned_segment* cloned = (cloned_segment*) realloc(snap->cloned_segments, capacity * sizeof(cloned_segment));
+                if (unlikely(cloned == NULL)) {
+                    atomic_store_explicit(&snap->broken, true, memory_order_relaxed);
+                    continue;
+                }
+                snap->cloned_segments = cloned;
+                snap->cloned_segments_capacity = capacity;
+            }
+            pages = (uint8_t* _Atomic*) calloc(nb_pages, sizeof(*pages));
+            if (unlikely(pages == NULL)) {
+                atomic_store_explicit(&snap->broken, true, memory_order_relaxed);
+                continue;
+            }
+            snap->cloned_segments[snap->nb_cloned_segments++] = (cloned_segment) { .id = seg->id, .nb_pages = nb_pages };
+            atomic_store_explicit(&snap->pages[seg->id], pages, memory_order_release);
+        }
+        if (atomic_load_explicit(&pages[page], memory_order_relaxed) != NULL)
+            continue;
+
+        size_t first = page * wpp;
+        size_t count = first + wpp <= seg->nb_words ? wpp : seg->nb_words - first;
+        uint8_t* clone = (uint8_t*) malloc(count * seg->align);
+        if (unlikely(clone == NULL)) {
+            atomic_store_explicit(&snap->broken, true, memory_order_relaxed);
+            continue;
+        }
+        for (size_t i = 0; i < count; i++) {
+            int readable = (atomic_load_explicit(&seg->controls[first + i], memory_order_relaxed) & CONTROL_READABLE) ? 1 : 0;
+            memcpy(clone + i * seg->align, seg->copies[readable] + (first + i) * seg->align, seg->align);
+        }
+        atomic_store_explicit(&pages[page], clone, memory_order_release);
+        snap->nb_clones++;
+        snap->bytes_copied += count * seg->align;
+    }
+    atomic_thread_fence(memory_order_release); // Clones visible to whoever sees the swap
+}
+
+void snapshots_free_segment(snapshots* snaps, memory* mem, int id) {
+    if (snaps->active == NULL) {
+        deallocate_segment(mem, id);
+        return;
+    }
+    deferred_segment* deferred = (deferred_segment*) malloc(sizeof(deferred_segment));
+    if (unlikely(deferred == NULL)) {
+        fprintf(stderr, "Failed to defer the freeing of segment %d, leaking it\n", id);
+        return;
+    }
+    deferred->id = id;
+    deferred->version = snaps->version + 1;
+    deferred->next = snaps->deferred;
+    snaps->deferred = deferred;
+}
+
+void snapshots_finish_epoch_end(snapshots* snaps, memory* mem) {
+    snaps->version++;
+    uint64_t oldest = snaps->version;
+    for (snapshot* snap = snaps->active; snap != NULL; snap = snap->next) {
+        if (snap->version < oldest)
+            oldest = snap->version;
+    }
+    deferred_segment** link = &snaps->deferred;
+    while (*link != NULL) {
+        deferred_segment* deferred = *link;
+        if (deferred->version <= oldest) {
+            *link = deferred->next;
+            deallocate_segment(mem, deferred->id);
+            free(deferred);
+        } else {
+            link = &deferred->next;
+        }
+    }
+    pthread_mutex_unlock(&snaps->lock);
+}
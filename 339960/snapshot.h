@@ -0,0 +1,114 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memory.h"
+#include "stats.h"
+
+// Size of the pages cloned for snapshots (in bytes, rounded up to a word)
+#define SNAPSHOT_PAGE_SIZE 4096
+// Maximum number of snapshots alive at the same time
+#define SNAPSHOT_MAX       8
+
+/**
+ * @brief Segment with a clone array in a snapshot.
+ */
+typedef struct cloned_segment {
+    int id;
+    size_t nb_pages;
+} cloned_segment;
+
+/**
+ * @brief Copy-on-write snapshot of a region, as of the end of an epoch.
+ *
+ * A page is cloned, from the readable copy, by the end of epoch that is about to swap
+ * one of its words for the first time since the snapshot was taken. Readers use the
+ * clone if there is one, and the live readable copy otherwise.
+ */
+typedef struct snapshot {
+    uint64_t version;                   // Number of completed epochs when taken
+    int readers;                        // Transactions using the snapshot
+    atomic_bool broken;                 // A clone could not be allocated: readers must abort
+    uint8_t* _Atomic* _Atomic* pages;   // Per segment id: clone of each page, NULL if not cloned
+    cloned_segment* cloned_segments;    // Segments with a clone array
+    size_t nb_cloned_segments;
+    size_t cloned_segments_capacity;
+    uint64_t nb_clones;
+    uint64_t bytes_copied;
+    struct snapshot* next;
+} snapshot;
+
+/**
+ * @brief Segment freed by a committed transaction while some snapshot may still read it.
+ */
+typedef struct deferred_segment {
+    int id;
+    uint64_t version;                   // First version in which the segment is freed
+    struct deferred_segment* next;
+} deferred_segment;
+
+/**
+ * @brief Snapshots of a region.
+ */
+typedef struct snapshots {
+    pthread_mutex_t lock;               // Protects everything below, held by the end of epoch while it swaps copies
+    uint64_t version;                   // Number of completed epochs
+    snapshot* active;
+    int nb_active;
+    snapshot* spare;                    // Released snapshots, kept to reuse their clone table
+    deferred_segment* deferred;
+    stats* stats;
+} snapshots;
+
+snapshots* init_snapshots(stats* st);
+void destroy_snapshots(snapshots* snaps);
+
+/** Get a snapshot of the last completed epoch, sharing it with other readers if one already exists.
+ * @param snaps Snapshots of the region
+ * @return Snapshot, NULL if too many snapshots are alive
+**/
+snapshot* acquire_snapshot(snapshots* snaps);
+
+/** Release a snapshot, freeing its clones if it was its last reader.
+ * @param snaps Snapshots of the region
+ * @param snap  Snapshot
+**/
+void release_snapshot(snapshots* snaps, snapshot* snap);
+
+/** Read one word as of the snapshot.
+ * @param snap   Snapshot
+ * @param seg    Segment
+ * @param word   Word index
+ * @param target Private target
+ * @return Whether the snapshot is usable
+**/
+bool snapshot_read_word(snapshot* snap, segment* seg, size_t word, void* target);
+
+/** Start of the end of epoch. Must be matched by 'snapshots_finish_epoch_end'.
+ * @param snaps Snapshots of the region
+**/
+void snapshots_begin_epoch_end(snapshots* snaps);
+
+/** Clone, for every snapshot, the page of a word that is about to be swapped.
+ * @param snaps Snapshots of the region
+ * @param seg   Segment
+ * @param word  Word index
+**/
+void snapshots_before_install(snapshots* snaps, segment* seg, size_t word);
+
+/** Free a segment, or defer it while a snapshot may still read it. Called during the end of epoch.
+ * @param snaps Snapshots of the region
+ * @param mem   Segment table
+ * @param id    Segment id
+**/
+void snapshots_free_segment(snapshots* snaps, memory* mem, int id);
+
+/** End of the end of epoch: publish the new version and free the segments no snapshot can read anymore.
+ * @param snaps Snapshots of the region
+ * @param mem   Segment table
+**/
+void snapshots_finish_epoch_end(snapshots* snaps, memory* mem);
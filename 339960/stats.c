@@ -0,0 +1,77 @@
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+
+// Internal headers
+#include "stats.h"
+
+void init_stats(stats* st) {
+    atomic_init(&st->commits, 0);
+    atomic_init(&st->aborts, 0);
+    atomic_init(&st->epochs, 0);
+    atomic_init(&st->irrevocable, 0);
+    atomic_init(&st->serial, 0);
+    atomic_init(&st->parked, 0);
+    atomic_init(&st->statics, 0);
+    atomic_init(&st->runs, 0);
+    atomic_init(&st->run_attempts, 0);
+    atomic_init(&st->timeouts, 0);
+    atomic_init(&st->merged_adds, 0);
+    atomic_init(&st->useful_ns, 0);
+    atomic_init(&st->wasted_ns, 0);
+    atomic_init(&st->snapshots, 0);
+    atomic_init(&st->snapshot_clones, 0);
+    atomic_init(&st->snapshot_bytes, 0);
+    atomic_init(&st->wal_bytes, 0);
+    atomic_init(&st->wal_syncs, 0);
+    atomic_init(&st->replication_bytes, 0);
+    atomic_init(&st->replication_batches, 0);
+    atomic_init(&st->checkpoints, 0);
+    atomic_init(&st->checkpoint_bytes, 0);
+    atomic_init(&st->checkpoint_pause_ns, 0);
+}
+
+static uint64_t load(atomic_uint_fast64_t* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void print_stats(stats* st, FILE* stream) {
+    uint64_t snapshots = load(&st->snapshots);
+    fprintf(stream, "###### Stats ######\n");
+    fprintf(stream, "Commits: %lu\n", (unsigned long) load(&st->commits));
+    fprintf(stream, "Aborts: %lu\n", (unsigned long) load(&st->aborts));
+    fprintf(stream, "Epochs: %lu\n", (unsigned long) load(&st->epochs));
+    if (load(&st->irrevocable) > 0)
+        fprintf(stream, "Irrevocable: %lu (%.3f%% of commits)\n", (unsigned long) load(&st->irrevocable), 100.0 * load(&st->irrevocable) / load(&st->commits));
+    if (load(&st->serial) > 0)
+        fprintf(stream, "Serial: %lu\n", (unsigned long) load(&st->serial));
+    if (load(&st->parked) > 0)
+        fprintf(stream, "Parked: %lu\n", (unsigned long) load(&st->parked));
+    if (load(&st->statics) > 0)
+        fprintf(stream, "Static: %lu\n", (unsigned long) load(&st->statics));
+    if (load(&st->runs) > 0)
+        fprintf(stream, "Runs: %lu (%.2f attempts per commit)\n", (unsigned long) load(&st->runs), (double) load(&st->run_attempts) / load(&st->runs));
+    if (load(&st->timeouts) > 0)
+        fprintf(stream, "Timed out: %lu\n", (unsigned long) load(&st->timeouts));
+    if (load(&st->merged_adds) > 0)
+        fprintf(stream, "Merged adds: %lu\n", (unsigned long) load(&st->merged_adds));
+    uint64_t useful = load(&st->useful_ns), wasted = load(&st->wasted_ns);
+    if (useful + wasted > 0)
+        fprintf(stream, "Wasted work: %.3f ms in aborted transactions (%.2f%% of read-write transaction time)\n", wasted / 1e6, 100.0 * wasted / (useful + wasted));
+    if (snapshots > 0) {
+        fprintf(stream, "Snapshots: %lu\n", (unsigned long) snapshots);
+        fprintf(stream, "    - Pages cloned: %lu (%.1f per snapshot)\n", (unsigned long) load(&st->snapshot_clones), (double) load(&st->snapshot_clones) / snapshots);
+        fprintf(stream, "    - Bytes copied: %lu (%.1f per snapshot)\n", (unsigned long) load(&st->snapshot_bytes), (double) load(&st->snapshot_bytes) / snapshots);
+    }
+    if (load(&st->wal_syncs) > 0)
+        fprintf(stream, "Log: %lu bytes in %lu syncs (%.1f bytes per sync)\n", (unsigned long) load(&st->wal_bytes), (unsigned long) load(&st->wal_syncs), (double) load(&st->wal_bytes) / load(&st->wal_syncs));
+    if (load(&st->replication_batches) > 0)
+        fprintf(stream, "Replication: %lu bytes in %lu batches\n", (unsigned long) load(&st->replication_bytes), (unsigned long) load(&st->replication_batches));
+    uint64_t checkpoints = load(&st->checkpoints);
+    if (checkpoints > 0) {
+        fprintf(stream, "Checkpoints: %lu\n", (unsigned long) checkpoints);
+        fprintf(stream, "    - Bytes written: %lu (%.1f per checkpoint)\n", (unsigned long) load(&st->checkpoint_bytes), (double) load(&st->checkpoint_bytes) / checkpoints);
+        fprintf(stream, "    - Pause: %.3f ms per checkpoint\n", load(&st->checkpoint_pause_ns) / 1e6 / checkpoints);
+    }
+    fprintf(stream, "###################\n");
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Counters of a region, printed at tm_destroy when DV_STATS is set.
+ */
+typedef struct stats {
+    atomic_uint_fast64_t commits;
+    atomic_uint_fast64_t aborts;
+    atomic_uint_fast64_t epochs;
+    atomic_uint_fast64_t irrevocable;       // Transactions committed in an epoch of their own
+    atomic_uint_fast64_t serial;            // Transactions run in an epoch of their own because the region was in serial mode
+    atomic_uint_fast64_t parked;            // Transactions that waited behind another one on the same conflicting word
+    atomic_uint_fast64_t statics;           // Transactions begun with a declared footprint
+    atomic_uint_fast64_t runs;              // Transactions committed by 'tm_run'
+    atomic_uint_fast64_t run_attempts;      // Attempts they took, including the committed ones
+    atomic_uint_fast64_t timeouts;          // Transactions not begun because they were not admitted into an epoch in time
+    atomic_uint_fast64_t merged_adds;       // Commutative adds of committed transactions, merged at the end of their epoch
+    atomic_uint_fast64_t useful_ns;         // Time spent running read-write transactions that committed
+    atomic_uint_fast64_t wasted_ns;         // Time spent running read-write transactions that aborted
+    atomic_uint_fast64_t snapshots;         // Copy-on-write snapshots taken
+    atomic_uint_fast64_t snapshot_clones;   // Pages cloned for them
+    atomic_uint_fast64_t snapshot_bytes;    // Bytes copied by these clones
+    atomic_uint_fast64_t wal_bytes;         // Bytes written to the log
+    atomic_uint_fast64_t wal_syncs;         // Syncs of the log
+    atomic_uint_fast64_t replication_bytes; // Bytes sent to the replica, or received from the primary
+    atomic_uint_fast64_t replication_batches; // Batches sent to the replica, or applied from the primary
+    atomic_uint_fast64_t checkpoints;       // Checkpoints written
+    atomic_uint_fast64_t checkpoint_bytes;  // Bytes written by them
+    atomic_uint_fast64_t checkpoint_pause_ns; // Time they held their epoch open while copying the modified pages
+} stats;
+
+void init_stats(stats* st);
+
+/** Add to a counter.
+ * @param counter Counter
+ * @param value   Amount to add
+**/
+static inline void stats_add(atomic_uint_fast64_t* counter, uint64_t value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+/** Print the counters.
+ * @param st     Counters
+ * @param stream Output stream
+**/
+void print_stats(stats* st, FILE* stream);
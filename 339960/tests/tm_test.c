@@ -1,70 +1,85 @@
-#include "tm.h"
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
-/* BATCHER TESTS*/
-
-blocked_thread* create_blocked_thread(int id){
-    blocked_thread* b = malloc(sizeof(blocked_thread));
-    if (b == NULL) {
-        perror("malloc");
-        exit(EXIT_FAILURE);
-    }
+#include "tm.h"
+#include "batcher.h"
+#include "memory.h"
+#include "multiversion.h"
+#include "region.h"
 
-    if (sem_init(&b->sem, 0, 0) != 0) {
-        perror("sem_init");
-        exit(EXIT_FAILURE);
-    }
-    b->next = NULL;
-    b->id = id;
-    return b;
-}
+/* BATCHER TESTS*/
 
 typedef struct {
     batcher* b;
     blocked_thread* t;
+    int* inside;
+    int* max_inside;
+    pthread_mutex_t* lock;
 } thread_arg;
 
+static int epochs_ended = 0;
+
+static void count_epoch(void* arg) {
+    (void) arg;
+    epochs_ended++;
+}
+
 void* enter_batcher_thread(void* arg) {
     thread_arg* ta = (thread_arg*)arg;
 
     enter_batcher(ta->b, ta->t);
-    
-    int delay2 = rand() % 5000000;
-    usleep(delay2);
+    pthread_mutex_lock(ta->lock);
+    (*ta->inside)++;
+    if (*ta->inside > *ta->max_inside) *ta->max_inside = *ta->inside;
+    pthread_mutex_unlock(ta->lock);
+
+    usleep(rand() % 1000);
 
-    leave_batcher(ta->b);
+    pthread_mutex_lock(ta->lock);
+    (*ta->inside)--;
+    pthread_mutex_unlock(ta->lock);
+    leave_batcher(ta->b, count_epoch, NULL);
 
     return NULL;
 }
 
-
 void batcher_test(void) {
+    enum { nb_threads = 32 };
 
-    int nb_threads = 100;
-
-    // FIXME : the test is not correct.
-    batcher* b = init_batcher();
-    print_batcher(b);
+    batcher* b = init_batcher(NULL);
     pthread_t threads[nb_threads];
-    blocked_thread* t[nb_threads];
+    blocked_thread t[nb_threads];
     thread_arg args[nb_threads];
+    int inside = 0, max_inside = 0;
+    pthread_mutex_t lock;
+    pthread_mutex_init(&lock, NULL);
 
     for (int i = 0; i < nb_threads; i++) {
-        t[i] = create_blocked_thread(i+1);
-    }
-
-    for (int i = 0; i < nb_threads; i++) {
-        args[i].b = b;
-        args[i].t = t[i];
-        usleep(100000); // sleep for 100 milliseconds (0.1 seconds)
+        assert(init_blocked_thread(&t[i], i + 1));
+        args[i] = (thread_arg) { .b = b, .t = &t[i], .inside = &inside, .max_inside = &max_inside, .lock = &lock };
         pthread_create(&threads[i], NULL, enter_batcher_thread, (void*)&args[i]);
     }
 
     for (int i = 0; i < nb_threads; i++) {
         pthread_join(threads[i], NULL);
+        destroy_blocked_thread(&t[i]);
     }
 
+    assert(inside == 0);
+    assert(b->remaining == 0);
+    assert(b->blocked_threads_head == NULL);
+    assert(epochs_ended > 0 && (uint64_t) epochs_ended == b->epoch);
+    assert(max_inside >= 1 && max_inside <= nb_threads);
+
+    pthread_mutex_destroy(&lock);
     destroy_batcher(b);
     b = NULL;
 }
@@ -73,40 +88,1141 @@ void batcher_test(void) {
 /* MEMORY TESTS */
 
 void memory_test(void) {
-    // Memory Initialization
-    printf("Initializing memory\n");
-    memory* mem = init_memory();
-    print_memory(mem);
-
-    // Memory Allocation
-    printf("Allocating 4 segments\n");
-    int new_index1 = allocate_segment(mem);
-    int new_index2 = allocate_segment(mem);
-    int new_index3 = allocate_segment(mem);
-    int new_index4 = allocate_segment(mem);
-    print_memory(mem);
-
-    // Memory Deallocation 1
-    printf("Freeing segment %d\n", new_index3);
-    deallocate_segment(mem, new_index3);
-    print_memory(mem);
-
-    // Memory Deallocation 2
-    printf("Freeing segment %d\n", new_index1);
-    deallocate_segment(mem, new_index1);
-    print_memory(mem);
-
-    // Memory Deallocation Failure Test
-    printf("Freeing segment 0, Should not work\n");
-    fflush(stdout);
-    deallocate_segment(mem, 0);
-    print_memory(mem);
+    memory* mem = init_memory(NULL);
+
+    int new_index1 = allocate_segment(mem, 64, 8);
+    int new_index2 = allocate_segment(mem, 128, 8);
+    int new_index3 = allocate_segment(mem, 8, 8);
+    assert(new_index1 > 0 && new_index2 > 0 && new_index3 > 0);
+    assert(mem->nb_segments == 3);
+    assert(get_segment(mem, new_index2)->nb_words == 16);
+
+    deallocate_segment(mem, new_index2);
+    assert(get_segment(mem, new_index2) == NULL);
+    assert(mem->nb_segments == 2);
+
+    // Freed ids are reused
+    int new_index4 = allocate_segment(mem, 32, 8);
+    assert(new_index4 == new_index2);
 
     destroy_memory(mem);
     mem = NULL;
 }
 
+
+/* TRANSACTION TESTS */
+
+void transaction_test(void) {
+    shared_t shared = tm_create(64, 8);
+    assert(shared != invalid_shared);
+    uint64_t* start = (uint64_t*) tm_start(shared);
+    assert(tm_size(shared) == 64 && tm_align(shared) == 8);
+
+    // Committed writes become visible in the next transaction, but not in the same epoch
+    uint64_t values[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    tx_t tx = tm_begin(shared, false);
+    assert(tm_write(shared, tx, values, sizeof(values), start));
+    uint64_t read[8];
+    assert(tm_read(shared, tx, start + 2, 8, read));
+    assert(read[0] == 3);
+    assert(tm_end(shared, tx));
+
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, start, sizeof(read), read));
+    assert(memcmp(read, values, sizeof(values)) == 0);
+    assert(tm_end(shared, tx));
+
+    // Allocation, then free in a later transaction
+    void* segment;
+    tx = tm_begin(shared, false);
+    assert(tm_alloc(shared, tx, 16, &segment) == success_alloc);
+    assert(tm_write(shared, tx, &segment, sizeof(segment), start + 7));
+    assert(tm_end(shared, tx));
+
+    tx = tm_begin(shared, false);
+    void* pointer;
+    assert(tm_read(shared, tx, start + 7, sizeof(pointer), &pointer));
+    assert(pointer == segment);
+    assert(tm_read(shared, tx, pointer, 8, read));
+    assert(read[0] == 0);
+    assert(tm_free(shared, tx, pointer));
+    assert(tm_end(shared, tx));
+
+    // Vectored accesses, scattered and out of order
+    uint64_t a = 10, b = 20, c = 30, x, y, z;
+    tm_vec writes[] = { { start + 5, 8, &a }, { start, 8, &b }, { start + 3, 8, &c } };
+    tm_vec reads[] = { { start + 3, 8, &x }, { start + 5, 8, &y }, { start, 8, &z } };
+    tx = tm_begin(shared, false);
+    assert(tm_writev(shared, tx, writes, 3));
+    assert(tm_end(shared, tx));
+    tx = tm_begin(shared, true);
+    assert(tm_readv(shared, tx, reads, 3));
+    assert(tm_end(shared, tx));
+    assert(x == 30 && y == 10 && z == 20);
+
+    // In-place copies with overlapping ranges, as 'memmove', and fills
+    tx = tm_begin(shared, false);
+    assert(tm_copy(shared, tx, start, 32, start + 1));
+    assert(tm_fill(shared, tx, start + 6, 16, 0xff));
+    assert(tm_end(shared, tx));
+    tx = tm_begin(shared, false);
+    assert(tm_read(shared, tx, start, sizeof(read), read));
+    assert(read[0] == 20 && read[1] == 20 && read[2] == 2 && read[3] == 3 && read[4] == 30 && read[5] == 10);
+    assert(read[6] == UINT64_MAX && read[7] == UINT64_MAX);
+    assert(tm_copy(shared, tx, start + 1, 32, start));
+    assert(tm_end(shared, tx));
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, start, 32, read));
+    assert(tm_end(shared, tx));
+    assert(read[0] == 20 && read[1] == 2 && read[2] == 3 && read[3] == 30);
+
+    // Copies onto the same range keep the latest values, written in earlier epochs or in the same transaction
+    for (uint64_t i = 1; i <= 3; i++) {
+        tx = tm_begin(shared, false);
+        assert(tm_write(shared, tx, &i, 8, start));
+        assert(tm_end(shared, tx));
+    }
+    tx = tm_begin(shared, false);
+    assert(tm_copy(shared, tx, start, 8, start));
+    assert(tm_write(shared, tx, &c, 8, start + 1));
+    assert(tm_copy(shared, tx, start + 1, 8, start + 1));
+    assert(tm_end(shared, tx));
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, start, 16, read));
+    assert(tm_end(shared, tx));
+    assert(read[0] == 3 && read[1] == 30);
+
+    // Hinted transactions, accessing more words than expected or none
+    tm_hints hints = { .reads = 1, .writes = 1, .priority = 1 };
+    tx = tm_begin_ex(shared, false, &hints);
+    assert(tm_write(shared, tx, values, sizeof(values), start));
+    assert(tm_end(shared, tx));
+    tm_hints scan = { .reads = 8, .long_scan = true };
+    tx = tm_begin_ex(shared, true, &scan);
+    assert(tm_read(shared, tx, start, sizeof(read), read));
+    assert(tm_end(shared, tx));
+    assert(memcmp(read, values, sizeof(values)) == 0);
+    tx = tm_begin_ex(shared, false, NULL);
+    assert(tm_end(shared, tx));
+    tm_hints huge = { .reads = SIZE_MAX / 2, .writes = SIZE_MAX / 2 + 2, .priority = -1 };
+    tx = tm_begin_ex(shared, false, &huge);
+    assert(tx != invalid_tx);
+    assert(tm_write(shared, tx, values, sizeof(values), start));
+    assert(tm_end(shared, tx));
+
+    tm_destroy(shared);
+}
+
+void multiversion_test(void) {
+    setenv("DV_MULTIVERSION", "1", 1);
+    shared_t shared = tm_create(16, 8);
+    unsetenv("DV_MULTIVERSION");
+    uint64_t* start = (uint64_t*) tm_start(shared);
+    uint64_t value = 1, read;
+
+    tx_t tx = tm_begin(shared, false);
+    assert(tm_write(shared, tx, &value, 8, start));
+    assert(tm_end(shared, tx));
+
+    // A read-only transaction keeps reading its snapshot while writers commit, and does not hold back their epochs
+    tx_t ro = tm_begin(shared, true);
+    for (value = 2; value < 5; value++) {
+        tx = tm_begin(shared, false);
+        assert(tm_write(shared, tx, &value, 8, start));
+        assert(tm_end(shared, tx));
+    }
+    assert(tm_read(shared, ro, start, 8, &read));
+    assert(read == 1);
+    assert(tm_read(shared, ro, start + 1, 8, &read));
+    assert(read == 0);
+    assert(tm_end(shared, ro));
+
+    ro = tm_begin(shared, true);
+    assert(tm_read(shared, ro, start, 8, &read));
+    assert(read == 4);
+    assert(tm_end(shared, ro));
+
+    tm_destroy(shared);
+
+    // A value over the bound is not saved, and cuts the chain of its word instead of leaving a gap in it
+    memory* mem = init_memory(NULL);
+    mem->multiversion = true;
+    segment* seg = get_segment(mem, allocate_segment(mem, 8, 8));
+    multiversion* mv = init_multiversion(1);
+    int slots[3];
+    uint64_t versions[3];
+    assert(mv_pin(mv, &slots[0], &versions[0]) && versions[0] == 0);
+    for (value = 1; value < 4; value++) {
+        if (value == 2) {
+            assert(mv_pin(mv, &slots[1], &versions[1]) && versions[1] == 1);
+            mv_unpin(mv, slots[0]);
+        } else if (value == 3) {
+            assert(mv_pin(mv, &slots[2], &versions[2]) && versions[2] == 2);
+        }
+        uint64_t control = atomic_load(&seg->controls[0]);
+        memcpy(seg->copies[(control & CONTROL_READABLE) ? 0 : 1], &value, 8);
+        mv_begin_epoch_end(mv);
+        mv_install_word(mv, seg, 0, control ^ CONTROL_READABLE);
+        mv_finish_epoch_end(mv, mem);
+        if (value == 2)
+            assert(atomic_load(&seg->versions[0]) == NULL && mv->nb_versions == 0);
+    }
+    assert(!mv_read_word(seg, 0, versions[1], &read));
+    assert(mv_read_word(seg, 0, versions[2], &read) && read == 2);
+    assert(mv_read_word(seg, 0, 3, &read) && read == 3);
+    mv_unpin(mv, slots[1]);
+    mv_unpin(mv, slots[2]);
+    destroy_multiversion(mv);
+    destroy_memory(mem);
+}
+
+void snapshot_test(void) {
+    setenv("DV_SNAPSHOT", "1", 1);
+    shared_t shared = tm_create(8192, 8);
+    unsetenv("DV_SNAPSHOT");
+    uint64_t* start = (uint64_t*) tm_start(shared);
+    uint64_t value = 1, read;
+
+    tx_t tx = tm_begin(shared, false);
+    assert(tm_write(shared, tx, &value, 8, start));
+    assert(tm_end(shared, tx));
+
+    // The page written after the snapshot is cloned, the other one is read in place
+    tx_t ro = tm_begin(shared, true);
+    tx_t shared_ro = tm_begin(shared, true);
+    for (value = 2; value < 5; value++) {
+        tx = tm_begin(shared, false);
+        assert(tm_write(shared, tx, &value, 8, start));
+        assert(tm_write(shared, tx, &value, 8, start + 1));
+        assert(tm_end(shared, tx));
+    }
+    assert(tm_read(shared, ro, start, 8, &read));
+    assert(read == 1);
+    assert(tm_read(shared, ro, start + 1, 8, &read));
+    assert(read == 0);
+    assert(tm_read(shared, ro, start + 1023, 8, &read));
+    assert(read == 0);
+    assert(tm_end(shared, ro));
+    assert(tm_read(shared, shared_ro, start, 8, &read));
+    assert(read == 1);
+    assert(tm_end(shared, shared_ro));
+
+    ro = tm_begin(shared, true);
+    assert(tm_read(shared, ro, start, 8, &read));
+    assert(read == 4);
+    assert(tm_end(shared, ro));
+
+    tm_destroy(shared);
+
+    // A value over the bound is not saved, and cuts the chain of its word instead of leaving a gap in it
+    memory* mem = init_memory(NULL);
+    mem->multiversion = true;
+    segment* seg = get_segment(mem, allocate_segment(mem, 8, 8));
+    multiversion* mv = init_multiversion(1);
+    int slots[3];
+    uint64_t versions[3];
+    assert(mv_pin(mv, &slots[0], &versions[0]) && versions[0] == 0);
+    for (value = 1; value < 4; value++) {
+        if (value == 2) {
+            assert(mv_pin(mv, &slots[1], &versions[1]) && versions[1] == 1);
+            mv_unpin(mv, slots[0]);
+        } else if (value == 3) {
+            assert(mv_pin(mv, &slots[2], &versions[2]) && versions[2] == 2);
+        }
+        uint64_t control = atomic_load(&seg->controls[0]);
+        memcpy(seg->copies[(control & CONTROL_READABLE) ? 0 : 1], &value, 8);
+        mv_begin_epoch_end(mv);
+        mv_install_word(mv, seg, 0, control ^ CONTROL_READABLE);
+        mv_finish_epoch_end(mv, mem);
+        if (value == 2)
+            assert(atomic_load(&seg->versions[0]) == NULL && mv->nb_versions == 0);
+    }
+    assert(!mv_read_word(seg, 0, versions[1], &read));
+    assert(mv_read_word(seg, 0, versions[2], &read) && read == 2);
+    assert(mv_read_word(seg, 0, 3, &read) && read == 3);
+    mv_unpin(mv, slots[1]);
+    mv_unpin(mv, slots[2]);
+    destroy_multiversion(mv);
+    destroy_memory(mem);
+}
+
+typedef struct {
+    shared_t shared;
+    pthread_barrier_t* barrier;
+    bool validate_previous;     // Whether the elastic reader moves on right after the write to the word it read last
+} elastic_arg;
+
+void* elastic_reader_thread(void* arg) {
+    elastic_arg* ea = (elastic_arg*) arg;
+    uint64_t* start = (uint64_t*) tm_start(ea->shared);
+    uint64_t value;
+    tx_t tx = tm_begin(ea->shared, false);
+    pthread_barrier_wait(ea->barrier); // Both transactions are in the same epoch
+    assert(tm_read_elastic(ea->shared, tx, start, 8, &value));
+    if (ea->validate_previous) {
+        pthread_barrier_wait(ea->barrier);
+        pthread_barrier_wait(ea->barrier); // The first word was written by the other transaction
+        assert(!tm_read_elastic(ea->shared, tx, start + 1, 8, &value));
+        return NULL;
+    }
+    assert(tm_read_elastic(ea->shared, tx, start + 1, 8, &value));
+    assert(tm_read_elastic(ea->shared, tx, start + 2, 8, &value));
+    pthread_barrier_wait(ea->barrier);
+    pthread_barrier_wait(ea->barrier); // The first word, out of the window, was written by the other transaction
+    value = 1;
+    assert(tm_write(ea->shared, tx, &value, 8, start + 3));
+    assert(tm_end(ea->shared, tx));
+    return NULL;
+}
+
+void* elastic_writer_thread(void* arg) {
+    elastic_arg* ea = (elastic_arg*) arg;
+    uint64_t* start = (uint64_t*) tm_start(ea->shared);
+    uint64_t value = 1;
+    tx_t tx = tm_begin(ea->shared, false);
+    pthread_barrier_wait(ea->barrier);
+    pthread_barrier_wait(ea->barrier);
+    assert(tm_write(ea->shared, tx, &value, 8, start)); // Elastic reads do not join the access set
+    pthread_barrier_wait(ea->barrier);
+    assert(tm_end(ea->shared, tx));
+    return NULL;
+}
+
+void elastic_test(bool validate_previous) {
+    shared_t shared = tm_create(32, 8);
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, 2);
+    elastic_arg arg = { .shared = shared, .barrier = &barrier, .validate_previous = validate_previous };
+
+    // Both threads wait for the end of this transaction, then run in the same epoch
+    tx_t tx = tm_begin(shared, false);
+    pthread_t reader, writer;
+    pthread_create(&reader, NULL, elastic_reader_thread, &arg);
+    pthread_create(&writer, NULL, elastic_writer_thread, &arg);
+    usleep(100000);
+    assert(tm_end(shared, tx));
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+
+    uint64_t values[4];
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(values), values));
+    assert(tm_end(shared, tx));
+    assert(values[0] == 1 && values[3] == (validate_previous ? 0 : 1));
+    pthread_barrier_destroy(&barrier);
+    tm_destroy(shared);
+}
+
+typedef struct {
+    shared_t shared;
+    int nb_transfers;
+    int skew;                   // Percentage of the transfers that take from the first, hot account
+} bank_arg;
+
+void* bank_thread(void* arg) {
+    bank_arg* ba = (bank_arg*) arg;
+    int64_t* accounts = (int64_t*) tm_start(ba->shared);
+    unsigned int seed = (unsigned int) (uintptr_t) pthread_self();
+    for (int i = 0; i < ba->nb_transfers; i++) {
+        int from = rand_r(&seed) % 100 < ba->skew ? 0 : rand_r(&seed) % 4, to = rand_r(&seed) % 4;
+        while (true) {
+            tx_t tx = tm_begin(ba->shared, false);
+            int64_t a, b;
+            if (!tm_read(ba->shared, tx, accounts + from, 8, &a)) continue;
+            a -= 1;
+            if (!tm_write(ba->shared, tx, &a, 8, accounts + from)) continue;
+            if (!tm_read(ba->shared, tx, accounts + to, 8, &b)) continue;
+            b += 1;
+            if (!tm_write(ba->shared, tx, &b, 8, accounts + to)) continue;
+            if (tm_end(ba->shared, tx)) break;
+        }
+    }
+    return NULL;
+}
+
+void* audit_thread(void* arg) {
+    bank_arg* ba = (bank_arg*) arg;
+    for (int i = 0; i < ba->nb_transfers; i++) {
+        int64_t accounts[4];
+        tx_t tx = tm_begin(ba->shared, true);
+        if (!tm_read(ba->shared, tx, tm_start(ba->shared), sizeof(accounts), accounts)) continue;
+        assert(tm_end(ba->shared, tx));
+        assert(accounts[0] + accounts[1] + accounts[2] + accounts[3] == 0);
+    }
+    return NULL;
+}
+
+void* irrevocable_thread(void* arg) {
+    bank_arg* ba = (bank_arg*) arg;
+    int64_t* accounts = (int64_t*) tm_start(ba->shared);
+    for (int i = 0; i < ba->nb_transfers; i++) {
+        // Runs alone in its epoch: no operation can fail
+        tx_t tx = tm_begin_irrevocable(ba->shared);
+        int64_t a, b;
+        assert(tm_read(ba->shared, tx, accounts + i % 4, 8, &a));
+        assert(tm_read(ba->shared, tx, accounts + (i + 1) % 4, 8, &b));
+        a -= 2;
+        b += 2;
+        assert(tm_write(ba->shared, tx, &a, 8, accounts + i % 4));
+        assert(tm_write(ba->shared, tx, &b, 8, accounts + (i + 1) % 4));
+        assert(tm_end(ba->shared, tx));
+    }
+    return NULL;
+}
+
+void irrevocable_test(void) {
+    enum { nb_threads = 8 };
+    shared_t shared = tm_create(32, 8);
+    pthread_t threads[nb_threads];
+    bank_arg arg = { .shared = shared, .nb_transfers = 1000 };
+    for (int i = 0; i < nb_threads; i++)
+        pthread_create(&threads[i], NULL, i % 4 == 0 ? irrevocable_thread : i % 2 == 0 ? bank_thread : audit_thread, &arg);
+    for (int i = 0; i < nb_threads; i++)
+        pthread_join(threads[i], NULL);
+    tm_destroy(shared);
+}
+
+void concurrency_test(char const* mode, int skew) {
+    enum { nb_threads = 8 };
+    if (mode != NULL) setenv(mode, "1", 1);
+    shared_t shared = tm_create(32, 8);
+    if (mode != NULL) unsetenv(mode);
+    pthread_t threads[nb_threads];
+    bank_arg arg = { .shared = shared, .nb_transfers = 1000, .skew = skew };
+    for (int i = 0; i < nb_threads; i++)
+        pthread_create(&threads[i], NULL, i % 2 == 0 ? bank_thread : audit_thread, &arg);
+    for (int i = 0; i < nb_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    int64_t accounts[4];
+    tx_t tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(accounts), accounts));
+    assert(tm_end(shared, tx));
+    assert(accounts[0] + accounts[1] + accounts[2] + accounts[3] == 0);
+    tm_destroy(shared);
+}
+
+void* adding_thread(void* arg) {
+    bank_arg* ba = (bank_arg*) arg;
+    int64_t* accounts = (int64_t*) tm_start(ba->shared);
+    unsigned int seed = (unsigned int) (uintptr_t) pthread_self();
+    for (int i = 0; i < ba->nb_transfers; i++) {
+        int from = rand_r(&seed) % 4, to = rand_r(&seed) % 4;
+        while (true) {
+            tx_t tx = tm_begin(ba->shared, false);
+            int64_t a;
+            if (i % 8 == 0) { // Reads a word it added to, which falls back to plain semantics
+                if (!tm_add_i64(ba->shared, tx, accounts + to, 1)) continue;
+                if (!tm_read(ba->shared, tx, accounts + to, 8, &a)) continue;
+                if (!tm_add_i64(ba->shared, tx, accounts + from, -1)) continue;
+            } else { // Reads the sender only, adds to the receiver (plainly if it is also the sender)
+                if (!tm_read(ba->shared, tx, accounts + from, 8, &a)) continue;
+                a -= 1;
+                if (!tm_write(ba->shared, tx, &a, 8, accounts + from)) continue;
+                if (!tm_add_i64(ba->shared, tx, accounts + to, 1)) continue;
+            }
+            if (tm_end(ba->shared, tx)) break;
+        }
+    }
+    return NULL;
+}
+
+void commutative_test(char const* mode) {
+    enum { nb_threads = 8 };
+    if (mode != NULL) setenv(mode, "1", 1);
+    shared_t shared = tm_create(32, 8);
+    if (mode != NULL) unsetenv(mode);
+    int64_t* accounts = (int64_t*) tm_start(shared);
+
+    // Adds of one transaction accumulate, and are visible to the next ones
+    tx_t tx = tm_begin(shared, false);
+    assert(tm_add_i64(shared, tx, accounts, 5));
+    assert(tm_add_i64(shared, tx, accounts, -2));
+    assert(tm_end(shared, tx));
+    int64_t value;
+    tx = tm_begin(shared, false);
+    assert(tm_read(shared, tx, accounts, 8, &value));
+    assert(value == 3);
+    value = 0;
+    assert(tm_write(shared, tx, &value, 8, accounts));
+    assert(tm_end(shared, tx));
+
+    pthread_t threads[nb_threads];
+    bank_arg arg = { .shared = shared, .nb_transfers = 1000 };
+    for (int i = 0; i < nb_threads; i++)
+        pthread_create(&threads[i], NULL, i % 4 == 3 ? audit_thread : i % 4 == 2 ? bank_thread : adding_thread, &arg);
+    for (int i = 0; i < nb_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    int64_t values[4];
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, accounts, sizeof(values), values));
+    assert(tm_end(shared, tx));
+    assert(values[0] + values[1] + values[2] + values[3] == 0);
+    tm_destroy(shared);
+}
+
+void* static_thread(void* arg) {
+    bank_arg* ba = (bank_arg*) arg;
+    int64_t* accounts = (int64_t*) tm_start(ba->shared);
+    unsigned int seed = (unsigned int) (uintptr_t) pthread_self();
+    for (int i = 0; i < ba->nb_transfers; i++) {
+        int from = rand_r(&seed) % 4, to = rand_r(&seed) % 4;
+        tm_range writes[] = { { accounts + from, 8 }, { accounts + to, 8 } };
+        tm_range reads[] = { { accounts, 32 } };
+        if (i % 4 == 0) { // Audit: only reads, concurrently with static readers
+            tx_t tx = tm_begin_static(ba->shared, reads, 1, NULL, 0);
+            int64_t values[4];
+            assert(tm_read(ba->shared, tx, accounts, sizeof(values), values));
+            assert(tm_end(ba->shared, tx));
+            assert(values[0] + values[1] + values[2] + values[3] == 0);
+            continue;
+        }
+        // Runs with transactions whose footprints do not conflict with its own: no operation can fail
+        tx_t tx = tm_begin_static(ba->shared, NULL, 0, writes, 2);
+        int64_t a, b;
+        assert(tm_read(ba->shared, tx, accounts + from, 8, &a));
+        a -= 1;
+        assert(tm_write(ba->shared, tx, &a, 8, accounts + from));
+        assert(tm_read(ba->shared, tx, accounts + to, 8, &b));
+        b += 1;
+        assert(tm_write(ba->shared, tx, &b, 8, accounts + to));
+        assert(tm_end(ba->shared, tx));
+    }
+    return NULL;
+}
+
+void static_test(void) {
+    enum { nb_threads = 8 };
+    shared_t shared = tm_create(32, 8);
+    pthread_t threads[nb_threads];
+    bank_arg arg = { .shared = shared, .nb_transfers = 1000 };
+    for (int i = 0; i < nb_threads; i++)
+        pthread_create(&threads[i], NULL, i % 4 == 3 ? audit_thread : i % 2 == 0 ? static_thread : bank_thread, &arg);
+    for (int i = 0; i < nb_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    int64_t values[4];
+    tx_t tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(values), values));
+    assert(tm_end(shared, tx));
+    assert(values[0] + values[1] + values[2] + values[3] == 0);
+
+    // A footprint outside of the allocated segments, or not aligned, is refused
+    int64_t* start = (int64_t*) tm_start(shared);
+    tm_range past_end[] = { { start + 3, 16 } };
+    tm_range unaligned[] = { { start, 12 } };
+    tm_range unallocated[] = { { segment_address(MAX_SEGMENTS - 1, 0), 8 } };
+    assert(tm_begin_static(shared, past_end, 1, NULL, 0) == invalid_tx);
+    assert(tm_begin_static(shared, NULL, 0, unaligned, 1) == invalid_tx);
+    assert(tm_begin_static(shared, NULL, 0, unallocated, 1) == invalid_tx);
+    tm_destroy(shared);
+
+    // A footprint wider than the key set takes every key, and still runs
+    shared = tm_create(8 * BATCHER_KEYS * 2, 8);
+    tm_range whole[] = { { tm_start(shared), 8 * BATCHER_KEYS * 2 } };
+    tx = tm_begin_static(shared, NULL, 0, whole, 1);
+    assert(tx != invalid_tx);
+    int64_t one = 1;
+    assert(tm_write(shared, tx, &one, 8, (int64_t*) tm_start(shared) + BATCHER_KEYS));
+    assert(tm_end(shared, tx));
+    tm_destroy(shared);
+}
+
+typedef struct transfer {
+    int from;
+    int to;
+} transfer;
+
+bool transfer_body(shared_t shared, tx_t tx, void* arg) {
+    transfer* t = (transfer*) arg;
+    int64_t* accounts = (int64_t*) tm_start(shared);
+    int64_t a, b;
+    if (!tm_read(shared, tx, accounts + t->from, 8, &a)) return false;
+    a -= 1;
+    if (!tm_write(shared, tx, &a, 8, accounts + t->from)) return false;
+    if (!tm_read(shared, tx, accounts + t->to, 8, &b)) return false;
+    b += 1;
+    return tm_write(shared, tx, &b, 8, accounts + t->to);
+}
+
+void* run_thread(void* arg) {
+    bank_arg* ba = (bank_arg*) arg;
+    unsigned int seed = (unsigned int) (uintptr_t) pthread_self();
+    for (int i = 0; i < ba->nb_transfers; i++) {
+        transfer t = { .from = rand_r(&seed) % 100 < ba->skew ? 0 : rand_r(&seed) % 4, .to = rand_r(&seed) % 4 };
+        if (i % 2 == 0) {
+            assert(tm_run(ba->shared, false, transfer_body, &t));
+        } else { // Hinted: the access log sized once for every attempt
+            tm_hints hints = { .reads = 2, .writes = 2, .priority = i % 3 - 1 };
+            assert(tm_run_ex(ba->shared, false, &hints, transfer_body, &t));
+        }
+    }
+    return NULL;
+}
+
+typedef struct increment {
+    shared_t shared;
+    tm_hints const* hints;
+    _Atomic(int) attempts;
+} increment;
+
+bool increment_body(shared_t shared, tx_t tx, void* arg) {
+    increment* inc = (increment*) arg;
+    int64_t* counter = (int64_t*) tm_start(shared);
+    int64_t value;
+    atomic_fetch_add(&inc->attempts, 1);
+    if (!tm_read(shared, tx, counter, 8, &value)) return false;
+    usleep(1000); // Lets the other thread read it too
+    value += 1;
+    return tm_write(shared, tx, &value, 8, counter);
+}
+
+void* increment_thread(void* arg) {
+    assert(tm_run_ex(((increment*) arg)->shared, false, ((increment*) arg)->hints, increment_body, arg));
+    return NULL;
+}
+
+bool give_up_body(shared_t shared, tx_t tx, void* arg) {
+    int* attempts = (int*) arg;
+    int64_t* counter = (int64_t*) tm_start(shared);
+    int64_t value;
+    if (!tm_read(shared, tx, counter, 8, &value)) return false;
+    value += 1;
+    if (!tm_write(shared, tx, &value, 8, counter)) return false;
+    return ++*attempts > 1; // Gives up on its first attempt, after it wrote
+}
+
+void run_test(char const* mode) {
+    enum { nb_threads = 8 };
+    if (mode != NULL) setenv(mode, "1", 1);
+    shared_t shared = tm_create(32, 8);
+    if (mode != NULL) unsetenv(mode);
+
+    // Two increments admitted into the same epoch conflict: one is retried, its transaction kept
+    increment inc = { .shared = shared, .hints = NULL, .attempts = 0 };
+    pthread_t incrementers[2];
+    tx_t tx = tm_begin(shared, false);
+    for (int i = 0; i < 2; i++)
+        pthread_create(&incrementers[i], NULL, increment_thread, &inc);
+    usleep(10000);
+    assert(tm_end(shared, tx));
+    for (int i = 0; i < 2; i++)
+        pthread_join(incrementers[i], NULL);
+    int64_t accounts[4];
+    tx = tm_begin(shared, false);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(accounts), accounts));
+    assert(accounts[0] == 2 && atomic_load(&inc.attempts) > 2);
+    accounts[0] = 0;
+    assert(tm_write(shared, tx, accounts, 8, tm_start(shared)));
+    assert(tm_end(shared, tx));
+
+    // The library retries the transfers, the same transaction kept across attempts
+    pthread_t threads[nb_threads];
+    bank_arg arg = { .shared = shared, .nb_transfers = 1000, .skew = 90 };
+    for (int i = 0; i < nb_threads; i++)
+        pthread_create(&threads[i], NULL, i % 4 == 3 ? audit_thread : i % 4 == 2 ? bank_thread : run_thread, &arg);
+    for (int i = 0; i < nb_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(accounts), accounts));
+    assert(tm_end(shared, tx));
+    assert(accounts[0] + accounts[1] + accounts[2] + accounts[3] == 0);
+
+    // A body giving up without a failed operation is aborted, its write undone, before its transaction is admitted again
+    int attempts = 0;
+    int64_t before = accounts[0], after;
+    assert(tm_run(shared, false, give_up_body, &attempts));
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), 8, &after));
+    assert(tm_end(shared, tx));
+    assert(attempts == 2 && after == before + 1);
+    tm_destroy(shared);
+}
+
+void run_hints_test(void) {
+    setenv("DV_RUN_IRREVOCABLE_AFTER", "8", 1);
+    shared_t shared = tm_create(32, 8);
+    unsetenv("DV_RUN_IRREVOCABLE_AFTER");
+
+    // A high priority scales the threshold down to one abort: each increment retried runs irrevocably
+    tm_hints hints = { .reads = 1, .writes = 1, .priority = 7 };
+    increment inc = { .shared = shared, .hints = &hints, .attempts = 0 };
+    pthread_t incrementers[2];
+    tx_t tx = tm_begin(shared, false);
+    for (int i = 0; i < 2; i++)
+        pthread_create(&incrementers[i], NULL, increment_thread, &inc);
+    usleep(10000);
+    assert(tm_end(shared, tx));
+    for (int i = 0; i < 2; i++)
+        pthread_join(incrementers[i], NULL);
+    int64_t counter;
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), 8, &counter));
+    assert(tm_end(shared, tx));
+    assert(counter == 2 && atomic_load(&inc.attempts) > 2);
+    assert(atomic_load(&((region*) shared)->stats.irrevocable) == (uint64_t) atomic_load(&inc.attempts) - 2);
+    tm_destroy(shared);
+}
+
+void* writing_thread(void* arg) {
+    shared_t shared = (shared_t) arg;
+    uint64_t value = 1;
+    tx_t tx = tm_begin(shared, false);
+    assert(tm_write(shared, tx, &value, 8, tm_start(shared)));
+    assert(tm_end(shared, tx));
+    return NULL;
+}
+
+void timed_test(void) {
+    shared_t shared = tm_create(16, 8);
+
+    // Gives up while the epoch of another transaction runs, leaving the queue to the threads still waiting
+    tx_t tx = tm_begin(shared, false);
+    pthread_t thread;
+    pthread_create(&thread, NULL, writing_thread, shared);
+    usleep(10000);
+    errno = 0;
+    assert(tm_begin_timed(shared, false, 1000000) == invalid_tx && errno == ETIMEDOUT);
+    assert(tm_begin_timed(shared, true, 0) == invalid_tx && errno == ETIMEDOUT);
+    assert(tm_end(shared, tx));
+    pthread_join(thread, NULL);
+
+    // Admitted at once when no epoch runs
+    uint64_t value;
+    tx = tm_begin_timed(shared, true, 0);
+    assert(tx != invalid_tx);
+    assert(tm_read(shared, tx, tm_start(shared), 8, &value));
+    assert(tm_end(shared, tx));
+    assert(value == 1);
+    tm_destroy(shared);
+}
+
+void async_test(void) {
+    shared_t shared = tm_create(16, 8);
+    uint64_t* start = (uint64_t*) tm_start(shared);
+    uint32_t notify = 0;
+
+    // Admitted at once when no epoch runs
+    tx_t tx = tm_begin_async(shared, false, &notify);
+    assert(tx != invalid_tx && tm_admitted(shared, tx));
+    assert(tm_end(shared, tx));
+    assert(notify == 0);
+
+    // One thread interleaves transactions pending for the next epoch, all admitted when it opens
+    tx = tm_begin(shared, false);
+    tx_t pending[2];
+    for (int i = 0; i < 2; i++) {
+        pending[i] = tm_begin_async(shared, false, &notify);
+        assert(pending[i] != invalid_tx && !tm_admitted(shared, pending[i]));
+    }
+    assert(tm_end(shared, tx));
+    assert(tm_wait_admission(shared, &notify, 0) == 2);
+    for (uint64_t i = 0; i < 2; i++) {
+        assert(tm_admitted(shared, pending[i]));
+        assert(tm_write(shared, pending[i], &i, 8, start + i));
+    }
+    for (int i = 0; i < 2; i++)
+        assert(tm_end(shared, pending[i]));
+
+    uint64_t values[2];
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, start, sizeof(values), values));
+    assert(tm_end(shared, tx));
+    assert(values[0] == 0 && values[1] == 1);
+    tm_destroy(shared);
+}
+
+void regions_test(void) {
+    enum { nb_regions = 4, nb_threads = 3 };
+    shared_t shared[nb_regions];
+    bank_arg args[nb_regions];
+    pthread_t threads[nb_regions][nb_threads];
+    for (int r = 0; r < nb_regions; r++) {
+        shared[r] = tm_create(32, 8);
+        assert(shared[r] != invalid_shared);
+        args[r] = (bank_arg) { .shared = shared[r], .nb_transfers = 1000, .skew = r % 2 == 0 ? 0 : 90 };
+    }
+    // Each region has its own batcher: the transfers on one region never wait for the others
+    for (int r = 0; r < nb_regions; r++) {
+        for (int i = 0; i < nb_threads; i++)
+            pthread_create(&threads[r][i], NULL, i < 2 ? bank_thread : audit_thread, &args[r]);
+    }
+    for (int r = 0; r < nb_regions; r++) {
+        for (int i = 0; i < nb_threads; i++)
+            pthread_join(threads[r][i], NULL);
+    }
+    for (int r = 0; r < nb_regions; r++) {
+        int64_t accounts[4];
+        tx_t tx = tm_begin(shared[r], true);
+        assert(tm_read(shared[r], tx, tm_start(shared[r]), sizeof(accounts), accounts));
+        assert(tm_end(shared[r], tx));
+        assert(accounts[0] + accounts[1] + accounts[2] + accounts[3] == 0);
+        tm_destroy(shared[r]);
+    }
+}
+
+void shared_test(void) {
+    enum { nb_processes = 3, nb_threads = 2 };
+    char name[64];
+    snprintf(name, sizeof(name), "/dv_test_%d", (int) getpid());
+    shared_t shared = tm_create_shared(name, 64 << 20, 32, 8);
+    assert(shared != invalid_shared);
+    pid_t children[nb_processes];
+    for (int p = 0; p < nb_processes; p++) {
+        children[p] = fork();
+        assert(children[p] >= 0);
+        if (children[p] == 0) {
+            // Joins by name, as an unrelated process would, and finds the region at the same address
+            tm_detach(shared);
+            shared_t attached = tm_attach(name);
+            if (attached != shared) _exit(1);
+            bank_arg arg = { .shared = attached, .nb_transfers = 1000, .skew = p == 0 ? 90 : 0 };
+            pthread_t threads[nb_threads];
+            for (int i = 0; i < nb_threads; i++)
+                pthread_create(&threads[i], NULL, i == 0 ? bank_thread : audit_thread, &arg);
+            for (int i = 0; i < nb_threads; i++)
+                pthread_join(threads[i], NULL);
+            tm_detach(attached);
+            _exit(0);
+        }
+    }
+    bank_arg arg = { .shared = shared, .nb_transfers = 1000 };
+    audit_thread(&arg);
+    for (int p = 0; p < nb_processes; p++) {
+        int status;
+        assert(waitpid(children[p], &status, 0) == children[p]);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    int64_t accounts[4];
+    tx_t tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(accounts), accounts));
+    assert(tm_end(shared, tx));
+    assert(accounts[0] + accounts[1] + accounts[2] + accounts[3] == 0);
+    tm_destroy(shared);
+}
+
+void persistent_test(void) {
+    enum { nb_threads = 4 };
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/dv_test_%d", (int) getpid());
+    shared_t shared = tm_create_file(path, 64 << 20, 32, 8);
+    assert(shared != invalid_shared);
+    pthread_t threads[nb_threads];
+    bank_arg arg = { .shared = shared, .nb_transfers = 1000, .skew = 50 };
+    for (int i = 0; i < nb_threads; i++)
+        pthread_create(&threads[i], NULL, i % 2 == 0 ? bank_thread : audit_thread, &arg);
+    for (int i = 0; i < nb_threads; i++)
+        pthread_join(threads[i], NULL);
+    int64_t before[4];
+    tx_t tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(before), before));
+    assert(tm_end(shared, tx));
+    tm_close(shared);
+
+    // A process stopping in the middle of a transaction leaves its write out of the region
+    pid_t child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        shared_t reopened = tm_open(path);
+        if (reopened == invalid_shared) _exit(1);
+        int64_t value = 42;
+        tx = tm_begin(reopened, false);
+        if (!tm_write(reopened, tx, &value, 8, tm_start(reopened))) _exit(1);
+        _exit(0);
+    }
+    int status;
+    assert(waitpid(child, &status, 0) == child);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    shared = tm_open(path);
+    assert(shared != invalid_shared);
+    int64_t after[4];
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(after), after));
+    assert(tm_end(shared, tx));
+    assert(memcmp(before, after, sizeof(before)) == 0);
+    arg.shared = shared;
+    bank_thread(&arg);
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(after), after));
+    assert(tm_end(shared, tx));
+    assert(after[0] + after[1] + after[2] + after[3] == 0);
+    tm_destroy(shared);
+}
+
+void wal_test(bool async) {
+    enum { nb_threads = 4 };
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/dv_wal_%d", (int) getpid());
+    setenv("DV_WAL", path, 1);
+    if (async) setenv("DV_WAL_ASYNC", "1", 1);
+    shared_t shared = tm_create(32, 8);
+    assert(shared != invalid_shared);
+    pthread_t threads[nb_threads];
+    bank_arg arg = { .shared = shared, .nb_transfers = 1000, .skew = 50 };
+    for (int i = 0; i < nb_threads; i++)
+        pthread_create(&threads[i], NULL, i % 2 == 0 ? bank_thread : audit_thread, &arg);
+    for (int i = 0; i < nb_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    // A committed allocation is replayed under the same address, an aborted one is not
+    void* kept;
+    void* dropped;
+    int64_t value = 42;
+    tx_t tx = tm_begin(shared, false);
+    assert(tm_alloc(shared, tx, 16, &dropped) == success_alloc);
+    assert(!tm_free(shared, tx, tm_start(shared)));
+    tx = tm_begin(shared, false);
+    assert(tm_alloc(shared, tx, 16, &kept) == success_alloc);
+    assert(tm_write(shared, tx, &value, 8, (int64_t*) kept + 1));
+    assert(tm_write(shared, tx, &kept, 8, (int64_t*) tm_start(shared) + 3));
+    assert(tm_end(shared, tx));
+    int64_t before[4];
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(before), before));
+    assert(tm_end(shared, tx));
+    tm_destroy(shared);
+
+    shared = tm_create(32, 8);
+    assert(shared != invalid_shared);
+    int64_t after[4];
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(after), after));
+    assert(tm_read(shared, tx, (int64_t*) kept + 1, 8, &value));
+    assert(tm_end(shared, tx));
+    assert(memcmp(before, after, sizeof(before)) == 0);
+    assert(value == 42);
+    tm_destroy(shared);
+
+    // A region of another shape cannot use the log
+    assert(tm_create(64, 8) == invalid_shared);
+    unlink(path);
+
+    // Regions living at the same time get a log each, and get them back when created again in the same order
+    int64_t values[2] = { 111, 222 };
+    shared_t regions[2];
+    for (int i = 0; i < 2; i++) {
+        regions[i] = tm_create(32, 8);
+        assert(regions[i] != invalid_shared);
+        tx = tm_begin(regions[i], false);
+        assert(tm_read(regions[i], tx, tm_start(regions[i]), 8, &value) && value == 0);
+        assert(tm_write(regions[i], tx, &values[i], 8, tm_start(regions[i])));
+        assert(tm_end(regions[i], tx));
+    }
+    for (int i = 0; i < 2; i++)
+        tm_destroy(regions[i]);
+    for (int i = 0; i < 2; i++) {
+        regions[i] = tm_create(32, 8);
+        assert(regions[i] != invalid_shared);
+        tx = tm_begin(regions[i], true);
+        assert(tm_read(regions[i], tx, tm_start(regions[i]), 8, &value) && value == values[i]);
+        assert(tm_end(regions[i], tx));
+    }
+    for (int i = 0; i < 2; i++)
+        tm_destroy(regions[i]);
+    unsetenv("DV_WAL");
+    unsetenv("DV_WAL_ASYNC");
+    unlink(path);
+    strcat(path, ".1");
+    unlink(path);
+}
+
+void checkpoint_test(void) {
+    enum { nb_threads = 4, nb_checkpoints = 20 };
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/dv_checkpoint_%d", (int) getpid());
+    shared_t shared = tm_create(65536, 8);
+    assert(shared != invalid_shared);
+    pthread_t threads[nb_threads];
+    bank_arg arg = { .shared = shared, .nb_transfers = 2000, .skew = 50 };
+    for (int i = 0; i < nb_threads; i++)
+        pthread_create(&threads[i], NULL, i % 2 == 0 ? bank_thread : audit_thread, &arg);
+    // Full, then incremental checkpoints, while the transfers run
+    for (int i = 0; i < nb_checkpoints; i++)
+        assert(tm_checkpoint(shared, path));
+    for (int i = 0; i < nb_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    // A word on another page, an allocated segment, and a segment freed after being checkpointed
+    void* kept;
+    void* freed;
+    int64_t value = 42;
+    tx_t tx = tm_begin(shared, false);
+    assert(tm_alloc(shared, tx, 16, &kept) == success_alloc);
+    assert(tm_alloc(shared, tx, 16, &freed) == success_alloc);
+    assert(tm_write(shared, tx, &value, 8, (int64_t*) kept + 1));
+    assert(tm_write(shared, tx, &value, 8, (int64_t*) tm_start(shared) + 5000));
+    assert(tm_end(shared, tx));
+    assert(tm_checkpoint(shared, path));
+    tx = tm_begin(shared, false);
+    assert(tm_free(shared, tx, freed));
+    assert(tm_end(shared, tx));
+    assert(tm_checkpoint(shared, path));
+    int64_t before[4];
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(before), before));
+    assert(tm_end(shared, tx));
+    tm_destroy(shared);
+
+    // An increment torn by a crash is ignored
+    FILE* file = fopen(path, "a");
+    assert(file != NULL);
+    fputs("torn increment", file);
+    fclose(file);
+
+    shared = tm_restore(path);
+    assert(shared != invalid_shared);
+    assert(tm_size(shared) == 65536 && tm_align(shared) == 8);
+    int64_t after[4], far = 0;
+    value = 0;
+    tx = tm_begin(shared, true);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(after), after));
+    assert(tm_read(shared, tx, (int64_t*) kept + 1, 8, &value));
+    assert(tm_read(shared, tx, (int64_t*) tm_start(shared) + 5000, 8, &far));
+    assert(tm_end(shared, tx));
+    assert(memcmp(before, after, sizeof(before)) == 0);
+    assert(value == 42 && far == 42);
+    // The freed segment is not restored: its id is the next one allocated
+    void* again;
+    tx = tm_begin(shared, false);
+    assert(tm_alloc(shared, tx, 16, &again) == success_alloc);
+    assert(tm_end(shared, tx));
+    assert(again == freed);
+    tm_destroy(shared);
+    unlink(path);
+
+    // Regions checkpointed in the background get a file each
+    char lock[80];
+    int64_t values[2] = { 111, 222 };
+    shared_t regions[2];
+    setenv("DV_CHECKPOINT", path, 1);
+    setenv("DV_CHECKPOINT_MS", "1", 1);
+    for (int i = 0; i < 2; i++) {
+        regions[i] = tm_create(64, 8);
+        assert(regions[i] != invalid_shared);
+        tx = tm_begin(regions[i], false);
+        assert(tm_write(regions[i], tx, &values[i], 8, tm_start(regions[i])));
+        assert(tm_end(regions[i], tx));
+    }
+    unsetenv("DV_CHECKPOINT");
+    unsetenv("DV_CHECKPOINT_MS");
+    for (int i = 0; i < 2; i++) {
+        if (i == 1)
+            strcat(path, ".1");
+        for (int attempt = 0; ; attempt++) { // Until a checkpoint taken after the write is complete
+            assert(attempt < 1000);
+            shared = access(path, F_OK) == 0 ? tm_restore(path) : invalid_shared;
+            value = 0;
+            if (shared != invalid_shared) {
+                tx = tm_begin(shared, true);
+                assert(tm_read(shared, tx, tm_start(shared), 8, &value));
+                assert(tm_end(shared, tx));
+                tm_destroy(shared);
+            }
+            if (value == values[i])
+                break;
+            usleep(1000);
+        }
+    }
+    for (int i = 0; i < 2; i++)
+        tm_destroy(regions[i]);
+    for (int i = 0; i < 2; i++) {
+        snprintf(path, sizeof(path), i == 0 ? "/tmp/dv_checkpoint_%d" : "/tmp/dv_checkpoint_%d.1", (int) getpid());
+        snprintf(lock, sizeof(lock), "%s.lock", path);
+        unlink(path);
+        unlink(lock);
+    }
+}
+
+void replica_test(void) {
+    enum { nb_threads = 4 };
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    shared_t shared = tm_create(80, 8);
+    assert(shared != invalid_shared);
+    // Content from before the replica joined: a segment, referenced from word 4
+    void* kept;
+    int64_t value = 42;
+    tx_t tx = tm_begin(shared, false);
+    assert(tm_alloc(shared, tx, 16, &kept) == success_alloc);
+    assert(tm_write(shared, tx, &value, 8, (int64_t*) kept + 1));
+    assert(tm_write(shared, tx, &kept, 8, (int64_t*) tm_start(shared) + 4));
+    assert(tm_end(shared, tx));
+
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        close(fds[0]);
+        shared_t replica = tm_replica(fds[1]);
+        if (replica == invalid_shared || tm_begin(replica, false) != invalid_tx) _exit(1);
+        int64_t words[10] = { 0 };
+        while (words[5] == 0) { // Until the primary is done, with a copy of its final balances in words 6 to 9
+            tx = tm_begin(replica, true);
+            if (!tm_read(replica, tx, tm_start(replica), sizeof(words), words) || !tm_end(replica, tx)) _exit(1);
+            if (words[0] + words[1] + words[2] + words[3] != 0) _exit(1);
+        }
+        value = 0;
+        tx = tm_begin(replica, true);
+        if (!tm_read(replica, tx, (void*) (uintptr_t) words[4], 8, &value) || !tm_read(replica, tx, (int64_t*) (uintptr_t) words[4] + 1, 8, &value) || !tm_end(replica, tx)) _exit(1);
+        if (value != 42 || memcmp(words, words + 6, 4 * sizeof(int64_t)) != 0) _exit(1);
+        tm_destroy(replica);
+        _exit(0);
+    }
+    close(fds[1]);
+    assert(tm_replicate(shared, fds[0]));
+    pthread_t threads[nb_threads];
+    bank_arg arg = { .shared = shared, .nb_transfers = 2000, .skew = 50 };
+    for (int i = 0; i < nb_threads; i++)
+        pthread_create(&threads[i], NULL, i % 2 == 0 ? bank_thread : audit_thread, &arg);
+    for (int i = 0; i < nb_threads; i++)
+        pthread_join(threads[i], NULL);
+    int64_t accounts[4], done = 1;
+    tx = tm_begin_irrevocable(shared);
+    assert(tm_read(shared, tx, tm_start(shared), sizeof(accounts), accounts));
+    assert(tm_write(shared, tx, accounts, sizeof(accounts), (int64_t*) tm_start(shared) + 6));
+    assert(tm_write(shared, tx, &done, 8, (int64_t*) tm_start(shared) + 5));
+    assert(tm_end(shared, tx));
+    int status;
+    assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    tm_destroy(shared);
+}
+
 int main(void) {
+    batcher_test();
     memory_test();
-    return 1;
+    transaction_test();
+    multiversion_test();
+    snapshot_test();
+    concurrency_test(NULL, 0);
+    concurrency_test("DV_MULTIVERSION", 0);
+    concurrency_test("DV_SNAPSHOT", 0);
+    concurrency_test("DV_IRREVOCABLE_AFTER", 0);
+    concurrency_test(NULL, 90);
+    concurrency_test("DV_PARK", 90);
+    concurrency_test("DV_ADAPTIVE", 90);
+    irrevocable_test();
+    commutative_test(NULL);
+    commutative_test("DV_MULTIVERSION");
+    commutative_test("DV_IRREVOCABLE_AFTER");
+    static_test();
+    timed_test();
+    run_test(NULL);
+    run_test("DV_RUN_IRREVOCABLE_AFTER");
+    run_test("DV_RUN_BACKOFF_NS");
+    run_hints_test();
+    async_test();
+    regions_test();
+    shared_test();
+    persistent_test();
+    wal_test(false);
+    wal_test(true);
+    checkpoint_test();
+    replica_test();
+    elastic_test(false);
+    elastic_test(true);
+    printf("All tests passed\n");
+    return 0;
 }
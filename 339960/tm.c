@@ -8,9 +8,8 @@
  *
  * @section DESCRIPTION
  *
- * Implementation of your own transaction manager.
- * You can completely rewrite this file (and create more files) as you wish.
- * Only the interface (i.e. exported symbols and semantic) must be preserved.
+ * Dual-versioned transaction manager: every word has a readable and a writable copy,
+ * transactions run by epochs in a batcher and the copies are swapped at the end of each epoch.
 **/
 
 // Requested features
@@ -27,442 +26,1627 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <errno.h>
 #include <pthread.h>
-#include <semaphore.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/socket.h>
 #include <unistd.h>
-#include <stdatomic.h>
 
 // Internal headers
 #include <tm.h>
 #include "macros.h"
+#include "region.h"
 
+/* PREFETCHING */
 
-/* STRUCTS ARE IN TM.H */
+// Number of consecutive reads continuing a scan or a chase before prefetching starts
+#define PREFETCH_TRIGGER  2
+// How far ahead of the current read to prefetch (in bytes), in both the copies and the control words
+#define PREFETCH_DISTANCE 256
 
-/* MEMORY PART */
-
-void print_memory(memory* mem) {
-    if (mem == NULL) {
-        printf("NULL\n");
-        return;
-    }
+/**
+ * @brief Access pattern detection of the calling thread: segment and word following its last read, and the last
+ * shared address it read as a value.
+ */
+typedef struct stride_state {
+    segment* seg;
+    size_t next_word;
+    int run;                            // Number of consecutive reads that continued the previous one
+    uintptr_t chased;                   // Last value read that is a shared address, 0 if none
+    int chain;                          // Number of consecutive reads that landed right after the chased address
+} stride_state;
 
-    printf("\n###### Memory ######\n");
-    printf("Number of segments: %d\n", mem->nb_segments);
-    printf("Segment size: %d Bytes \n", mem->segment_size);
-    printf("Data Total size: %d Bytes\n", mem->nb_segments * mem->segment_size);
-    printf("Lock: %p\n", &mem->alloc_lock);
+// Kept per thread rather than per transaction, so that a scan split over several transactions is still detected
+static _Thread_local stride_state stride;
 
-    printf("Data: \n");
-    if (mem->data == NULL) {
-        printf("    - No Data\n");
-        return;
+/**
+ * @brief Detects sequential scans and prefetches ahead in the readable copy and the control words.
+ *
+ * A read continues the previous one when it starts at the word right after the last
+ * word the thread read in the same segment. The readable copy of the current word is used as a
+ * guess for the words ahead, since neighbouring words are usually swapped together.
+ *
+ * @param tx   Reading transaction
+ * @param seg  Segment being read
+ * @param word First word read
+ * @param nb   Number of words read
+ */
+static inline void prefetch_sequential(transaction* tx, segment* seg, size_t word, size_t nb) {
+    if (seg == stride.seg && word == stride.next_word) {
+        if (stride.run < PREFETCH_TRIGGER)
+            stride.run++;
     } else {
-        for (int i = 0; i < mem->nb_segments; i++) {
-            printf("    Segment n.%d\n", i);
-            printf("       - Already accessed: %s\n", mem->data[i].already_accessed ? "true" : "false");
-            printf("       - Read only: %d\n", mem->data[i].read_only);
-            printf("       - Read write: %d\n", mem->data[i].read_write);
-        }
+        stride.run = 0;
     }
-    printf("#####################\n\n");
+    stride.seg = seg;
+    stride.next_word = word + nb;
+    if (stride.run < PREFETCH_TRIGGER && !tx->long_scan)
+        return;
+
+    size_t ahead = word + nb + PREFETCH_DISTANCE / seg->align;
+    if (ahead < seg->nb_words) {
+        int readable = (atomic_load_explicit(&seg->controls[word], memory_order_relaxed) & CONTROL_READABLE) ? 1 : 0;
+        __builtin_prefetch(seg->copies[readable] + ahead * seg->align, 0, 3);
+    }
+    ahead = word + nb + PREFETCH_DISTANCE / sizeof(control_word);
+    if (ahead < seg->nb_words)
+        __builtin_prefetch(&seg->controls[ahead], 0, 3);
 }
 
 /**
- * @brief Initializes a dual memory segment.
+ * @brief Finds the segment a value designates, if it is a shared address of the region.
  *
- * This function sets up a dual memory segment by allocating and initializing
- * the necessary resources. It ensures that the memory segment is properly
- * configured for subsequent operations.
+ * The segment id is checked against the ids handed out so far before the segment table is
+ * read, so that most values that are not addresses cost no load. A stale bound only misses a segment.
  *
- * @return Returns the pointer to the newly created dual memory segment, or NULL if the allocation failed.
+ * @param mem   Segment table
+ * @param value Value to check
+ * @return The segment, NULL if the value is not a shared address
  */
-dual_memory_segment* init_dual_memory_segment(u_int8_t init_value) {
-    dual_memory_segment* dual_mem_seg_ptr = (dual_memory_segment*) malloc(sizeof(dual_memory_segment));
-    if (dual_mem_seg_ptr == NULL) {
-        fprintf(stderr, "Failed to allocate memory for dual memory segment\n");
+static inline segment* address_segment(memory* mem, uintptr_t value) {
+    uintptr_t id = value >> SEGMENT_SHIFT;
+    if (likely(id == 0 || id >= (uintptr_t) atomic_load_explicit(&mem->next_free_id, memory_order_relaxed)))
         return NULL;
-    }
-
-    dual_mem_seg_ptr->already_accessed = false;
-    dual_mem_seg_ptr->read_only = init_value;
-    dual_mem_seg_ptr->read_write = init_value;
-    
-    return dual_mem_seg_ptr;
-}
-
-memory* init_memory(void) {
-    memory* mem = (memory*) malloc(sizeof(memory));
-    mem->nb_segments = 1;
-    mem->segment_size = sizeof(dual_memory_segment);
-
-    mem->alloc_lock = (pthread_mutex_t*) malloc(sizeof(pthread_mutex_t));
-    if (pthread_mutex_init(mem->alloc_lock, NULL) != 0) {
-        fprintf(stderr, "Failed to initialize mutex for memory\n");
-        free(mem);
+    segment* seg = atomic_load_explicit(&mem->segments[id], memory_order_acquire);
+    if (seg == NULL || (value & OFFSET_MASK) >= seg->size)
         return NULL;
-    }
-
-    // This is the first segment that is allocated by default, it should not be deallocated except by tm_destroy().
-    mem->data = init_dual_memory_segment(0);
+    return seg;
+}
 
-    return mem;
+/**
+ * @brief Prefetches the control word and both copies of a word.
+ * @param seg    Segment of the word
+ * @param offset Offset of the word in the segment (in bytes)
+ */
+static inline void prefetch_word(segment* seg, size_t offset) {
+    __builtin_prefetch(&seg->controls[offset / seg->align], 0, 3);
+    __builtin_prefetch(seg->copies[0] + offset, 0, 3);
+    __builtin_prefetch(seg->copies[1] + offset, 0, 3);
 }
 
 /**
- * @brief Adds a dual memory segment to the memory structure.
+ * @brief Detects pointer chasing, and prefetches the target of a value just read once a chase is detected.
  *
- * This function adds a dual memory segment to the memory structure by reallocating
- * the necessary resources. It ensures that the data memory region (that should be initialize by tm_create())
- * is properly configured for subsequent operations.
+ * A read follows the previous chased address when it lands within PREFETCH_DISTANCE bytes
+ * after it, as when reading the fields of a node reached through a pointer. Only values that are
+ * shared addresses of the region are remembered, and their target is prefetched only after
+ * PREFETCH_TRIGGER reads in a row followed one.
  *
- * @param mem Pointer to the memory structure.
- * @param dms The dual memory segment to be added.
- * @return The index of the newly added dual memory segment, or -1 if the allocation failed.
- */
-int add_dual_memory_segment_to_memory(memory* mem, dual_memory_segment dms) {
-    if (mem == NULL) return -1;
-    // We assume that the allocation of the first segment is already dony by tm_create and should not be deallocated.
-    int new_segment_index = mem->nb_segments;
-    if (mem->data == NULL || new_segment_index == 0) return -1;
-
-    mem->nb_segments++;
-    mem->data = (dual_memory_segment*) realloc(mem->data, mem->segment_size * (mem->nb_segments));
-    if (mem->data == NULL) {
-        fprintf(stderr, "Failed to reallocate memory for dual memory segment\n");
-        return -1;
+ * @param mem     Segment table
+ * @param address Shared address that was read
+ * @param size    Size of the read (in bytes)
+ * @param value   Private copy of the words read
+ */
+static inline void prefetch_chase(memory* mem, uintptr_t address, size_t size, void const* value) {
+    if (stride.chased != 0 && address - stride.chased < PREFETCH_DISTANCE) {
+        if (stride.chain < PREFETCH_TRIGGER)
+            stride.chain++;
+    } else {
+        stride.chain = 0;
     }
+    if (size != sizeof(uintptr_t))
+        return;
+    uintptr_t target = *(uintptr_t const*) value;
+    segment* seg = address_segment(mem, target);
+    if (seg == NULL)
+        return;
+    stride.chased = target;
+    if (stride.chain >= PREFETCH_TRIGGER)
+        prefetch_word(seg, target & OFFSET_MASK);
+}
+
+/* TRANSACTIONS */
 
-    mem->data[new_segment_index] = dms;
-    return new_segment_index;
+// Number of regions whose retry state each thread keeps (power of 2)
+#define THREAD_REGIONS 16
 
+/**
+ * @brief Retry state of the calling thread on one region, so that aborts on a region do not affect its transactions on the others.
+ */
+typedef struct thread_state {
+    region* reg;                        // Region of the state, NULL if unused
+    uint64_t consecutive_aborts;        // Consecutive aborts of the read-write transactions of the thread
+    unsigned int parked_key;            // Batcher key of the word the last read-write transaction of the thread aborted on, 0 if none
+    bool plain_adds;                    // The transaction retried by the thread mixed adds with accesses to the words added to
+    uint64_t backoff_seed;              // State of the generator of the backoff delays of 'tm_run', 0 until first used
+} thread_state;
+
+// Retry states of the calling thread, by hash of the region (a region evicting another one resets its state)
+static _Thread_local thread_state thread_states[THREAD_REGIONS];
+
+static inline thread_state* state_of(region* reg) {
+    thread_state* st = &thread_states[((uint64_t) (uintptr_t) reg * UINT64_C(0x9E3779B97F4A7C15) >> 32) & (THREAD_REGIONS - 1)];
+    if (unlikely(st->reg != reg))
+        *st = (thread_state) { .reg = reg };
+    return st;
 }
 
-void destroy_memory(memory* mem) {
-    if (mem == NULL) return;
-    if (mem->alloc_lock != NULL) {
-        pthread_mutex_destroy(mem->alloc_lock);
-    } 
-    //free(mem->data);
-    mem->data = NULL;
-    free(mem);
-    mem = NULL;
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
 }
 
+/**
+ * @brief Hashes a word into a batcher key, so that transactions aborted on the same word wait with the same key.
+ * @return Key in [1, BATCHER_KEYS)
+ */
+static inline unsigned int conflict_key(segment* seg, size_t word) {
+    uint64_t hash = (uint64_t) segment_address(seg->id, word) * UINT64_C(0x9E3779B97F4A7C15);
+    return 1 + (unsigned int) ((hash >> 32) % (BATCHER_KEYS - 1));
+}
 
 /**
- * @brief Implementation of concurrent algorithms for transactional memory.
- * @param mem The memory structure to allocate the segment in.
- * @return The index of the newly allocated segment.
- * This function does not modify the memory itsfelf, it uses other functions to do so.
- * This function uses a mutex to lock the memory structure during the calls to the other functions.
+ * @brief Grows a dynamic array so that it can hold at least one more element.
+ * @return Whether the operation is a success
  */
-int allocate_segment(memory* mem) {
-    if (mem == NULL) return -1;
+static bool reserve_one(arena* a, void** array, size_t* capacity, size_t count, size_t elem_size) {
+    if (likely(count < *capacity)) return true;
+    size_t new_capacity = *capacity == 0 ? 16 : 2 * *capacity;
+    void* new_array = arena_realloc(a, *array, new_capacity * elem_size);
+    if (unlikely(new_array == NULL)) return false;
+    *array = new_array;
+    *capacity = new_capacity;
+    return true;
+}
 
-    dual_memory_segment* dms_ptr = init_dual_memory_segment(0);
-    if (dms_ptr == NULL) {
-        printf("Failed to allocate memory for dual memory segment\n");
-        return -1;
-    }
+static bool log_access(transaction* tx, segment* seg, size_t word, bool written) {
+    if (unlikely(!reserve_one(tx->arena, (void**) &tx->accesses, &tx->accesses_capacity, tx->nb_accesses, sizeof(access_entry))))
+        return false;
+    tx->accesses[tx->nb_accesses++] = (access_entry) { .seg = seg, .word = word, .written = written };
+    return true;
+}
 
-    dual_memory_segment dms = *dms_ptr;
+static void end_epoch(void* arg);
+static tx_t begin_transaction(region* reg, bool is_ro, bool irrevocable, tm_hints const* hints, uint64_t timeout_ns);
+
+static void destroy_transaction(transaction* tx) {
+    arena* a = tx->arena;
+    destroy_blocked_thread(&tx->waiter);
+    arena_free(a, tx->accesses);
+    arena_free(a, tx->allocs);
+    arena_free(a, tx->frees);
+    arena_free(a, tx->adds);
+    arena_free(a, tx->keys);
+    arena_free(a, tx);
+}
 
-    pthread_mutex_lock(mem->alloc_lock);
-    int new_index = add_dual_memory_segment_to_memory(mem, dms);
+/**
+ * @brief Ends a read-only transaction, releasing whatever it read from: its pinned version, its snapshot or the batcher.
+ * @param reg Region of the transaction
+ * @param tx  Transaction ending
+ */
+static void end_read_only(region* reg, transaction* tx) {
+    if (tx->mv_slot >= 0) {
+        mv_unpin(reg->mv, tx->mv_slot);
+    } else if (tx->snap != NULL) {
+        release_snapshot(reg->snaps, tx->snap);
+    } else {
+        leave_batcher(reg->batcher, end_epoch, reg);
+    }
+    destroy_transaction(tx);
+}
 
-    pthread_mutex_unlock(mem->alloc_lock);
-    return new_index;
+/**
+ * @brief Hands a read-write transaction over to the end of the epoch, then leaves the batcher.
+ * @param reg       Region of the transaction
+ * @param tx        Transaction leaving
+ * @param committed Whether the transaction committed
+ */
+static void retire_transaction(region* reg, transaction* tx, bool committed) {
+    tx->committed = committed;
+    tx->live = false;
+    thread_state* st = state_of(reg);
+    if (committed) {
+        st->consecutive_aborts = 0;
+        st->parked_key = 0;
+        st->plain_adds = false;
+        stats_add(&reg->stats.commits, 1);
+        if (tx->irrevocable)
+            stats_add(&reg->stats.irrevocable, 1);
+    } else {
+        st->consecutive_aborts++;
+        st->parked_key = reg->config.park ? tx->conflict_key : 0;
+        st->plain_adds |= tx->mixed_adds;
+        stats_add(&reg->stats.aborts, 1);
+    }
+    if (reg->config.stats)
+        stats_add(committed ? &reg->stats.useful_ns : &reg->stats.wasted_ns, now_ns() - tx->start_ns);
+    transaction* head = atomic_load_explicit(&reg->retired, memory_order_relaxed);
+    do {
+        tx->next_retired = head;
+    } while (!atomic_compare_exchange_weak_explicit(&reg->retired, &head, tx, memory_order_release, memory_order_relaxed));
+    leave_batcher(reg->batcher, end_epoch, reg);
+}
 
+/**
+ * @brief Makes the copy of a word written by a committed transaction readable. Called during the end of epoch.
+ * @param reg      Region
+ * @param seg      Segment
+ * @param word     Word index
+ * @param readable Readable bit of the control word during the epoch
+ */
+static void install_word(region* reg, segment* seg, size_t word, uint64_t readable) {
+    readable ^= CONTROL_READABLE;
+    if (reg->wal != NULL)
+        wal_log_write(reg->wal, seg, word, seg->copies[readable ? 1 : 0] + word * seg->align);
+    if (reg->checkpoints != NULL)
+        checkpoint_mark(reg->checkpoints, seg, word);
+    if (reg->mv != NULL) {
+        mv_install_word(reg->mv, seg, word, readable);
+        return;
+    }
+    if (reg->snaps != NULL)
+        snapshots_before_install(reg->snaps, seg, word);
+    atomic_store_explicit(&seg->controls[word], readable, memory_order_relaxed);
 }
 
 /**
- * FIXME : See if this implementation is correct.
- * 
- * @brief Deallocates a memory segment.
+ * @brief Merges the commutative adds of the epoch. Called during the end of epoch.
  *
- * This function is responsible for deallocating a previously allocated
- * memory segment. It ensures that all resources associated with the 
- * segment are properly released to avoid memory leaks.
+ * The first committed add to a word copies its readable value to the other copy, and clears its
+ * written bit to tell the next ones; every committed delta is then summed into that copy. Once all
+ * are summed, each word is installed, or reset if only aborted transactions added to it.
  *
- * @param segment A pointer to the memory segment to be deallocated.
- * @param index The index of the segment to be deallocated.
+ * @param reg     Region
+ * @param retired Transactions of the epoch
  */
-void deallocate_segment(memory* mem, int index) {
-    if (mem == NULL) {
-        fprintf(stderr, "Memory structure is NULL\n");
-        return;
+static void merge_adds(region* reg, transaction* retired) {
+    for (transaction* tx = retired; tx != NULL; tx = tx->next_retired) {
+        if (!tx->committed)
+            continue;
+        for (size_t i = 0; i < tx->nb_adds; i++) {
+            add_entry* entry = &tx->adds[i];
+            control_word* control = &entry->seg->controls[entry->word];
+            uint64_t value = atomic_load_explicit(control, memory_order_relaxed);
+            int readable = (value & CONTROL_READABLE) ? 1 : 0;
+            uint8_t* copy = entry->seg->copies[1 - readable] + entry->word * entry->seg->align;
+            if (value & CONTROL_WRITTEN) {
+                memcpy(copy, entry->seg->copies[readable] + entry->word * entry->seg->align, entry->seg->align);
+                atomic_store_explicit(control, (value & CONTROL_READABLE) | ACCESS_ADDED, memory_order_relaxed);
+            }
+            uint64_t sum;
+            memcpy(&sum, copy, sizeof(sum));
+            sum += (uint64_t) entry->delta;
+            memcpy(copy, &sum, sizeof(sum));
+        }
+        stats_add(&reg->stats.merged_adds, tx->nb_adds);
     }
-
-    if (index == 0) {
-        fprintf(stderr, "Cannot deallocate the first segment. Only tm_create() and tm_destroy() can manage the allocation of this segment.\n");
-        return;
+    for (transaction* tx = retired; tx != NULL; tx = tx->next_retired) {
+        for (size_t i = 0; i < tx->nb_adds; i++) {
+            add_entry* entry = &tx->adds[i];
+            control_word* control = &entry->seg->controls[entry->word];
+            uint64_t value = atomic_load_explicit(control, memory_order_relaxed);
+            if ((value & ACCESS_MASK) != ACCESS_ADDED)
+                continue; // Already installed or reset
+            if (value & CONTROL_WRITTEN)
+                atomic_store_explicit(control, value & CONTROL_READABLE, memory_order_relaxed);
+            else
+                install_word(reg, entry->seg, entry->word, value & CONTROL_READABLE);
+        }
     }
+}
 
-    if (index < 1 || index >= mem->nb_segments) {
-        fprintf(stderr, "Index out of bounds\n");
-        return;
+/**
+ * @brief End of epoch: applies the writes of the committed transactions and resets the control words.
+ *
+ * Runs in the last thread leaving the epoch, while no other transaction is running.
+ * With a synchronous log, the epoch is durable before the next one starts, i.e. before
+ * any transaction can read what it wrote.
+ * All control words are reset before any segment is freed, since an access entry
+ * may refer to a segment freed by another transaction of the same epoch.
+ *
+ * @param arg Region
+ */
+static void end_epoch(void* arg) {
+    region* reg = (region*) arg;
+    bool persistent = reg->arena != NULL && reg->arena->file;
+    if (persistent)
+        atomic_store(&reg->ending_epoch, true);
+    transaction* retired = atomic_exchange_explicit(&reg->retired, NULL, memory_order_acquire);
+    if (reg->mv != NULL)
+        mv_begin_epoch_end(reg->mv);
+    if (reg->snaps != NULL)
+        snapshots_begin_epoch_end(reg->snaps);
+
+    if (reg->wal != NULL)
+        wal_begin_epoch(reg->wal, reg->batcher->epoch);
+
+    uint64_t commits = 0, aborts = 0;
+    for (transaction* tx = retired; tx != NULL; tx = tx->next_retired) {
+        if (tx->committed) commits++;
+        else aborts++;
+        if (tx->committed && (reg->wal != NULL || reg->checkpoints != NULL)) {
+            for (size_t i = 0; i < tx->nb_allocs; i++) {
+                segment* seg = get_segment(reg->memory, tx->allocs[i]);
+                if (reg->wal != NULL)
+                    wal_log_alloc(reg->wal, seg);
+                if (reg->checkpoints != NULL)
+                    checkpoint_track_alloc(reg->checkpoints, seg);
+            }
+        }
+        for (size_t i = 0; i < tx->nb_accesses; i++) {
+            access_entry* entry = &tx->accesses[i];
+            control_word* control = &entry->seg->controls[entry->word];
+            uint64_t readable = atomic_load_explicit(control, memory_order_relaxed) & CONTROL_READABLE;
+            if (entry->written && tx->committed)
+                install_word(reg, entry->seg, entry->word, readable);
+            else
+                atomic_store_explicit(control, readable, memory_order_relaxed);
+        }
+    }
+    merge_adds(reg, retired);
+
+    while (retired != NULL) {
+        transaction* tx = retired;
+        retired = tx->next_retired;
+        if (tx->committed) {
+            for (size_t i = 0; i < tx->nb_frees; i++) {
+                if (reg->wal != NULL)
+                    wal_log_free(reg->wal, tx->frees[i]);
+                if (reg->checkpoints != NULL)
+                    checkpoint_track_free(reg->checkpoints, tx->frees[i]);
+                if (reg->mv != NULL) {
+                    mv_retire_segment(reg->mv, tx->frees[i]);
+                } else if (reg->snaps != NULL) {
+                    snapshots_free_segment(reg->snaps, reg->memory, tx->frees[i]);
+                } else {
+                    deallocate_segment(reg->memory, tx->frees[i]);
+                }
+            }
+        } else {
+            for (size_t i = 0; i < tx->nb_allocs; i++)
+                deallocate_segment(reg->memory, tx->allocs[i]);
+            if (tx->kept)
+                continue; // Its thread retries it once admitted into a later epoch
+        }
+        destroy_transaction(tx);
     }
 
-    pthread_mutex_lock(mem->alloc_lock);
-    mem->nb_segments--;
-    for (int i = index; i < mem->nb_segments; i++) {
-        mem->data[i] = mem->data[i+1];
-    }  
-    mem->data = (dual_memory_segment*) realloc(mem->data, mem->segment_size * (mem->nb_segments));
-
-
-    pthread_mutex_unlock(mem->alloc_lock);
+    if (reg->mv != NULL)
+        mv_finish_epoch_end(reg->mv, reg->memory);
+    if (reg->snaps != NULL)
+        snapshots_finish_epoch_end(reg->snaps, reg->memory);
+    if (reg->adaptive != NULL)
+        adaptive_end_epoch(reg->adaptive, now_ns(), reg->batcher->epoch, commits, aborts);
+    if (reg->wal != NULL)
+        wal_end_epoch(reg->wal);
+    stats_add(&reg->stats.epochs, 1);
+    if (persistent)
+        atomic_store(&reg->ending_epoch, false);
 }
 
-/* BATCHER PART */
-void print_blocked_thread(blocked_thread* bt) {
-    if(bt == NULL) {
-        printf("    - NULL\n");
-        return;
+/**
+ * @brief Adds a read-write transaction to the access set of a word it reads.
+ * @return Index of the copy to read, -1 if the transaction must abort
+ */
+static int track_read(transaction* tx, segment* seg, size_t word) {
+    control_word* control = &seg->controls[word];
+    uint64_t value = atomic_load_explicit(control, memory_order_acquire);
+    while (true) {
+        uint64_t access = value & ACCESS_MASK;
+        int readable = (value & CONTROL_READABLE) ? 1 : 0;
+        if (value & CONTROL_WRITTEN) {
+            if (access == tx->id)
+                return 1 - readable;
+            tx->mixed_adds |= access == ACCESS_ADDED && tx->nb_adds > 0;
+            return -1;
+        }
+        if (access == tx->id || access == ACCESS_MULTI)
+            return readable;
+        uint64_t desired = (value & ~ACCESS_MASK) | (access == ACCESS_NONE ? tx->id : ACCESS_MULTI);
+        if (atomic_compare_exchange_weak_explicit(control, &value, desired, memory_order_acq_rel, memory_order_acquire))
+            return likely(log_access(tx, seg, word, false)) ? readable : -1;
     }
-    printf("    - ptr: %p\n", bt);
-    printf("    - id: %d\n", bt->id);
-    printf("    - next: %p\n", bt->next);
-    printf("    - sem: %d\n", bt->sem);
 }
 
-void print_batcher(batcher* b) {
-    printf("\n###### Batcher ######\n");
-    if (b == NULL) {
-        printf("NULL\n");
-        return;
-    }
+/**
+ * @brief Reads one word in a read-write transaction, adding the transaction to the access set of the word.
+ * @return Whether the transaction can continue
+ */
+static bool read_word(transaction* tx, segment* seg, size_t word, void* target) {
+    int copy = track_read(tx, seg, word);
+    if (unlikely(copy < 0))
+        return false;
+    memcpy(target, seg->copies[copy] + word * seg->align, seg->align);
+    return true;
+}
 
-    printf("Count: %d\n", b->epoch);
-    printf("Remaining: %d\n", b->remaining);
+/**
+ * @brief Whether another transaction of the epoch wrote a word, so that a value read from it will not survive the epoch.
+ */
+static inline bool written_by_other(transaction* tx, segment* seg, size_t word) {
+    uint64_t value = atomic_load_explicit(&seg->controls[word], memory_order_acquire);
+    return (value & CONTROL_WRITTEN) && (value & ACCESS_MASK) != tx->id;
+}
 
-    printf("Blocked threads HEAD: \n");
-    print_blocked_thread(b->blocked_threads_head);
-    printf("Blocked threads TAIL: \n");
-    print_blocked_thread(b->blocked_threads_tail);
+/**
+ * @brief Reads one word elastically, before the transaction's first write: the word is not added to its access set.
+ *
+ * The readable copies do not change during an epoch, so the elastic reads all see the state
+ * of the last epoch. They are only validated pairwise: when moving on to the next word,
+ * the previous one must not have been written by another transaction in the meantime.
+ * The last ELASTIC_WINDOW words read are tracked when the transaction first writes.
+ *
+ * @return Whether the transaction can continue
+ */
+static bool read_word_elastic(transaction* tx, segment* seg, size_t word, void* target) {
+    if (tx->nb_elastic > 0) {
+        elastic_read* previous = &tx->elastic[(tx->nb_elastic - 1) % ELASTIC_WINDOW];
+        if (written_by_other(tx, previous->seg, previous->word))
+            return false;
+    }
+    int readable = (atomic_load_explicit(&seg->controls[word], memory_order_acquire) & CONTROL_READABLE) ? 1 : 0;
+    memcpy(target, seg->copies[readable] + word * seg->align, seg->align);
+    tx->elastic[tx->nb_elastic++ % ELASTIC_WINDOW] = (elastic_read) { .seg = seg, .word = word };
+    return true;
+}
 
-    printf("Blocked threads: \n");
-    blocked_thread* bt = b->blocked_threads_head;
-    while (bt != NULL) {
-        printf("    - thread id n.%d \n", bt->id);
-        bt = bt->next;
+/**
+ * @brief Ends the elastic phase at the first write, tracking the last words read elastically.
+ * @return Whether the transaction can continue
+ */
+static bool end_elastic(transaction* tx) {
+    tx->wrote = true;
+    size_t nb = tx->nb_elastic < ELASTIC_WINDOW ? tx->nb_elastic : ELASTIC_WINDOW;
+    for (size_t i = 0; i < nb; i++) {
+        elastic_read* read = &tx->elastic[(tx->nb_elastic - 1 - i) % ELASTIC_WINDOW];
+        if (track_read(tx, read->seg, read->word) < 0)
+            return false;
     }
-    printf("#####################\n\n");
+    return true;
 }
 
-batcher* init_batcher(void) {
-    batcher* batcher_ptr = (batcher*) malloc(sizeof(batcher));
-    if (batcher_ptr == NULL) {
-        fprintf(stderr, "Failed to allocate memory for batcher\n");
-        return NULL;
+/**
+ * @brief Makes a read-write transaction the writer of a word. Fails if another transaction accessed the word in this epoch.
+ * @return The writable copy of the word, NULL if the transaction cannot continue
+ */
+static uint8_t* claim_word(transaction* tx, segment* seg, size_t word) {
+    control_word* control = &seg->controls[word];
+    uint64_t value = atomic_load_explicit(control, memory_order_acquire);
+    while (true) {
+        uint64_t access = value & ACCESS_MASK;
+        int readable = (value & CONTROL_READABLE) ? 1 : 0;
+        if (value & CONTROL_WRITTEN) {
+            if (access == tx->id)
+                return seg->copies[1 - readable] + word * seg->align;
+            tx->mixed_adds |= access == ACCESS_ADDED && tx->nb_adds > 0;
+            return NULL;
+        }
+        if (access != ACCESS_NONE && access != tx->id)
+            return NULL;
+        uint64_t desired = (value & CONTROL_READABLE) | CONTROL_WRITTEN | tx->id;
+        if (atomic_compare_exchange_weak_explicit(control, &value, desired, memory_order_acq_rel, memory_order_acquire))
+            return likely(log_access(tx, seg, word, true)) ? seg->copies[1 - readable] + word * seg->align : NULL;
     }
+}
 
-    batcher_ptr->epoch = 0;
-    batcher_ptr->remaining = 0;
-    batcher_ptr->blocked_threads_head = NULL;
-    batcher_ptr->blocked_threads_tail = NULL;
+/**
+ * @brief Writes one word in a read-write transaction. Fails if another transaction accessed the word in this epoch.
+ * @return Whether the transaction can continue
+ */
+static bool write_word(transaction* tx, segment* seg, size_t word, void const* source) {
+    uint8_t* copy = claim_word(tx, seg, word);
+    if (unlikely(copy == NULL))
+        return false;
+    memcpy(copy, source, seg->align);
+    return true;
+}
 
-    batcher_ptr->lock = (pthread_mutex_t*) malloc(sizeof(pthread_mutex_t));
-    if (batcher_ptr->lock == NULL) {
-        fprintf(stderr, "Failed to allocate memory for mutex\n");
-        free(batcher_ptr);
-        return NULL;
+/**
+ * @brief Adds to a word commutatively: any number of transactions can add to it in the same epoch, as long as none reads or writes it.
+ * @return 1 if added, 0 if the word is only accessed by this transaction, which must then read and write it instead, -1 if the transaction must abort
+ */
+static int add_word(transaction* tx, segment* seg, size_t word, int64_t delta) {
+    control_word* control = &seg->controls[word];
+    uint64_t value = atomic_load_explicit(control, memory_order_acquire);
+    while (!((value & CONTROL_WRITTEN) && (value & ACCESS_MASK) == ACCESS_ADDED)) {
+        uint64_t access = value & ACCESS_MASK;
+        if (access == tx->id)
+            return 0;
+        if (access != ACCESS_NONE)
+            return -1;
+        uint64_t desired = (value & CONTROL_READABLE) | CONTROL_WRITTEN | ACCESS_ADDED;
+        if (atomic_compare_exchange_weak_explicit(control, &value, desired, memory_order_acq_rel, memory_order_acquire))
+            break;
     }
+    if (unlikely(!reserve_one(tx->arena, (void**) &tx->adds, &tx->adds_capacity, tx->nb_adds, sizeof(add_entry))))
+        return -1;
+    tx->adds[tx->nb_adds++] = (add_entry) { .seg = seg, .word = word, .delta = delta };
+    return 1;
+}
 
-    if (pthread_mutex_init(batcher_ptr->lock, NULL) != 0) {
-        fprintf(stderr, "Failed to initialize mutex for batcher\n");
-        free(batcher_ptr->lock);
-        free(batcher_ptr);
-        return NULL;
+/**
+ * @brief Reads a range of words in a transaction, through the path matching its kind.
+ * @param elastic Whether the reads of a read-write transaction that did not write yet are elastic
+ * @return Whether the transaction can continue
+ */
+static bool read_range(region* reg, transaction* t, void const* source, size_t size, void* target, bool elastic) {
+    segment* seg = get_segment(reg->memory, (uintptr_t) source >> SEGMENT_SHIFT);
+    size_t align = reg->align;
+    size_t first = ((uintptr_t) source & OFFSET_MASK) / align;
+    size_t nb = size / align;
+
+    prefetch_sequential(t, seg, first, nb);
+    if (t->mv_slot >= 0) {
+        for (size_t i = 0; i < nb; i++) {
+            if (unlikely(!mv_read_word(seg, first + i, t->snapshot, (uint8_t*) target + i * align))) {
+                stats_add(&reg->stats.aborts, 1);
+                end_read_only(reg, t);
+                return false;
+            }
+        }
+    } else if (t->snap != NULL) {
+        for (size_t i = 0; i < nb; i++) {
+            if (unlikely(!snapshot_read_word(t->snap, seg, first + i, (uint8_t*) target + i * align))) {
+                stats_add(&reg->stats.aborts, 1);
+                end_read_only(reg, t);
+                return false;
+            }
+        }
+    } else if (t->is_ro) {
+        for (size_t i = 0; i < nb; i++) {
+            int readable = (atomic_load_explicit(&seg->controls[first + i], memory_order_relaxed) & CONTROL_READABLE) ? 1 : 0;
+            memcpy((uint8_t*) target + i * align, seg->copies[readable] + (first + i) * align, align);
+        }
+    } else if (t->is_static) { // No transaction of the epoch writes the words it reads, apart from itself: nothing to track
+        for (size_t i = 0; i < nb; i++) {
+            uint64_t value = atomic_load_explicit(&seg->controls[first + i], memory_order_relaxed);
+            int readable = (value & CONTROL_READABLE) ? 1 : 0;
+            if ((value & CONTROL_WRITTEN) && (value & ACCESS_MASK) == t->id)
+                readable = 1 - readable;
+            memcpy((uint8_t*) target + i * align, seg->copies[readable] + (first + i) * align, align);
+        }
+    } else if (elastic && !t->wrote) {
+        for (size_t i = 0; i < nb; i++) {
+            if (unlikely(!read_word_elastic(t, seg, first + i, (uint8_t*) target + i * align))) {
+                t->conflict_key = conflict_key(seg, first + i);
+                retire_transaction(reg, t, false);
+                return false;
+            }
+        }
+    } else {
+        for (size_t i = 0; i < nb; i++) {
+            if (unlikely(!read_word(t, seg, first + i, (uint8_t*) target + i * align))) {
+                t->conflict_key = conflict_key(seg, first + i);
+                retire_transaction(reg, t, false);
+                return false;
+            }
+        }
     }
-
-    return batcher_ptr;
+    prefetch_chase(reg->memory, (uintptr_t) source, size, target);
+    return true;
 }
 
-void destroy_batcher(batcher* batcher) {
-    if (batcher == NULL) return;
-
-    blocked_thread* current = batcher->blocked_threads_head;
-    while (current != NULL) {
-        blocked_thread* next = current->next;
-        sem_destroy(&current->sem);
-        free(current);
-        current = next;
+/**
+ * @brief Checks that a transaction can write, validating its elastic reads first if it did not write yet.
+ * @return Whether the transaction can continue
+ */
+static bool begin_writing(region* reg, transaction* t) {
+    if (unlikely(t->is_ro)) {
+        stats_add(&reg->stats.aborts, 1);
+        end_read_only(reg, t);
+        return false;
     }
-
-    if (batcher->lock != NULL) {
-        pthread_mutex_destroy(batcher->lock);
-        batcher->lock = NULL;
+    if (!t->wrote && !end_elastic(t)) {
+        retire_transaction(reg, t, false);
+        return false;
     }
-
-    free(batcher);
+    return true;
 }
 
-void wake_up_threads(batcher* batcher) {
-    if (batcher->blocked_threads_head == NULL) return;
-    sem_post(&batcher->blocked_threads_head->sem);
+/**
+ * @brief Writes a range of words in a read-write transaction.
+ * @return Whether the transaction can continue
+ */
+static bool write_range(region* reg, transaction* t, void const* source, size_t size, void* target) {
+    if (unlikely(!begin_writing(reg, t)))
+        return false;
+    segment* seg = get_segment(reg->memory, (uintptr_t) target >> SEGMENT_SHIFT);
+    size_t align = reg->align;
+    size_t first = ((uintptr_t) target & OFFSET_MASK) / align;
+    size_t nb = size / align;
+
+    for (size_t i = 0; i < nb; i++) {
+        if (unlikely(!write_word(t, seg, first + i, (uint8_t const*) source + i * align))) {
+            t->conflict_key = conflict_key(seg, first + i);
+            retire_transaction(reg, t, false);
+            return false;
+        }
+    }
+    return true;
 }
 
-void enter_batcher(batcher* batcher, blocked_thread* blocked_thread) {
-
-
-    pthread_mutex_lock(batcher->lock);
+/* STM PART */
 
+/**
+ * @brief Creates a region, with all its state allocated in the given arena.
+ * @param a     Arena, NULL for the C allocator
+ * @param size  Size of the first segment (in bytes)
+ * @param align Size of a word (in bytes)
+ * @return The region, NULL on failure
+ */
+static region* create_region(arena* a, size_t size, size_t align) {
+    region* reg = (region*) arena_malloc(a, sizeof(region));
+    if (unlikely(reg == NULL)) return NULL;
+    reg->arena = a;
+    load_config(&reg->config);
+    if (a != NULL) {
+        // Version chains, snapshot pages and the log are private, so no other process could use them
+        reg->config.multiversion = false;
+        reg->config.snapshot = false;
+        reg->config.wal = NULL;
+        reg->config.checkpoint = NULL;
+    }
+    init_stats(&reg->stats);
+    reg->mv = NULL;
+    reg->snaps = NULL;
+    reg->adaptive = NULL;
+    reg->wal = NULL;
+    reg->checkpoints = NULL;
+    reg->checkpoint_path = NULL;
+    reg->replica = false;
+    reg->replica_rx.fd = -1;
+    atomic_init(&reg->replica_epoch, 0);
+    reg->memory = init_memory(a);
+    if (unlikely(reg->memory == NULL)) {
+        arena_free(a, reg);
+        return NULL;
+    }
+    reg->batcher = init_batcher(a);
+    if (unlikely(reg->batcher == NULL)) {
+        destroy_memory(reg->memory);
+        arena_free(a, reg);
+        return NULL;
+    }
+    if (reg->config.multiversion) {
+        reg->memory->multiversion = true;
+        reg->mv = init_multiversion(reg->config.max_versions);
+        if (unlikely(reg->mv == NULL)) {
+            destroy_batcher(reg->batcher);
+            destroy_memory(reg->memory);
+            arena_free(a, reg);
+            return NULL;
+        }
+    }
+    if (reg->config.snapshot) {
+        reg->snaps = init_snapshots(&reg->stats);
+        if (unlikely(reg->snaps == NULL)) {
+            destroy_batcher(reg->batcher);
+            destroy_memory(reg->memory);
+            arena_free(a, reg);
+            return NULL;
+        }
+    }
+    if (reg->config.adaptive) {
+        reg->adaptive = init_adaptive(a, reg->config.adaptive_window_us * 1000, reg->config.adaptive_high, reg->config.adaptive_low, now_ns());
+        if (unlikely(reg->adaptive == NULL)) {
+            destroy_snapshots(reg->snaps);
+            destroy_multiversion(reg->mv);
+            destroy_batcher(reg->batcher);
+            destroy_memory(reg->memory);
+            arena_free(a, reg);
+            return NULL;
+        }
+    }
+    reg->start_id = allocate_segment(reg->memory, size, align);
+    if (unlikely(reg->start_id < 0)) {
+        destroy_adaptive(reg->adaptive);
+        destroy_snapshots(reg->snaps);
+        destroy_multiversion(reg->mv);
+        destroy_batcher(reg->batcher);
+        destroy_memory(reg->memory);
+        arena_free(a, reg);
+        return NULL;
+    }
+    if (reg->config.wal != NULL) {
+        reg->wal = open_wal(reg->config.wal, reg->config.wal_async, reg->memory, size, align, &reg->stats);
+        if (unlikely(reg->wal == NULL)) {
+            destroy_adaptive(reg->adaptive);
+            destroy_snapshots(reg->snaps);
+            destroy_multiversion(reg->mv);
+            destroy_batcher(reg->batcher);
+            destroy_memory(reg->memory);
+            arena_free(a, reg);
+            return NULL;
+        }
+        reg->config.wal = NULL; // Belongs to the environment
+    }
+    if (unlikely(pthread_mutex_init(&reg->checkpoint_lock, NULL) != 0 || pthread_cond_init(&reg->checkpoint_cond, NULL) != 0)) {
+        close_wal(reg->wal);
+        destroy_adaptive(reg->adaptive);
+        destroy_snapshots(reg->snaps);
+        destroy_multiversion(reg->mv);
+        destroy_batcher(reg->batcher);
+        destroy_memory(reg->memory);
+        arena_free(a, reg);
+        return NULL;
+    }
+    reg->size = size;
+    reg->align = align;
+    reg->closed = false;
+    atomic_init(&reg->ending_epoch, false);
+    atomic_init(&reg->next_tx_id, 1);
+    atomic_init(&reg->retired, NULL);
+    return reg;
+}
 
-    if (batcher->remaining == 0) {
-        // Maybe use atomic operations of C
-        batcher->remaining++;
+static bool take_checkpoint(region* reg, char const* path);
 
-        pthread_mutex_unlock(batcher->lock);
-        printf("🆕 | Thread %d\n\n", blocked_thread->id);
+/**
+ * @brief Background checkpointer: checkpoints the region at a fixed interval until it is destroyed.
+ */
+static void* checkpointer(void* arg) {
+    region* reg = (region*) arg;
+    pthread_mutex_lock(&reg->checkpoint_lock);
+    while (!reg->checkpoint_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        uint64_t ns = (uint64_t) deadline.tv_nsec + reg->config.checkpoint_ms * 1000000;
+        deadline.tv_sec += (time_t) (ns / 1000000000);
+        deadline.tv_nsec = (long) (ns % 1000000000);
+        while (!reg->checkpoint_stop && pthread_cond_timedwait(&reg->checkpoint_cond, &reg->checkpoint_lock, &deadline) == 0);
+        if (!reg->checkpoint_stop)
+            take_checkpoint(reg, reg->checkpoint_path);
+    }
+    pthread_mutex_unlock(&reg->checkpoint_lock);
+    return NULL;
+}
 
-        //print_batcher(batcher);
+/**
+ * @brief Starts the background checkpointer if DV_CHECKPOINT is set, on the first file of its family that no other
+ * region holds (see 'claim_file'). The region goes on without it on failure.
+ * @param reg Region, in which no transaction has run yet
+ */
+static void start_checkpointer(region* reg) {
+    if (reg->config.checkpoint == NULL) return;
+    reg->checkpoint_stop = false;
+    reg->checkpoint_claim = claim_file(reg->config.checkpoint, ".lock", &reg->checkpoint_path);
+    reg->config.checkpoint = NULL; // Belongs to the environment
+    if (reg->checkpoint_claim < 0) {
+        fprintf(stderr, "Failed to start the checkpointer\n");
         return;
     }
-
-    if (batcher->blocked_threads_tail == NULL) {
-        batcher->blocked_threads_head = blocked_thread;
-        batcher->blocked_threads_tail = blocked_thread;
-        blocked_thread->next = NULL;
-    } else {
-        batcher->blocked_threads_tail->next = blocked_thread;
-        batcher->blocked_threads_tail = blocked_thread;
-        blocked_thread->next = NULL;
+    if (pthread_create(&reg->checkpointer, NULL, checkpointer, reg) != 0) {
+        fprintf(stderr, "Failed to start the checkpointer\n");
+        close(reg->checkpoint_claim);
+        free(reg->checkpoint_path);
+        reg->checkpoint_path = NULL;
     }
+}
 
-    pthread_mutex_unlock(batcher->lock);
-
-    
-    /* Make the current thread sleep using sem (sem_t) which is contained in blocked_thread, wake him up when sem tells the thread to wake up */
-    //print_batcher(batcher);
-    printf("⌛ | Thread %d\n\n", blocked_thread->id);
-    sem_wait(&blocked_thread->sem);
-    printf("🆕 | Thread %d\n\n", blocked_thread->id);
-
+/**
+ * @brief Creates a region in a new arena, which is removed on failure.
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+ */
+static shared_t create_in_arena(arena* a, size_t size, size_t align) {
+    if (a == NULL) return invalid_shared;
+    region* reg = create_region(a, size, align);
+    if (unlikely(reg == NULL)) {
+        destroy_arena(a);
+        return invalid_shared;
+    }
+    a->root = reg;
+    return reg;
+}
 
+/** Create (i.e. allocate + init) a new shared memory region, with one first non-free-able allocated segment of the requested size and alignment.
+ * If DV_WAL names an existing log, the region is first rebuilt from it. If DV_CHECKPOINT is set,
+ * the region is checkpointed to it every DV_CHECKPOINT_MS milliseconds until it is destroyed.
+ * Each region holds its own log and checkpoint file: the first of DV_WAL, DV_WAL.1, DV_WAL.2...
+ * that no other region holds (and likewise for DV_CHECKPOINT, locked through a '.lock' file).
+ * @param size  Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
+ * @param align Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_create(size_t size, size_t align) {
+    if (size == 0 || align == 0 || size > OFFSET_MASK || (align & (align - 1)) != 0) return invalid_shared;
+    if (size % align != 0) return invalid_shared;
+    region* reg = create_region(NULL, size, align);
+    if (reg == NULL) return invalid_shared;
+    start_checkpointer(reg);
+    return reg;
+}
 
-    /* 
-    FIXME : If a thread assigns itself right after the IF condition as the next element of the tail, it will never be woken up.
-    Solution 1: lock the mutex again and check if the next element is the current thread, if so, wake it up.
-    */
-    // Solution 1
-    pthread_mutex_lock(batcher->lock);
-    batcher->remaining++;
+/** Create a shared memory region as for 'tm_create', held entirely in a new named POSIX shared memory object.
+ * Other processes join it with 'tm_attach' and run transactions on it directly; the addresses
+ * in the region are the same in every process. All the data, segments and transaction logs
+ * live in the object, which must be large enough for them. DV_MULTIVERSION and DV_SNAPSHOT are ignored.
+ * @param name     Name of the object (as for 'shm_open'), which must not exist
+ * @param capacity Size of the object (in bytes), only backed by memory as it is used
+ * @param size     Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
+ * @param align    Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_create_shared(char const* name, size_t capacity, size_t size, size_t align) {
+    if (size == 0 || align == 0 || size > OFFSET_MASK || (align & (align - 1)) != 0) return invalid_shared;
+    if (size % align != 0) return invalid_shared;
+    return create_in_arena(create_arena(name, capacity, false), size, align);
+}
 
-    //print_batcher(batcher);
+/** Attach to a shared memory region created by another process with 'tm_create_shared'.
+ * @param name Name of the shared memory object
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_attach(char const* name) {
+    arena* a = attach_arena(name, false);
+    if (a == NULL) return invalid_shared;
+    return a->root;
+}
 
-    /* Wake up the next thread in the list */
-    if (blocked_thread->next == NULL) {
-        // Solution 1
-        batcher->blocked_threads_tail = NULL;
-        batcher->blocked_threads_head = NULL;
-        blocked_thread = NULL;
+/** Detach the calling process from a shared memory region, leaving it to the other processes.
+ * @param shared Shared memory region, with no running transaction in this process
+**/
+void tm_detach(shared_t shared) {
+    region* reg = (region*) shared;
+    if (reg->arena != NULL)
+        detach_arena(reg->arena);
+}
 
-        pthread_mutex_unlock(batcher->lock);
+/** Create a shared memory region as for 'tm_create', held entirely in a new memory-mapped file.
+ * The region outlives the process: after 'tm_close', 'tm_open' maps it again as of its last
+ * completed epoch, without copying its content. DV_MULTIVERSION and DV_SNAPSHOT are ignored.
+ * @param path     Path of the file, which must not exist
+ * @param capacity Size of the file (in bytes), only backed by disk blocks as it is used
+ * @param size     Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
+ * @param align    Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_create_file(char const* path, size_t capacity, size_t size, size_t align) {
+    if (size == 0 || align == 0 || size > OFFSET_MASK || (align & (align - 1)) != 0) return invalid_shared;
+    if (size % align != 0) return invalid_shared;
+    return create_in_arena(create_arena(path, capacity, true), size, align);
+}
 
-        return;
+/** Open a region created with 'tm_create_file', in the state of its last completed epoch.
+ * The file is mapped, not read: the cost is that of the page faults of the words accessed later.
+ * If the last process using the region stopped without 'tm_close', the access sets left by
+ * its transactions are cleared first, which reads every control word. The region must not be
+ * used by another process. The file is not recoverable if that process stopped while ending an epoch.
+ * @param path Path of the file
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_open(char const* path) {
+    arena* a = attach_arena(path, true);
+    if (a == NULL) return invalid_shared;
+    region* reg = (region*) a->root;
+    if (reg == NULL || atomic_load(&reg->ending_epoch)) {
+        fprintf(stderr, "Region '%s' was left while ending an epoch\n", path);
+        detach_arena(a);
+        return invalid_shared;
     }
-
-    // Solution 1
-    pthread_mutex_unlock(batcher->lock);
-    
-    sem_post(&blocked_thread->next->sem);
-    blocked_thread = NULL;
-
+    bool interrupted = !reg->closed;
+    atomic_store(&reg->retired, NULL);
+    if (!arena_init_mutex(a, &a->lock) || !recover_batcher(reg->batcher) || !recover_memory(reg->memory, interrupted)) {
+        fprintf(stderr, "Failed to recover region '%s'\n", path);
+        detach_arena(a);
+        return invalid_shared;
+    }
+    reg->closed = false;
+    return reg;
 }
 
-void leave_batcher(batcher* batcher) {
-    pthread_mutex_lock(batcher->lock);
+/** Close a region created with 'tm_create_file', writing it back to its file.
+ * @param shared Shared memory region, with no running transaction
+**/
+void tm_close(shared_t shared) {
+    region* reg = (region*) shared;
+    if (reg->arena == NULL || !reg->arena->file) return;
+    reg->closed = true;
+    sync_arena(reg->arena);
+    detach_arena(reg->arena);
+}
 
-    int remaining = batcher->remaining;
+/**
+ * @brief Takes a checkpoint of a region, holding its checkpoint lock.
+ *
+ * The modified pages are copied from inside the batcher, where the readable copies and the
+ * marks cannot change: the copy only delays the end of the epoch it runs in, while the
+ * transactions of that epoch go on. The first checkpoint, which starts tracking the
+ * modifications, runs in an epoch of its own instead, so that no uncommitted segment is tracked.
+ * The file is written after leaving the batcher.
+ *
+ * @param reg  Region, not in an arena
+ * @param path Path of the file
+ * @return Whether the operation is a success
+ */
+static bool take_checkpoint(region* reg, char const* path) {
+    if (strlen(path) >= PATH_MAX) return false;
+    blocked_thread waiter;
+    if (unlikely(!init_blocked_thread(&waiter, 0))) return false;
+    bool tracked = reg->checkpoints != NULL;
+    if (tracked)
+        enter_batcher(reg->batcher, &waiter);
+    else
+        enter_batcher_alone(reg->batcher, &waiter);
+    uint64_t start = now_ns();
+    if (!tracked)
+        reg->checkpoints = init_checkpoints(reg->memory, &reg->stats);
+    checkpoints* cps = reg->checkpoints;
+    bool full = cps != NULL && strcmp(cps->path, path) != 0;
+    bool success = cps != NULL && capture_checkpoint(cps, reg->memory, full, reg->batcher->epoch);
+    stats_add(&reg->stats.checkpoint_pause_ns, now_ns() - start);
+    leave_batcher(reg->batcher, end_epoch, reg);
+    destroy_blocked_thread(&waiter);
+
+    if (success)
+        success = write_checkpoint(cps, path, full, reg->size, reg->align);
+    if (cps != NULL) {
+        if (success)
+            strcpy(cps->path, path);
+        else
+            cps->path[0] = '\0'; // The marks of the lost increment are cleared: the next checkpoint saves everything
+    }
+    return success;
+}
 
-    if (remaining == 1) {
-        printf("🚀 | Thread X (remaining=%d) Waking up the Blocked Threads.\n\n", remaining);
+/** [thread-safe] Checkpoint a region to a file, from which 'tm_restore' rebuilds it as of the checkpoint.
+ * Only the pages modified since the previous checkpoint to the same file are appended to it; a checkpoint to
+ * another file replaces it with a full one. The running transactions are not stopped: the copy only delays
+ * the end of their epoch, and the file is written after. Not available for regions held in an arena.
+ * @param shared Shared memory region
+ * @param path   Path of the file
+ * @return Whether the operation is a success
+**/
+bool tm_checkpoint(shared_t shared, char const* path) {
+    region* reg = (region*) shared;
+    if (reg->arena != NULL) return false;
+    pthread_mutex_lock(&reg->checkpoint_lock);
+    bool success = take_checkpoint(reg, path);
+    pthread_mutex_unlock(&reg->checkpoint_lock);
+    return success;
+}
 
-        /* Update the memory since no thread is able to access it. I.e. all other threads are sleeping */
-        
-        /* 
-        We would maybe want to use a lock to prevent a new process to enter the batcher and bypass the semaphore by seeing remaining == 0
-        but it is not necessary since if a new process arrives at this moment, it will not be blocked and work with the other processes and also increment "remaining" by one as expected.
-        */
-        batcher->remaining--;
-        batcher->epoch++;
-        print_batcher(batcher);
-        wake_up_threads(batcher);
+/** Create a shared memory region from a file written by 'tm_checkpoint', as of its last complete checkpoint.
+ * As with 'tm_create', DV_CHECKPOINT starts checkpointing it again.
+ * @param path Path of the file
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_restore(char const* path) {
+    size_t size, align;
+    if (!read_checkpoint_shape(path, &size, &align)) return invalid_shared;
+    region* reg = create_region(NULL, size, align);
+    if (reg == NULL) return invalid_shared;
+    if (!restore_checkpoint(path, reg->memory)) {
+        tm_destroy(reg);
+        return invalid_shared;
+    }
+    start_checkpointer(reg);
+    return reg;
+}
 
-        //print_batcher(batcher);
+/** [thread-safe] Start replicating a region to a stream: the current content of the region is sent,
+ * then the writes, allocations and frees committed in each epoch, as one batch at its end.
+ * An epoch does not end while the batch does not fit in the stream buffers, which bounds how far
+ * the replica lags behind. Replication stops if the replica goes away. Not available for regions held in an arena.
+ * @param shared Shared memory region
+ * @param fd     Connected Unix socket or pipe, owned by the region on success
+ * @return Whether the operation is a success
+**/
+bool tm_replicate(shared_t shared, int fd) {
+    region* reg = (region*) shared;
+    if (reg->arena != NULL) return false;
+    blocked_thread waiter;
+    if (unlikely(!init_blocked_thread(&waiter, 0))) return false;
+    enter_batcher_alone(reg->batcher, &waiter);
+    bool created = reg->wal == NULL;
+    if (created)
+        reg->wal = open_stream(reg->align, &reg->stats);
+    bool success = reg->wal != NULL && wal_add_stream(reg->wal, fd, reg->memory, reg->start_id, reg->size, reg->batcher->epoch);
+    if (!success && created) {
+        close_wal(reg->wal);
+        reg->wal = NULL;
+    }
+    leave_batcher(reg->batcher, end_epoch, reg);
+    destroy_blocked_thread(&waiter);
+    return success;
+}
 
-        pthread_mutex_unlock(batcher->lock);
+// Maximum number of batches of the primary a replica applies in one of its epochs
+#define REPLICA_GROUP 256
 
-        return;
+/**
+ * @brief Applies the records of a batch of the primary in an irrevocable transaction of a replica.
+ * The records go through the end of epoch like those of a local transaction, and on to the log,
+ * checkpoints or replica of the replica.
+ * @return Whether the batch matches the replica, in which case the transaction can continue
+ */
+static bool apply_records(region* reg, transaction* tx, uint8_t const* records, size_t length) {
+    for (size_t at = 0; at < length;) {
+        wal_record record;
+        bool valid = length - at >= sizeof(record);
+        if (valid) {
+            memcpy(&record, records + at, sizeof(record));
+            at += sizeof(record);
+        }
+        if (valid && record.kind == WAL_ALLOC) {
+            valid = reserve_one(tx->arena, (void**) &tx->allocs, &tx->allocs_capacity, tx->nb_allocs, sizeof(int))
+                && allocate_segment_at(reg->memory, (int) record.segment, record.arg, reg->align);
+            if (valid)
+                tx->allocs[tx->nb_allocs++] = (int) record.segment;
+        } else if (valid && record.kind == WAL_FREE) {
+            valid = (int) record.segment != reg->start_id && get_segment(reg->memory, record.segment) != NULL
+                && reserve_one(tx->arena, (void**) &tx->frees, &tx->frees_capacity, tx->nb_frees, sizeof(int));
+            if (valid)
+                tx->frees[tx->nb_frees++] = (int) record.segment;
+        } else if (valid && record.kind == WAL_WRITE) {
+            segment* seg = get_segment(reg->memory, record.segment);
+            valid = seg != NULL && record.arg < seg->nb_words && length - at >= reg->align
+                && write_word(tx, seg, record.arg, records + at);
+            at += reg->align;
+        } else {
+            valid = false;
+        }
+        if (unlikely(!valid)) return false;
     }
-    
-    printf("🚀 | Thread X (remaining=%d)\n\n", remaining);
-    // Maybe use atomic operations of C
-    batcher->remaining--;
-    //print_batcher(batcher);
-    pthread_mutex_unlock(batcher->lock);
+    return true;
 }
 
+/**
+ * @brief Receives and applies the batches of the primary, until the end of the stream.
+ *
+ * Each group of batches is applied in an epoch of its own, so that read-only transactions see
+ * whole epochs of the primary. The batches already received are grouped, so that a replica
+ * falling behind catches up with one epoch per group rather than per batch. A group ends
+ * after a batch that frees segments, whose ids are only released at the end of the epoch.
+ */
+static void* replicator(void* arg) {
+    region* reg = (region*) arg;
+    wal_receiver* rx = &reg->replica_rx;
+    wal_batch_header header;
+    uint8_t const* records;
+    bool received = wal_receive(rx, &header, &records);
+    while (received) {
+        transaction* tx = (transaction*) begin_transaction(reg, false, true, NULL, BATCHER_NO_TIMEOUT);
+        if (unlikely(tx == (transaction*) invalid_tx)) break;
+        uint64_t nb_batches = 0, nb_bytes = 0, epoch = 0;
+        bool valid, grouped;
+        do {
+            size_t nb_frees = tx->nb_frees;
+            valid = apply_records(reg, tx, records, header.length);
+            nb_batches++;
+            nb_bytes += sizeof(header) + header.length;
+            epoch = header.epoch;
+            grouped = valid && tx->nb_frees == nb_frees && nb_batches < REPLICA_GROUP && wal_receive_ready(rx);
+        } while (grouped && (received = wal_receive(rx, &header, &records)));
+        retire_transaction(reg, tx, valid);
+        if (!valid) {
+            fprintf(stderr, "Batch of the primary does not match the replica, no longer replicating\n");
+            break;
+        }
+        atomic_store(&reg->replica_epoch, epoch);
+        stats_add(&reg->stats.replication_bytes, nb_bytes);
+        stats_add(&reg->stats.replication_batches, nb_batches);
+        if (received)
+            received = wal_receive(rx, &header, &records);
+    }
+    return NULL;
+}
 
-/* STM PART */
-
-/** Create (i.e. allocate + init) a new shared memory region, with one first non-free-able allocated segment of the requested size and alignment.
- * @param size  Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
- * @param align Alignment (in bytes, must be a power of 2) that the shared memory region must support
+/** Create a read replica of a region replicated with 'tm_replicate'. It returns once the content
+ * of the primary is copied; a background thread then applies the batches of the epochs of the
+ * primary, in epochs of its own. Only read-only transactions can run on the replica.
+ * It stops following the primary at the end of the stream, and stays readable until destroyed.
+ * @param fd Connected Unix socket or pipe, owned by the region on success
  * @return Opaque shared memory region handle, 'invalid_shared' on failure
 **/
-shared_t tm_create(size_t unused(size), size_t unused(align)) {
-    if (size <= 0 || align <= 0 || size > (1ULL << 48) || align % 2 != 0) return invalid_shared;
-    if (size % align != 0) return invalid_shared;
-    
-    // FIXME: Ask about the alignment of the memory with the structures already created.
-    return invalid_shared;
+shared_t tm_replica(int fd) {
+    wal_receiver rx;
+    size_t size, align;
+    if (!open_receiver(&rx, fd, &size, &align) || size == 0 || align == 0 || size > OFFSET_MASK
+        || (align & (align - 1)) != 0 || size % align != 0) {
+        free(rx.buffer);
+        return invalid_shared;
+    }
+    region* reg = create_region(NULL, size, align);
+    if (reg == NULL) {
+        free(rx.buffer);
+        return invalid_shared;
+    }
+    reg->replica = true;
+    wal_batch_header header;
+    uint8_t const* records;
+    transaction* tx = (transaction*) begin_transaction(reg, false, true, NULL, BATCHER_NO_TIMEOUT);
+    bool success = tx != (transaction*) invalid_tx && wal_receive(&rx, &header, &records)
+        && apply_records(reg, tx, records, header.length);
+    if (tx != (transaction*) invalid_tx)
+        retire_transaction(reg, tx, success);
+    if (success) {
+        atomic_store(&reg->replica_epoch, header.epoch);
+        reg->replica_rx = rx;
+        success = pthread_create(&reg->replicator, NULL, replicator, reg) == 0;
+    }
+    if (!success) {
+        fprintf(stderr, "Failed to replicate the primary\n");
+        free(rx.buffer);
+        reg->replica_rx.fd = -1;
+        tm_destroy(reg);
+        return invalid_shared;
+    }
+    start_checkpointer(reg);
+    return reg;
 }
 
 /** Destroy (i.e. clean-up + free) a given shared memory region.
  * @param shared Shared memory region to destroy, with no running transaction
 **/
-void tm_destroy(shared_t unused(shared)) {
-    // TODO: tm_destroy(shared_t)
+void tm_destroy(shared_t shared) {
+    region* reg = (region*) shared;
+    if (reg->checkpoint_path != NULL) {
+        pthread_mutex_lock(&reg->checkpoint_lock);
+        reg->checkpoint_stop = true;
+        pthread_cond_signal(&reg->checkpoint_cond);
+        pthread_mutex_unlock(&reg->checkpoint_lock);
+        pthread_join(reg->checkpointer, NULL);
+        close(reg->checkpoint_claim);
+        free(reg->checkpoint_path);
+    }
+    if (reg->replica_rx.fd >= 0) {
+        shutdown(reg->replica_rx.fd, SHUT_RDWR); // Ends a pending receive, unless the stream is a pipe
+        pthread_join(reg->replicator, NULL);
+        close_receiver(&reg->replica_rx);
+    }
+    close_wal(reg->wal);
+    if (reg->config.stats) {
+        print_stats(&reg->stats, stderr);
+        if (reg->adaptive != NULL)
+            print_adaptive_log(reg->adaptive, stderr);
+    }
+    if (reg->arena != NULL) {
+        destroy_arena(reg->arena);
+        return;
+    }
+    destroy_checkpoints(reg->checkpoints);
+    pthread_cond_destroy(&reg->checkpoint_cond);
+    pthread_mutex_destroy(&reg->checkpoint_lock);
+    destroy_adaptive(reg->adaptive);
+    destroy_snapshots(reg->snaps);
+    destroy_multiversion(reg->mv);
+    destroy_batcher(reg->batcher);
+    destroy_memory(reg->memory);
+    free(reg);
 }
 
 /** [thread-safe] Return the start address of the first allocated segment in the shared memory region.
  * @param shared Shared memory region to query
  * @return Start address of the first allocated segment
 **/
-void* tm_start(shared_t unused(shared)) {
-    // TODO: tm_start(shared_t)
-    return NULL;
+void* tm_start(shared_t shared) {
+    return segment_address(((region*) shared)->start_id, 0);
 }
 
 /** [thread-safe] Return the size (in bytes) of the first allocated segment of the shared memory region.
  * @param shared Shared memory region to query
  * @return First allocated segment size
 **/
-size_t tm_size(shared_t unused(shared)) {
-    // TODO: tm_size(shared_t)
-    return 0;
+size_t tm_size(shared_t shared) {
+    return ((region*) shared)->size;
 }
 
 /** [thread-safe] Return the alignment (in bytes) of the memory accesses on the given shared memory region.
  * @param shared Shared memory region to query
  * @return Alignment used globally
 **/
-size_t tm_align(shared_t unused(shared)) {
-    // TODO: tm_align(shared_t)
-    return 0;
+size_t tm_align(shared_t shared) {
+    return ((region*) shared)->align;
+}
+
+/**
+ * @brief Allocates the descriptor of a transaction, not admitted in any epoch yet.
+ * @return The descriptor, NULL on failure
+ */
+static transaction* new_transaction(region* reg, bool is_ro) {
+    transaction* tx = (transaction*) arena_calloc(reg->arena, 1, sizeof(transaction));
+    if (unlikely(tx == NULL)) return NULL;
+    if (unlikely(!init_blocked_thread(&tx->waiter, 0))) {
+        arena_free(reg->arena, tx);
+        return NULL;
+    }
+    tx->arena = reg->arena;
+    tx->is_ro = is_ro;
+    tx->mv_slot = -1;
+    return tx;
+}
+
+/**
+ * @brief Starts a transaction admitted in the current epoch.
+ * @return Opaque transaction ID
+ */
+static tx_t start_transaction(region* reg, transaction* tx) {
+    if (reg->config.stats)
+        tx->start_ns = now_ns();
+    tx->id = atomic_fetch_add_explicit(&reg->next_tx_id, 1, memory_order_relaxed);
+    tx->live = !tx->is_ro;
+    return (tx_t) tx;
+}
+
+/**
+ * @brief Empties the logs of a kept transaction that aborted, keeping their buffers, for its next attempt.
+ * Must only be called once the end of the epoch it aborted in has run, e.g. once admitted into a later one.
+ */
+static void recycle_transaction(transaction* tx) {
+    transaction old = *tx;
+    *tx = (transaction) {
+        .arena = old.arena, .is_ro = old.is_ro, .kept = true, .waiter = old.waiter, .mv_slot = -1,
+        .accesses = old.accesses, .accesses_capacity = old.accesses_capacity,
+        .allocs = old.allocs, .allocs_capacity = old.allocs_capacity,
+        .frees = old.frees, .frees_capacity = old.frees_capacity,
+        .adds = old.adds, .adds_capacity = old.adds_capacity,
+        .long_scan = old.long_scan,
+    };
+}
+
+/**
+ * @brief Starts a new or kept transaction once admitted into its epoch.
+ * The fields the end of an epoch reads are only written then, as a kept transaction may still be in the previous one.
+ * @return Opaque transaction ID
+ */
+static tx_t enter_epoch(region* reg, transaction* tx, bool irrevocable) {
+    if (tx->kept)
+        recycle_transaction(tx);
+    tx->irrevocable = irrevocable;
+    tx->plain_adds = irrevocable || state_of(reg)->plain_adds;
+    return start_transaction(reg, tx);
+}
+
+/**
+ * @brief Admits a new or kept transaction into an epoch, in one of its own if irrevocable or if the region is in serial mode.
+ * @param reg         Region
+ * @param tx          Transaction, destroyed on failure
+ * @param irrevocable Whether the (read-write) transaction must not abort
+ * @param timeout_ns  Longest time to wait for an epoch (in ns), BATCHER_NO_TIMEOUT for no limit
+ * @param notify      New transaction only: if not NULL, returns at once, the transaction pending until admitted (see 'tm_begin_async')
+ * @return Opaque transaction ID, 'invalid_tx' on failure, with errno set to ETIMEDOUT if it was not admitted in time
+ */
+static tx_t admit_transaction(region* reg, transaction* tx, bool irrevocable, uint64_t timeout_ns, _Atomic(uint32_t)* notify) {
+    bool is_ro = tx->is_ro;
+    if (is_ro && reg->mv != NULL && mv_pin(reg->mv, &tx->mv_slot, &tx->snapshot))
+        return (tx_t) tx; // Reads its snapshot without joining the batcher
+    if (is_ro && reg->snaps != NULL && (tx->snap = acquire_snapshot(reg->snaps)) != NULL)
+        return (tx_t) tx; // Likewise, with a copy-on-write snapshot
+    bool serial = !irrevocable && reg->adaptive != NULL && adaptive_serial(reg->adaptive);
+    unsigned int key = 0;
+    if (serial) {
+        stats_add(&reg->stats.serial, 1);
+    } else if (!irrevocable && !is_ro && state_of(reg)->parked_key != 0) {
+        // Aborted on a word: runs in the next epoch without another transaction that aborted on it
+        stats_add(&reg->stats.parked, 1);
+        key = state_of(reg)->parked_key;
+    }
+    if (notify != NULL) {
+        if (!enter_batcher_async(reg->batcher, &tx->waiter, irrevocable || serial, key, notify)) {
+            tx->pending = true;
+            tx->irrevocable = irrevocable; // Started by 'tm_admitted'
+            return (tx_t) tx;
+        }
+    } else if (unlikely(!enter_batcher_timed(reg->batcher, &tx->waiter, irrevocable || serial, key, timeout_ns))) {
+        stats_add(&reg->stats.timeouts, 1);
+        destroy_transaction(tx);
+        errno = ETIMEDOUT;
+        return invalid_tx;
+    }
+    return enter_epoch(reg, tx, irrevocable);
+}
+
+/**
+ * @brief Prepares a new transaction for what its hints tell it will do: a long scan prefetches ahead, and the access
+ * log of a read-write transaction is sized for the expected reads and writes before it waits for its epoch.
+ * @param reg   Region
+ * @param tx    New transaction
+ * @param hints Hints on the transaction
+ */
+static void apply_hints(region* reg, transaction* tx, tm_hints const* hints) {
+    tx->long_scan = hints->long_scan;
+    size_t expected = hints->reads + hints->writes;
+    if (expected < hints->reads || expected > SIZE_MAX / sizeof(access_entry))
+        expected = 0; // Unrealistic hints: the log grows as it runs instead
+    if (!tx->is_ro && expected > 0 && likely((tx->accesses = (access_entry*) arena_malloc(reg->arena, expected * sizeof(access_entry))) != NULL))
+        tx->accesses_capacity = expected; // Allocated before entering the epoch, rather than grown while running in it
+}
+
+/**
+ * @brief Begins a new transaction.
+ * @param reg         Region
+ * @param is_ro       Whether the transaction is read-only
+ * @param irrevocable Whether the (read-write) transaction must not abort
+ * @param hints       Hints on the transaction, NULL if none
+ * @param timeout_ns  Longest time to wait for an epoch (in ns), BATCHER_NO_TIMEOUT for no limit
+ * @return Opaque transaction ID, 'invalid_tx' on failure, with errno set to ETIMEDOUT if it was not admitted in time
+ */
+static tx_t begin_transaction(region* reg, bool is_ro, bool irrevocable, tm_hints const* hints, uint64_t timeout_ns) {
+    transaction* tx = new_transaction(reg, is_ro);
+    if (unlikely(tx == NULL)) return invalid_tx;
+    if (hints != NULL)
+        apply_hints(reg, tx, hints);
+    return admit_transaction(reg, tx, irrevocable, timeout_ns, NULL);
 }
 
 /** [thread-safe] Begin a new transaction on the given shared memory region.
+ * A read-write transaction of a thread that aborted DV_IRREVOCABLE_AFTER times in a row runs irrevocably.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+**/
+tx_t tm_begin(shared_t shared, bool is_ro) {
+    region* reg = (region*) shared;
+    if (unlikely(!is_ro && reg->replica)) return invalid_tx;
+    uint64_t after = reg->config.irrevocable_after;
+    return begin_transaction(reg, is_ro, !is_ro && after > 0 && state_of(reg)->consecutive_aborts >= after, NULL, BATCHER_NO_TIMEOUT);
+}
+
+/**
+ * @brief Scales a configured number of aborts after which a transaction runs irrevocably by its hints.
+ * A positive priority divides it by 1 + priority, a negative one multiplies it by 1 - priority, and a long scan
+ * counts as one more priority; it stays at least 1, and 0 (never) is left as configured.
+ * @param after Configured number of aborts, 0 for never
+ * @return Aborts after which the transaction runs irrevocably, 0 for never
+ */
+static uint64_t irrevocable_threshold(uint64_t after, tm_hints const* hints) {
+    int64_t priority = (int64_t) hints->priority + (hints->long_scan ? 1 : 0);
+    if (after == 0 || priority == 0)
+        return after;
+    if (priority > 0) {
+        uint64_t scaled = after / (1 + (uint64_t) priority);
+        return scaled > 0 ? scaled : 1;
+    }
+    uint64_t factor = 1 + (uint64_t) -priority;
+    return after > UINT64_MAX / factor ? UINT64_MAX : after * factor;
+}
+
+/** [thread-safe] Begin a new transaction on the given shared memory region, with hints on what it does.
+ * Its access log is sized for the expected reads and writes before it waits for its epoch.
+ * A long scan prefetches ahead from its first read. A read-write transaction runs irrevocably as in 'tm_begin',
+ * after fewer consecutive aborts of its thread if it has a positive priority or is a long scan, more if it has
+ * a negative priority.
  * @param shared Shared memory region to start a transaction on
  * @param is_ro  Whether the transaction is read-only
+ * @param hints  Hints on the transaction, NULL for none
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+**/
+tx_t tm_begin_ex(shared_t shared, bool is_ro, tm_hints const* hints) {
+    region* reg = (region*) shared;
+    if (hints == NULL)
+        return tm_begin(shared, is_ro);
+    if (unlikely(!is_ro && reg->replica)) return invalid_tx;
+    uint64_t after = irrevocable_threshold(reg->config.irrevocable_after, hints);
+    return begin_transaction(reg, is_ro, !is_ro && after > 0 && state_of(reg)->consecutive_aborts >= after, hints, BATCHER_NO_TIMEOUT);
+}
+
+/** [thread-safe] Begin a new transaction on the given shared memory region, giving up if it is not admitted
+ * into an epoch in time, as in 'tm_begin' otherwise. Read-only transactions reading a version or a snapshot never wait.
+ * @param shared     Shared memory region to start a transaction on
+ * @param is_ro      Whether the transaction is read-only
+ * @param timeout_ns Longest time to wait for an epoch (in ns), UINT64_MAX for no limit
+ * @return Opaque transaction ID, 'invalid_tx' on failure, with errno set to ETIMEDOUT if it was not admitted in time
+**/
+tx_t tm_begin_timed(shared_t shared, bool is_ro, uint64_t timeout_ns) {
+    region* reg = (region*) shared;
+    if (unlikely(!is_ro && reg->replica)) return invalid_tx;
+    uint64_t after = reg->config.irrevocable_after;
+    return begin_transaction(reg, is_ro, !is_ro && after > 0 && state_of(reg)->consecutive_aborts >= after, NULL, timeout_ns);
+}
+
+// Shortest backoff window of 'tm_run' (in ns), doubled after each abort up to DV_RUN_BACKOFF_NS
+#define RUN_BACKOFF_MIN_NS 1000
+// Shortest backoff delay of 'tm_run' slept rather than spent yielding (in ns)
+#define RUN_BACKOFF_SLEEP_NS 5000
+
+/**
+ * @brief Waits a random delay before a transaction run by 'tm_run' is admitted again, so that the transactions it
+ * conflicted with are not joined by it again in the next epoch. The delay is drawn below a window that doubles with
+ * each abort, and never exceeds DV_RUN_BACKOFF_NS.
+ * @param aborts Aborts of the transaction so far
+ */
+static void run_backoff(region* reg, uint64_t aborts) {
+    uint64_t bound = reg->config.run_backoff_ns;
+    if (bound == 0)
+        return;
+    uint64_t window = aborts >= 32 ? bound : (uint64_t) RUN_BACKOFF_MIN_NS << (aborts - 1);
+    if (window > bound)
+        window = bound;
+    thread_state* st = state_of(reg);
+    if (st->backoff_seed == 0)
+        st->backoff_seed = ((uint64_t) (uintptr_t) st ^ now_ns()) | 1;
+    st->backoff_seed ^= st->backoff_seed << 13; // xorshift64
+    st->backoff_seed ^= st->backoff_seed >> 7;
+    st->backoff_seed ^= st->backoff_seed << 17;
+    uint64_t delay = st->backoff_seed % (window + 1);
+    if (delay >= RUN_BACKOFF_SLEEP_NS) {
+        struct timespec ts = { .tv_sec = (time_t) (delay / 1000000000), .tv_nsec = (long) (delay % 1000000000) };
+        nanosleep(&ts, NULL);
+        return;
+    }
+    uint64_t deadline = now_ns() + delay;
+    while (now_ns() < deadline)
+        sched_yield();
+}
+
+/** [thread-safe] Run a transaction on the given shared memory region until it commits. The same transaction is kept
+ * across attempts, its logs emptied but not freed, and a read-write one runs irrevocably after DV_RUN_IRREVOCABLE_AFTER aborts.
+ * After each abort, it waits for a random delay, bounded by DV_RUN_BACKOFF_NS, before it is admitted again.
+ * A read-write body returning false while none of its operations failed aborts its attempt.
+ * @param shared Shared memory region to run the transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @param fn     Body of the transaction, returning false as soon as one of its operations fails, true to commit
+ * @param ctx    Argument of the body
+ * @return Whether the transaction committed, false if it could not begin
+**/
+bool tm_run(shared_t shared, bool is_ro, tm_run_fn fn, void* ctx) {
+    return tm_run_ex(shared, is_ro, NULL, fn, ctx);
+}
+
+/** [thread-safe] Run a transaction on the given shared memory region until it commits, with hints on what it does,
+ * as in 'tm_run' otherwise. The hints prepare the transaction as in 'tm_begin_ex', once for all its attempts, and
+ * scale DV_RUN_IRREVOCABLE_AFTER as they scale DV_IRREVOCABLE_AFTER in 'tm_begin_ex'.
+ * @param shared Shared memory region to run the transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @param hints  Hints on the transaction, NULL for none
+ * @param fn     Body of the transaction, returning false as soon as one of its operations fails, true to commit
+ * @param ctx    Argument of the body
+ * @return Whether the transaction committed, false if it could not begin
+**/
+bool tm_run_ex(shared_t shared, bool is_ro, tm_hints const* hints, tm_run_fn fn, void* ctx) {
+    region* reg = (region*) shared;
+    if (unlikely(!is_ro && reg->replica)) return false;
+    uint64_t after = hints != NULL ? irrevocable_threshold(reg->config.run_irrevocable_after, hints) : reg->config.run_irrevocable_after;
+    transaction* tx = NULL;
+    for (uint64_t attempts = 1;; attempts++) {
+        if (tx == NULL) {
+            if (unlikely((tx = new_transaction(reg, is_ro)) == NULL))
+                return false;
+            tx->kept = !is_ro;
+            if (hints != NULL)
+                apply_hints(reg, tx, hints);
+        }
+        if (unlikely(admit_transaction(reg, tx, !is_ro && after > 0 && attempts > after, BATCHER_NO_TIMEOUT, NULL) == invalid_tx))
+            return false;
+        if (fn(shared, (tx_t) tx, ctx)) {
+            stats_add(&reg->stats.runs, 1);
+            stats_add(&reg->stats.run_attempts, attempts);
+            return tm_end(shared, (tx_t) tx);
+        }
+        if (tx->kept && unlikely(tx->live)) // Gave up without a failed operation: aborted here, not admitted twice
+            retire_transaction(reg, tx, false);
+        if (!tx->kept) // Ended with the failed operation
+            tx = NULL;
+        run_backoff(reg, attempts);
+    }
+}
+
+/** [thread-safe] Begin a new transaction on the given private shared memory region, without waiting for its epoch:
+ * the transaction is pending until 'tm_admitted' tells it was admitted, after which it runs as one from 'tm_begin'.
+ * This lets a thread interleave many transactions, each waiting for its epoch, as long as it runs the admitted ones
+ * without waiting for the others: a pending transaction admitted into an epoch holds that epoch open until it ends.
+ * @param shared Shared memory region to start a transaction on, created with 'tm_create' or restored
+ * @param is_ro  Whether the transaction is read-only
+ * @param notify Counter incremented, then woken as with 'tm_wait_admission', each time one of the pending transactions given it is admitted
+ * @return Opaque transaction ID, 'invalid_tx' on failure (including on a region shared with other processes)
+**/
+tx_t tm_begin_async(shared_t shared, bool is_ro, uint32_t* notify) {
+    region* reg = (region*) shared;
+    if (unlikely((!is_ro && reg->replica) || reg->arena != NULL)) return invalid_tx;
+    transaction* tx = new_transaction(reg, is_ro);
+    if (unlikely(tx == NULL)) return invalid_tx;
+    uint64_t after = reg->config.irrevocable_after;
+    return admit_transaction(reg, tx, !is_ro && after > 0 && state_of(reg)->consecutive_aborts >= after, BATCHER_NO_TIMEOUT, (_Atomic(uint32_t)*) notify);
+}
+
+/** [thread-safe] Tell whether a transaction begun with 'tm_begin_async' was admitted into its epoch, and can run.
+ * Once it did, its counter is no longer accessed on its behalf.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction
+ * @return Whether the transaction was admitted
+**/
+bool tm_admitted(shared_t shared, tx_t tx) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (!t->pending)
+        return true;
+    if (!batcher_admitted(reg->batcher, &t->waiter))
+        return false;
+    t->pending = false;
+    enter_epoch(reg, t, t->irrevocable);
+    return true;
+}
+
+/** [thread-safe] Wait until a counter given to 'tm_begin_async' differs from the given value, i.e. until one more pending transaction was admitted.
+ * @param shared Shared memory region of the pending transactions
+ * @param notify Counter
+ * @param seen   Value last returned, 0 at first
+ * @return The value of the counter, to give to the next call
+**/
+uint32_t tm_wait_admission(shared_t shared, uint32_t* notify, uint32_t seen) {
+    return wait_batcher_notify(((region*) shared)->batcher, (_Atomic(uint32_t)*) notify, seen);
+}
+
+/** [thread-safe] Begin a new irrevocable read-write transaction on the given shared memory region.
+ * The transaction waits for an epoch of its own, so none of its operations can fail.
+ * @param shared Shared memory region to start a transaction on
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+**/
+tx_t tm_begin_irrevocable(shared_t shared) {
+    region* reg = (region*) shared;
+    if (unlikely(reg->replica)) return invalid_tx;
+    return begin_transaction(reg, false, true, NULL, BATCHER_NO_TIMEOUT);
+}
+
+/**
+ * @brief Adds the batcher keys of the words of some ranges to a key set.
+ * A range covering more words than there are keys takes every key, a superset of its own.
+ * @param keys Key bitmap to set the keys in
+ * @return Whether every range lies in an allocated segment, aligned
+ */
+static bool footprint_keys(region* reg, tm_range const* ranges, size_t nb_ranges, uint64_t* keys) {
+    for (size_t r = 0; r < nb_ranges; r++) {
+        segment* seg = get_segment(reg->memory, (uintptr_t) ranges[r].address >> SEGMENT_SHIFT);
+        size_t offset = (uintptr_t) ranges[r].address & OFFSET_MASK;
+        size_t size = ranges[r].size;
+        if (unlikely(seg == NULL || offset % reg->align != 0 || size % reg->align != 0 || offset > seg->size || size > seg->size - offset))
+            return false;
+        size_t nb_words = size / reg->align;
+        if (nb_words >= BATCHER_KEYS) {
+            memset(keys, 0xff, BATCHER_KEY_WORDS * sizeof(uint64_t));
+            keys[0] &= ~UINT64_C(1); // Key 0 is the "no key" of dynamic transactions
+            continue;
+        }
+        for (size_t i = 0; i < nb_words; i++) {
+            unsigned int key = conflict_key(seg, offset / reg->align + i);
+            keys[key / 64] |= UINT64_C(1) << (key % 64);
+        }
+    }
+    return true;
+}
+
+/** [thread-safe] Begin a new read-write transaction with a declared footprint, which cannot abort.
+ * The transaction waits for an epoch of static transactions only, none of which writes a word it accesses,
+ * nor accesses a word it writes. Its reads are neither tracked nor validated.
+ * Accessing a word outside of the footprint, or writing a word only declared as read, is undefined.
+ * Declaring a range outside of the allocated segments, or not aligned, fails.
+ * @param shared    Shared memory region to start a transaction on
+ * @param reads     Ranges the transaction only reads (in the shared region)
+ * @param nb_reads  Number of ranges read
+ * @param writes    Ranges the transaction writes, and possibly reads (in the shared region)
+ * @param nb_writes Number of ranges written
  * @return Opaque transaction ID, 'invalid_tx' on failure
 **/
-tx_t tm_begin(shared_t unused(shared), bool unused(is_ro)) {
-    // TODO: tm_begin(shared_t)
-    return invalid_tx;
+tx_t tm_begin_static(shared_t shared, tm_range const* reads, size_t nb_reads, tm_range const* writes, size_t nb_writes) {
+    region* reg = (region*) shared;
+    if (unlikely(reg->replica)) return invalid_tx;
+    transaction* tx = new_transaction(reg, false);
+    if (unlikely(tx == NULL)) return invalid_tx;
+    if (unlikely((tx->keys = (key_set*) arena_calloc(reg->arena, 1, sizeof(key_set))) == NULL)
+        || !footprint_keys(reg, writes, nb_writes, tx->keys->exclusive)
+        || !footprint_keys(reg, reads, nb_reads, tx->keys->shared)) {
+        destroy_transaction(tx);
+        return invalid_tx;
+    }
+    tx->is_static = true;
+    stats_add(&reg->stats.statics, 1);
+    enter_batcher_static(reg->batcher, &tx->waiter, tx->keys);
+    return start_transaction(reg, tx);
 }
 
 /** [thread-safe] End the given transaction.
@@ -470,9 +1654,16 @@ tx_t tm_begin(shared_t unused(shared), bool unused(is_ro)) {
  * @param tx     Transaction to end
  * @return Whether the whole transaction committed
 **/
-bool tm_end(shared_t unused(shared), tx_t unused(tx)) {
-    // TODO: tm_end(shared_t, tx_t)
-    return false;
+bool tm_end(shared_t shared, tx_t tx) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (t->is_ro) {
+        stats_add(&reg->stats.commits, 1);
+        end_read_only(reg, t);
+        return true;
+    }
+    retire_transaction(reg, t, true);
+    return true;
 }
 
 /** [thread-safe] Read operation in the given transaction, source in the shared region and target in a private region.
@@ -483,9 +1674,22 @@ bool tm_end(shared_t unused(shared), tx_t unused(tx)) {
  * @param target Target start address (in a private region)
  * @return Whether the whole transaction can continue
 **/
-bool tm_read(shared_t unused(shared), tx_t unused(tx), void const* unused(source), size_t unused(size), void* unused(target)) {
-    // TODO: tm_read(shared_t, tx_t, void const*, size_t, void*)
-    return false;
+bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    return read_range((region*) shared, (transaction*) tx, source, size, target, false);
+}
+
+/** [thread-safe] Elastic read operation in the given transaction, as for 'tm_read'.
+ * Until the transaction first writes, the words read are not tracked, and only validated pairwise.
+ * Meant for the search phase of linked structure traversals; after a write, this is a plain 'tm_read'.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in a private region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_read_elastic(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    return read_range((region*) shared, (transaction*) tx, source, size, target, true);
 }
 
 /** [thread-safe] Write operation in the given transaction, source in a private region and target in the shared region.
@@ -496,8 +1700,171 @@ bool tm_read(shared_t unused(shared), tx_t unused(tx), void const* unused(source
  * @param target Target start address (in the shared region)
  * @return Whether the whole transaction can continue
 **/
-bool tm_write(shared_t unused(shared), tx_t unused(tx), void const* unused(source), size_t unused(size), void* unused(target)) {
-    // TODO: tm_write(shared_t, tx_t, void const*, size_t, void*)
+bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    return write_range((region*) shared, (transaction*) tx, source, size, target);
+}
+
+/** [thread-safe] Vectored read operation in the given transaction, as for one 'tm_read' per entry, in order.
+ * The words of all the entries are prefetched before the first one is read, so that scattered reads overlap their misses.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param vec    Entries: source in the shared region, length, target in a private region
+ * @param nb     Number of entries
+ * @return Whether the whole transaction can continue
+**/
+bool tm_readv(shared_t shared, tx_t tx, tm_vec const* vec, size_t nb) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    for (size_t i = 0; i < nb; i++) {
+        segment* seg = address_segment(reg->memory, (uintptr_t) vec[i].address);
+        if (seg != NULL)
+            prefetch_word(seg, (uintptr_t) vec[i].address & OFFSET_MASK);
+    }
+    for (size_t i = 0; i < nb; i++) {
+        if (unlikely(!read_range(reg, t, vec[i].address, vec[i].size, vec[i].buffer, false)))
+            return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Vectored write operation in the given transaction, as for one 'tm_write' per entry, in order.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param vec    Entries: target in the shared region, length, source in a private region
+ * @param nb     Number of entries
+ * @return Whether the whole transaction can continue
+**/
+bool tm_writev(shared_t shared, tx_t tx, tm_vec const* vec, size_t nb) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    for (size_t i = 0; i < nb; i++) {
+        segment* seg = address_segment(reg->memory, (uintptr_t) vec[i].address);
+        if (seg != NULL)
+            prefetch_word(seg, (uintptr_t) vec[i].address & OFFSET_MASK);
+    }
+    for (size_t i = 0; i < nb; i++) {
+        if (unlikely(!write_range(reg, t, vec[i].buffer, vec[i].size, vec[i].address)))
+            return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Copy operation in the given transaction, source and target in the shared region.
+ * Each word is read and written in place, without going through a private buffer. The ranges may overlap, as for 'memmove'.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in the shared region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_copy(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (unlikely(!begin_writing(reg, t)))
+        return false;
+    segment* src = get_segment(reg->memory, (uintptr_t) source >> SEGMENT_SHIFT);
+    segment* dst = get_segment(reg->memory, (uintptr_t) target >> SEGMENT_SHIFT);
+    size_t align = reg->align;
+    size_t from = ((uintptr_t) source & OFFSET_MASK) / align;
+    size_t to = ((uintptr_t) target & OFFSET_MASK) / align;
+    size_t nb = size / align;
+    bool backward = src == dst && to > from; // Each source word is then read before the copy overwrites it
+
+    for (size_t k = 0; k < nb; k++) {
+        size_t i = backward ? nb - 1 - k : k;
+        // The source is located before the target is claimed: claiming a word not written yet by the transaction
+        // makes its writable copy the one it reads, which still holds a stale value when the source is the target
+        int readable = track_read(t, src, from + i);
+        if (unlikely(readable < 0)) {
+            t->conflict_key = conflict_key(src, from + i);
+            retire_transaction(reg, t, false);
+            return false;
+        }
+        uint8_t* copy = claim_word(t, dst, to + i);
+        if (unlikely(copy == NULL)) {
+            t->conflict_key = conflict_key(dst, to + i);
+            retire_transaction(reg, t, false);
+            return false;
+        }
+        memmove(copy, src->copies[readable] + (from + i) * align, align);
+    }
+    return true;
+}
+
+/** [thread-safe] Fill operation in the given transaction: every byte of the range is set to the given value.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Target start address (in the shared region)
+ * @param size   Length to fill (in bytes), must be a positive multiple of the alignment
+ * @param byte   Value of each byte
+ * @return Whether the whole transaction can continue
+**/
+bool tm_fill(shared_t shared, tx_t tx, void* target, size_t size, unsigned char byte) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (unlikely(!begin_writing(reg, t)))
+        return false;
+    segment* seg = get_segment(reg->memory, (uintptr_t) target >> SEGMENT_SHIFT);
+    size_t align = reg->align;
+    size_t first = ((uintptr_t) target & OFFSET_MASK) / align;
+    size_t nb = size / align;
+
+    for (size_t i = 0; i < nb; i++) {
+        uint8_t* copy = claim_word(t, seg, first + i);
+        if (unlikely(copy == NULL)) {
+            t->conflict_key = conflict_key(seg, first + i);
+            retire_transaction(reg, t, false);
+            return false;
+        }
+        memset(copy, byte, align);
+    }
+    return true;
+}
+
+/** [thread-safe] Commutative add operation in the given transaction, on a 64-bit integer in the shared region.
+ * Transactions adding to the same word in an epoch do not conflict: their deltas are merged when it ends.
+ * A transaction that also reads or writes the word falls back to a plain read-modify-write, which conflicts as usual.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Address of the integer (in the shared region), aligned on the alignment of the region
+ * @param delta  Value to add, wrapping around on overflow
+ * @return Whether the whole transaction can continue
+**/
+bool tm_add_i64(shared_t shared, tx_t tx, void* target, int64_t delta) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (unlikely(!begin_writing(reg, t)))
+        return false;
+    size_t align = reg->align;
+    if (align < sizeof(int64_t)) { // The integer spans several words
+        uint64_t value;
+        if (!read_range(reg, t, target, sizeof(value), &value, false))
+            return false;
+        value += (uint64_t) delta;
+        return write_range(reg, t, &value, sizeof(value), target);
+    }
+    segment* seg = get_segment(reg->memory, (uintptr_t) target >> SEGMENT_SHIFT);
+    size_t word = ((uintptr_t) target & OFFSET_MASK) / align;
+    int added = t->plain_adds ? 0 : add_word(t, seg, word, delta);
+    if (added == 0) {
+        int readable = track_read(t, seg, word);
+        uint8_t* copy = readable < 0 ? NULL : claim_word(t, seg, word);
+        if (likely(copy != NULL)) {
+            uint8_t const* value = seg->copies[readable] + word * align;
+            if (value != copy)
+                memcpy(copy, value, align);
+            uint64_t sum;
+            memcpy(&sum, copy, sizeof(sum));
+            sum += (uint64_t) delta;
+            memcpy(copy, &sum, sizeof(sum));
+            return true;
+        }
+    } else if (likely(added > 0)) {
+        return true;
+    }
+    t->conflict_key = conflict_key(seg, word);
+    retire_transaction(reg, t, false);
     return false;
 }
 
@@ -508,9 +1875,17 @@ bool tm_write(shared_t unused(shared), tx_t unused(tx), void const* unused(sourc
  * @param target Pointer in private memory receiving the address of the first byte of the newly allocated, aligned segment
  * @return Whether the whole transaction can continue (success/nomem), or not (abort_alloc)
 **/
-alloc_t tm_alloc(shared_t unused(shared), tx_t unused(tx), size_t unused(size), void** unused(target)) {
-    // TODO: tm_alloc(shared_t, tx_t, size_t, void**)
-    return abort_alloc;
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void** target) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (unlikely(!reserve_one(t->arena, (void**) &t->allocs, &t->allocs_capacity, t->nb_allocs, sizeof(int))))
+        return nomem_alloc;
+    int id = allocate_segment(reg->memory, size, reg->align);
+    if (unlikely(id < 0))
+        return nomem_alloc;
+    t->allocs[t->nb_allocs++] = id;
+    *target = segment_address(id, 0);
+    return success_alloc;
 }
 
 /** [thread-safe] Memory freeing in the given transaction.
@@ -519,7 +1894,14 @@ alloc_t tm_alloc(shared_t unused(shared), tx_t unused(tx), size_t unused(size),
  * @param target Address of the first byte of the previously allocated segment to deallocate
  * @return Whether the whole transaction can continue
 **/
-bool tm_free(shared_t unused(shared), tx_t unused(tx), void* unused(target)) {
-    // TODO: tm_free(shared_t, tx_t, void*)
-    return false;
+bool tm_free(shared_t shared, tx_t tx, void* target) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    int id = (int) ((uintptr_t) target >> SEGMENT_SHIFT);
+    if (unlikely(id == reg->start_id || !reserve_one(t->arena, (void**) &t->frees, &t->frees_capacity, t->nb_frees, sizeof(int)))) {
+        retire_transaction(reg, t, false);
+        return false;
+    }
+    t->frees[t->nb_frees++] = id;
+    return true;
 }
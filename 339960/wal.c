@@ -0,0 +1,463 @@
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+
+// External headers
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Internal headers
+#include "config.h"
+#include "macros.h"
+#include "wal.h"
+
+// Minimum size of the reads of a receiver (in bytes)
+#define WAL_RECEIVE_CHUNK 65536
+
+static uint64_t checksum(uint8_t const* data, size_t size) {
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * UINT64_C(0x100000001b3);
+    return hash;
+}
+
+/**
+ * @brief Writes a whole buffer, retrying partial writes.
+ * @return Whether the operation is a success
+ */
+static bool write_all(int fd, uint8_t const* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= (size_t) written;
+    }
+    return true;
+}
+
+/**
+ * @brief Sends a whole buffer to a stream, without being killed if the receiver is gone.
+ * @return Whether the operation is a success
+ */
+static bool send_all(int fd, uint8_t const* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == ENOTSOCK)
+            sent = write(fd, data, size);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += sent;
+        size -= (size_t) sent;
+    }
+    return true;
+}
+
+/**
+ * @brief Sends batches to the replication stream. On failure, the stream is closed, and the log goes on without it.
+ */
+static void stream(wal* log, uint8_t const* data, size_t size) {
+    if (log->stream < 0) return;
+    if (!send_all(log->stream, data, size)) {
+        perror("Failed to send to the replica, no longer replicating");
+        close(log->stream);
+        log->stream = -1;
+        return;
+    }
+    stats_add(&log->stats->replication_bytes, size);
+    stats_add(&log->stats->replication_batches, 1);
+}
+
+/**
+ * @brief Writes and syncs batches. On failure, the log stops being written, and the region goes on without it.
+ */
+static void flush(wal* log, uint8_t const* data, size_t size) {
+    if (log->fd < 0 || size == 0) return;
+    if (!write_all(log->fd, data, size) || fdatasync(log->fd) != 0) {
+        perror("Failed to write the log, no longer logging");
+        close(log->fd);
+        log->fd = -1;
+        return;
+    }
+    stats_add(&log->stats->wal_bytes, size);
+    stats_add(&log->stats->wal_syncs, 1);
+}
+
+/**
+ * @brief Grows a buffer so that it can hold 'extra' more bytes.
+ * @return Whether the operation is a success
+ */
+static bool reserve(uint8_t** buffer, size_t* capacity, size_t size, size_t extra) {
+    if (likely(size + extra <= *capacity)) return true;
+    size_t new_capacity = *capacity == 0 ? 4096 : *capacity;
+    while (new_capacity < size + extra)
+        new_capacity *= 2;
+    uint8_t* grown = (uint8_t*) realloc(*buffer, new_capacity);
+    if (unlikely(grown == NULL)) return false;
+    *buffer = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+/**
+ * @brief Makes at least 'size' unconsumed bytes available in the buffer of a receiver,
+ * moving them to its start and reading as much as the stream holds.
+ * @return Whether the operation is a success, false at the end of the stream
+ */
+static bool fill(wal_receiver* rx, size_t size) {
+    if (rx->end - rx->begin >= size) return true;
+    if (rx->begin > 0) {
+        memmove(rx->buffer, rx->buffer + rx->begin, rx->end - rx->begin);
+        rx->end -= rx->begin;
+        rx->begin = 0;
+    }
+    if (!reserve(&rx->buffer, &rx->capacity, 0, size < WAL_RECEIVE_CHUNK ? WAL_RECEIVE_CHUNK : size))
+        return false;
+    while (rx->end < size) {
+        ssize_t nb = read(rx->fd, rx->buffer + rx->end, rx->capacity - rx->end);
+        if (nb < 0 && errno == EINTR) continue;
+        if (nb <= 0) return false;
+        rx->end += (size_t) nb;
+    }
+    return true;
+}
+
+/**
+ * @brief Background thread of the asynchronous mode: takes all the pending batches at once, and writes them with one sync.
+ */
+static void* writer(void* arg) {
+    wal* log = (wal*) arg;
+    uint8_t* writing = NULL;
+    size_t writing_capacity = 0;
+    pthread_mutex_lock(&log->lock);
+    while (true) {
+        while (log->pending_size == 0 && !log->stop)
+            pthread_cond_wait(&log->cond, &log->lock);
+        if (log->pending_size == 0)
+            break;
+        uint8_t* data = log->pending;
+        size_t size = log->pending_size, capacity = log->pending_capacity;
+        log->pending = writing;
+        log->pending_capacity = writing_capacity;
+        log->pending_size = 0;
+        writing = data;
+        writing_capacity = capacity;
+        pthread_mutex_unlock(&log->lock);
+        flush(log, writing, size);
+        pthread_mutex_lock(&log->lock);
+    }
+    pthread_mutex_unlock(&log->lock);
+    free(writing);
+    return NULL;
+}
+
+/**
+ * @brief Applies the complete batches of a log to a region.
+ * @return Size of the valid part of the log (in bytes), 0 if it could not be applied
+ */
+static size_t replay(uint8_t const* data, size_t size, memory* mem, size_t align) {
+    size_t offset = sizeof(wal_file_header);
+    while (size - offset >= sizeof(wal_batch_header)) {
+        wal_batch_header header;
+        memcpy(&header, data + offset, sizeof(header));
+        uint8_t const* records = data + offset + sizeof(header);
+        if (header.length > size - offset - sizeof(header) || checksum(records, header.length) != header.checksum)
+            break; // Torn by a crash while writing
+        for (size_t at = 0; at < header.length;) {
+            wal_record record;
+            memcpy(&record, records + at, sizeof(record));
+            at += sizeof(record);
+            if (record.kind == WAL_ALLOC) {
+                if (!allocate_segment_at(mem, (int) record.segment, record.arg, align))
+                    return 0;
+            } else if (record.kind == WAL_FREE) {
+                deallocate_segment(mem, (int) record.segment);
+            } else if (record.kind == WAL_WRITE) {
+                segment* seg = get_segment(mem, record.segment);
+                if (seg == NULL || record.arg >= seg->nb_words)
+                    return 0;
+                int readable = (atomic_load_explicit(&seg->controls[record.arg], memory_order_relaxed) & CONTROL_READABLE) ? 1 : 0;
+                memcpy(seg->copies[readable] + record.arg * align, records + at, align);
+                at += align;
+            } else {
+                return 0;
+            }
+        }
+        offset += sizeof(header) + header.length;
+    }
+    return offset;
+}
+
+/**
+ * @brief Reads the log and replays it, then truncates it after its last complete batch, or writes the header of a new log.
+ * @return Whether the operation is a success
+ */
+static bool recover(int fd, memory* mem, size_t size, size_t align) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    wal_file_header expected = { .magic = WAL_MAGIC, .size = size, .align = align };
+    if ((size_t) st.st_size < sizeof(wal_file_header))
+        return ftruncate(fd, 0) == 0 && write_all(fd, (uint8_t const*) &expected, sizeof(expected)) && fdatasync(fd) == 0;
+
+    size_t length = (size_t) st.st_size;
+    uint8_t* data = (uint8_t*) malloc(length);
+    if (data == NULL) return false;
+    size_t done = 0;
+    while (done < length) {
+        ssize_t nb = pread(fd, data + done, length - done, (off_t) done);
+        if (nb <= 0) {
+            if (nb < 0 && errno == EINTR) continue;
+            free(data);
+            return false;
+        }
+        done += (size_t) nb;
+    }
+    if (memcmp(data, &expected, sizeof(expected)) != 0) {
+        fprintf(stderr, "The log belongs to a region of another size or alignment\n");
+        free(data);
+        return false;
+    }
+    size_t valid = replay(data, length, mem, align);
+    free(data);
+    if (valid == 0) {
+        fprintf(stderr, "The log does not match the region it is replayed into\n");
+        return false;
+    }
+    return ftruncate(fd, (off_t) valid) == 0 && lseek(fd, 0, SEEK_END) == (off_t) valid;
+}
+
+wal* open_wal(char const* path, bool async, memory* mem, size_t size, size_t align, stats* st) {
+    wal* log = (wal*) calloc(1, sizeof(wal));
+    if (log == NULL) {
+        fprintf(stderr, "Failed to allocate log\n");
+        return NULL;
+    }
+    log->fd = claim_file(path, "", &log->path);
+    if (log->fd < 0) {
+        free(log);
+        return NULL;
+    }
+    if (!recover(log->fd, mem, size, align)) {
+        fprintf(stderr, "Failed to recover the log '%s'\n", log->path);
+        close(log->fd);
+        free(log->path);
+        free(log);
+        return NULL;
+    }
+    log->stream = -1;
+    log->async = async;
+    log->align = align;
+    log->stats = st;
+    if (async) {
+        if (pthread_mutex_init(&log->lock, NULL) != 0 || pthread_cond_init(&log->cond, NULL) != 0
+            || pthread_create(&log->thread, NULL, writer, log) != 0) {
+            fprintf(stderr, "Failed to start the log writer\n");
+            close(log->fd);
+            free(log->path);
+            free(log);
+            return NULL;
+        }
+    }
+    return log;
+}
+
+wal* open_stream(size_t align, stats* st) {
+    wal* log = (wal*) calloc(1, sizeof(wal));
+    if (log == NULL) {
+        fprintf(stderr, "Failed to allocate log\n");
+        return NULL;
+    }
+    log->fd = -1;
+    log->stream = -1;
+    log->align = align;
+    log->stats = st;
+    return log;
+}
+
+void close_wal(wal* log) {
+    if (log == NULL) return;
+    if (log->async) {
+        pthread_mutex_lock(&log->lock);
+        log->stop = true;
+        pthread_cond_signal(&log->cond);
+        pthread_mutex_unlock(&log->lock);
+        pthread_join(log->thread, NULL);
+        pthread_cond_destroy(&log->cond);
+        pthread_mutex_destroy(&log->lock);
+    }
+    if (log->fd >= 0)
+        close(log->fd);
+    if (log->stream >= 0)
+        close(log->stream);
+    free(log->path);
+    free(log->batch);
+    free(log->pending);
+    free(log);
+}
+
+/**
+ * @brief Stops logging after a batch is lost, so that the log stays a prefix of the epochs.
+ */
+static void fail(wal* log, char const* message) {
+    fprintf(stderr, "%s, no longer logging\n", message);
+    log->failed = true;
+    log->batch_size = 0;
+}
+
+void wal_begin_epoch(wal* log, uint64_t epoch) {
+    log->batch_size = 0;
+    if (unlikely(log->failed)) return;
+    if (unlikely(!reserve(&log->batch, &log->batch_capacity, 0, sizeof(wal_batch_header)))) {
+        fail(log, "Failed to allocate the log batch");
+        return;
+    }
+    wal_batch_header header = { .length = 0, .epoch = epoch, .checksum = 0 };
+    memcpy(log->batch, &header, sizeof(header));
+    log->batch_size = sizeof(header);
+}
+
+/**
+ * @brief Appends a record and its data to the batch.
+ */
+static void append(wal* log, wal_record record, void const* data, size_t size) {
+    if (unlikely(log->batch_size == 0)) return;
+    if (unlikely(!reserve(&log->batch, &log->batch_capacity, log->batch_size, sizeof(record) + size))) {
+        fail(log, "Failed to grow the log batch");
+        return;
+    }
+    memcpy(log->batch + log->batch_size, &record, sizeof(record));
+    if (size > 0)
+        memcpy(log->batch + log->batch_size + sizeof(record), data, size);
+    log->batch_size += sizeof(record) + size;
+}
+
+void wal_log_alloc(wal* log, segment* seg) {
+    append(log, (wal_record) { .kind = WAL_ALLOC, .segment = (uint32_t) seg->id, .arg = seg->size }, NULL, 0);
+}
+
+void wal_log_write(wal* log, segment* seg, size_t word, void const* value) {
+    append(log, (wal_record) { .kind = WAL_WRITE, .segment = (uint32_t) seg->id, .arg = word }, value, log->align);
+}
+
+void wal_log_free(wal* log, int id) {
+    append(log, (wal_record) { .kind = WAL_FREE, .segment = (uint32_t) id, .arg = 0 }, NULL, 0);
+}
+
+/**
+ * @brief Fills the header of the batch built so far.
+ */
+static void seal(wal* log) {
+    wal_batch_header* header = (wal_batch_header*) log->batch;
+    header->length = log->batch_size - sizeof(wal_batch_header);
+    header->checksum = checksum(log->batch + sizeof(wal_batch_header), header->length);
+}
+
+/**
+ * @brief The state is sent as a batch allocating every segment but the first, and writing every non-zero word.
+ */
+bool wal_add_stream(wal* log, int fd, memory* mem, int start_id, size_t size, uint64_t epoch) {
+    if (log->stream >= 0 || log->failed) return false;
+    wal_file_header file_header = { .magic = WAL_MAGIC, .size = size, .align = log->align };
+    wal_begin_epoch(log, epoch);
+    for (int id = 1; id < mem->next_free_id; id++) {
+        segment* seg = get_segment(mem, id);
+        if (seg == NULL) continue;
+        if (id != start_id)
+            wal_log_alloc(log, seg);
+        for (size_t w = 0; w < seg->nb_words; w++) {
+            int readable = (atomic_load_explicit(&seg->controls[w], memory_order_relaxed) & CONTROL_READABLE) ? 1 : 0;
+            uint8_t const* value = seg->copies[readable] + w * seg->align;
+            size_t i = 0;
+            while (i < seg->align && value[i] == 0)
+                i++;
+            if (i < seg->align)
+                wal_log_write(log, seg, w, value);
+        }
+    }
+    if (log->failed) return false;
+    seal(log);
+    bool success = send_all(fd, (uint8_t const*) &file_header, sizeof(file_header)) && send_all(fd, log->batch, log->batch_size);
+    if (!success) {
+        perror("Failed to send the region to the replica");
+        return false;
+    }
+    stats_add(&log->stats->replication_bytes, sizeof(file_header) + log->batch_size);
+    stats_add(&log->stats->replication_batches, 1);
+    log->batch_size = 0;
+    log->stream = fd;
+    return true;
+}
+
+bool open_receiver(wal_receiver* rx, int fd, size_t* size, size_t* align) {
+    *rx = (wal_receiver) { .fd = fd, .buffer = NULL, .begin = 0, .end = 0, .capacity = 0 };
+    wal_file_header header;
+    if (!fill(rx, sizeof(header))) return false;
+    memcpy(&header, rx->buffer, sizeof(header));
+    rx->begin = sizeof(header);
+    if (header.magic != WAL_MAGIC) return false;
+    *size = header.size;
+    *align = header.align;
+    return true;
+}
+
+void close_receiver(wal_receiver* rx) {
+    close(rx->fd);
+    free(rx->buffer);
+}
+
+bool wal_receive(wal_receiver* rx, wal_batch_header* header, uint8_t const** records) {
+    if (!fill(rx, sizeof(*header))) return false;
+    memcpy(header, rx->buffer + rx->begin, sizeof(*header));
+    if (!fill(rx, sizeof(*header) + header->length)) return false;
+    *records = rx->buffer + rx->begin + sizeof(*header);
+    rx->begin += sizeof(*header) + header->length;
+    if (checksum(*records, header->length) != header->checksum) {
+        fprintf(stderr, "Corrupt batch received from the primary\n");
+        return false;
+    }
+    return true;
+}
+
+bool wal_receive_ready(wal_receiver* rx) {
+    if (rx->end > rx->begin) return true;
+    struct pollfd pfd = { .fd = rx->fd, .events = POLLIN, .revents = 0 };
+    return poll(&pfd, 1, 0) > 0;
+}
+
+void wal_end_epoch(wal* log) {
+    if (log->batch_size <= sizeof(wal_batch_header)) return;
+    seal(log);
+    stream(log, log->batch, log->batch_size);
+    if (!log->async) {
+        flush(log, log->batch, log->batch_size);
+        return;
+    }
+    pthread_mutex_lock(&log->lock);
+    if (log->pending_size == 0) { // Hands the batch over, and builds the next one in the buffer the thread gave back
+        uint8_t* batch = log->batch;
+        size_t capacity = log->batch_capacity;
+        log->batch = log->pending;
+        log->batch_capacity = log->pending_capacity;
+        log->pending = batch;
+        log->pending_capacity = capacity;
+        log->pending_size = log->batch_size;
+    } else if (reserve(&log->pending, &log->pending_capacity, log->pending_size, log->batch_size)) {
+        memcpy(log->pending + log->pending_size, log->batch, log->batch_size);
+        log->pending_size += log->batch_size;
+    } else {
+        fail(log, "Failed to queue the log batch");
+    }
+    pthread_cond_signal(&log->cond);
+    pthread_mutex_unlock(&log->lock);
+}
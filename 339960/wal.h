@@ -0,0 +1,171 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memory.h"
+#include "stats.h"
+
+/* LOG FORMAT */
+
+// The file starts with a header, followed by one batch per epoch that committed something.
+// A batch is a header followed by records, each followed by a word of data for writes.
+// Replay stops at the first incomplete batch or wrong checksum, i.e. at the last complete sync.
+
+#define WAL_MAGIC UINT64_C(0x64762d77616c3031)
+
+typedef struct wal_file_header {
+    uint64_t magic;
+    uint64_t size;                      // Size of the first segment of the region
+    uint64_t align;                     // Size of a word
+} wal_file_header;
+
+typedef struct wal_batch_header {
+    uint64_t length;                    // Size of the records (in bytes)
+    uint64_t epoch;
+    uint64_t checksum;                  // Of the records
+} wal_batch_header;
+
+enum wal_kind { WAL_ALLOC = 1, WAL_WRITE = 2, WAL_FREE = 3 };
+
+typedef struct wal_record {
+    uint32_t kind;
+    uint32_t segment;                   // Segment id
+    uint64_t arg;                       // Size of an allocated segment, index of a written word
+} wal_record;
+
+/**
+ * @brief Redo log of a region: the effects of the transactions committed in an epoch are
+ * appended in one write, and synced to disk before the next epoch starts. In asynchronous
+ * mode, batches are handed to a background thread that writes and syncs them instead, so a
+ * crash can lose the last epochs, but never leaves the region in the middle of one.
+ * The batches can also be sent to a replication stream, right at the end of each epoch.
+ */
+typedef struct wal {
+    int fd;                             // -1 if the log only feeds a stream, or once writing failed
+    char* path;                         // File of the log claimed by the region, NULL if the log only feeds a stream
+    int stream;                         // Replication stream, -1 if none or once sending failed
+    bool async;
+    size_t align;
+    stats* stats;
+    uint8_t* batch;                     // Batch of the epoch being ended
+    size_t batch_size;
+    size_t batch_capacity;
+    bool failed;                        // A batch could not be logged: no later one is, so that the log stays a prefix of the epochs
+    pthread_t thread;                   // Asynchronous mode only: writes the pending batches
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t* pending;                   // Batches handed to the thread
+    size_t pending_size;
+    size_t pending_capacity;
+    bool stop;
+} wal;
+
+/** Open the log of a region, creating it if it does not exist, and replay it into the region.
+ * The log is the first of the family of 'path' that no other region holds (see 'claim_file').
+ * @param path  Path of the log
+ * @param async Whether to write and sync the log on a background thread
+ * @param mem   Segment table of the region, holding only its first segment
+ * @param size  Size of the first segment (in bytes)
+ * @param align Size of a word (in bytes)
+ * @param st    Counters of the region
+ * @return The log, NULL on failure (including if it belongs to a region of another size or alignment)
+**/
+wal* open_wal(char const* path, bool async, memory* mem, size_t size, size_t align, stats* st);
+
+/** Create a log with no file, whose batches only go to the stream added with 'wal_add_stream'.
+ * @param align Size of a word (in bytes)
+ * @param st    Counters of the region
+ * @return The log, NULL on failure
+**/
+wal* open_stream(size_t align, stats* st);
+
+/** Start sending the batches of a log to a replication stream, after a header and a batch holding
+ * the current content of the region. Must be called while no epoch can end. The stream is written
+ * at the end of each epoch, which waits while the receiver lags behind by more than the stream buffers.
+ * @param log      Log, with no stream yet
+ * @param fd       Stream (socket or pipe), closed with the log
+ * @param mem      Segment table of the region
+ * @param start_id Id of the first segment, which the receiver already has
+ * @param size     Size of the first segment (in bytes)
+ * @param epoch    Current epoch number
+ * @return Whether the operation is a success
+**/
+bool wal_add_stream(wal* log, int fd, memory* mem, int start_id, size_t size, uint64_t epoch);
+
+/**
+ * @brief Receiving end of a replication stream, read in large chunks rather than batch by batch.
+ */
+typedef struct wal_receiver {
+    int fd;
+    uint8_t* buffer;
+    size_t begin;                       // Received bytes not consumed yet, from 'begin' to 'end'
+    size_t end;
+    size_t capacity;
+} wal_receiver;
+
+/** Start receiving a replication stream, from its header.
+ * @param rx    Receiver to initialize
+ * @param fd    Stream
+ * @param size  Receives the size of the first segment
+ * @param align Receives the size of a word
+ * @return Whether the header is valid
+**/
+bool open_receiver(wal_receiver* rx, int fd, size_t* size, size_t* align);
+
+/** Free the buffer of a receiver, and close its stream.
+ * @param rx Receiver
+**/
+void close_receiver(wal_receiver* rx);
+
+/** Receive a batch from a replication stream, and check it.
+ * @param rx      Receiver
+ * @param header  Receives the header of the batch
+ * @param records Receives the records, valid until the next call
+ * @return Whether a valid batch was received, false at the end of the stream
+**/
+bool wal_receive(wal_receiver* rx, wal_batch_header* header, uint8_t const** records);
+
+/** Tell whether a batch can be received without waiting for the sender.
+ * @param rx Receiver
+ * @return Whether part of a batch is already there
+**/
+bool wal_receive_ready(wal_receiver* rx);
+
+/** Write the pending batches, then close the log.
+ * @param log Log, or NULL
+**/
+void close_wal(wal* log);
+
+/** Start the batch of an epoch. Must be called while no transaction is running, like the next ones.
+ * @param log   Log
+ * @param epoch Epoch number
+**/
+void wal_begin_epoch(wal* log, uint64_t epoch);
+
+/** Append a segment allocated by a committed transaction.
+ * @param log Log
+ * @param seg Segment
+**/
+void wal_log_alloc(wal* log, segment* seg);
+
+/** Append a word written by a committed transaction.
+ * @param log   Log
+ * @param seg   Segment
+ * @param word  Index of the word
+ * @param value New value of the word
+**/
+void wal_log_write(wal* log, segment* seg, size_t word, void const* value);
+
+/** Append a segment freed by a committed transaction.
+ * @param log Log
+ * @param id  Segment id
+**/
+void wal_log_free(wal* log, int id);
+
+/** End the batch of an epoch: write and sync it, or hand it to the background thread. An empty batch is dropped.
+ * @param log Log
+**/
+void wal_end_epoch(wal* log);
@@ -0,0 +1,555 @@
+/**
+ * @file   tm.c
+ * @author [...]
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Encounter-time locking transaction manager: a global version clock and a table
+ * of ownership records striped over the words. Writes lock their record when they
+ * happen and update memory in place, keeping the old values in an undo log that is
+ * only replayed on abort. Reads are invisible, and extend the read version of the
+ * transaction when they meet a newer record instead of aborting.
+**/
+
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+#ifdef __STDC_NO_ATOMICS__
+    #error Current C11 compiler does not support atomic operations
+#endif
+
+// External headers
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Internal headers
+#include <tm.h>
+#include "macros.h"
+
+// Size of a cache line (in bytes), to keep each record and clock on its own line
+#define CACHE_LINE    64
+// Number of ownership records (power of 2), the words of the region are striped over them
+#define LOCK_STRIPES  (1 << 16)
+// Number of transactions that can run at the same time (more wait for a slot)
+#define READER_SLOTS  256
+// Value of an unused reader slot
+#define SLOT_IDLE     UINT64_MAX
+
+/**
+ * @brief Ownership record: 'version << 1' when free, 'owner | 1' when locked by a transaction that wrote one of its words.
+ */
+typedef struct orec {
+    _Atomic(uint64_t) word;
+} __attribute__((aligned(CACHE_LINE))) orec;
+
+/**
+ * @brief Read version of a running transaction when it started, so that freed segments are only released once no transaction can still read them.
+ */
+typedef struct reader_slot {
+    _Atomic(uint64_t) rv;
+} __attribute__((aligned(CACHE_LINE))) reader_slot;
+
+/**
+ * @brief Header of a segment allocated by 'tm_alloc', followed by its words.
+ */
+typedef struct segment {
+    struct segment* prev;
+    struct segment* next;
+    uint64_t freed_at;                  // Commit version of the transaction that freed it, once in limbo
+} segment;
+
+/**
+ * @brief Shared memory region.
+ */
+typedef struct region {
+    _Atomic(uint64_t) clock __attribute__((aligned(CACHE_LINE))); // Global version clock
+    orec orecs[LOCK_STRIPES];
+    reader_slot slots[READER_SLOTS];
+    pthread_mutex_t segments_lock;      // Protects the two lists below
+    segment* segments;                  // Allocated segments
+    segment* limbo;                     // Segments freed by committed transactions, not released yet
+    void* start;
+    size_t size;
+    size_t align;
+    size_t segment_align;               // Alignment of the segments, at least that of a pointer
+    size_t header;                      // Size of a segment header, rounded up to the segment alignment
+} region;
+
+/**
+ * @brief Ownership record read, with the version it had.
+ */
+typedef struct read_entry {
+    orec* rec;
+    uint64_t version;
+} read_entry;
+
+/**
+ * @brief Transaction descriptor. The opaque 'tx_t' is the address of this structure.
+ */
+typedef struct transaction {
+    bool is_ro;
+    uint64_t rv;                        // Read version, extended as the transaction meets newer records
+    int slot;                           // Reader slot
+
+    read_entry* reads;
+    size_t nb_reads;
+    size_t reads_capacity;
+
+    orec** locks;                       // Records locked by the transaction
+    size_t nb_locks;
+    size_t locks_capacity;
+
+    void** undo;                        // Words written in place, in order
+    uint8_t* undo_values;               // Value of each word before the write, 'align' bytes each
+    size_t nb_undo;
+    size_t undo_capacity;
+
+    segment** allocs;                   // Segments allocated (released if aborted)
+    size_t nb_allocs;
+    size_t allocs_capacity;
+    segment** frees;                    // Segments to free if committed
+    size_t nb_frees;
+    size_t frees_capacity;
+} transaction;
+
+// Reader slot last taken by the calling thread, tried first
+static _Thread_local unsigned int slot_hint = 0;
+
+/* HELPERS */
+
+/**
+ * @brief Grows a dynamic array so that it can hold at least one more element.
+ * @return Whether the operation is a success
+ */
+static bool reserve_one(void** array, size_t* capacity, size_t count, size_t elem_size) {
+    if (likely(count < *capacity)) return true;
+    size_t new_capacity = *capacity == 0 ? 16 : 2 * *capacity;
+    void* new_array = realloc(*array, new_capacity * elem_size);
+    if (unlikely(new_array == NULL)) return false;
+    *array = new_array;
+    *capacity = new_capacity;
+    return true;
+}
+
+static inline orec* orec_of(region* reg, void const* addr) {
+    uintptr_t hash = ((uintptr_t) addr / reg->align) * UINT64_C(0x9E3779B97F4A7C15) >> 16;
+    return &reg->orecs[hash & (LOCK_STRIPES - 1)];
+}
+
+static inline uint64_t owner_tag(transaction* tx) {
+    return (uint64_t) (uintptr_t) tx | 1;
+}
+
+/**
+ * @brief Checks that every record read still has the version it was read at. Records locked
+ * by the transaction itself are skipped: they were only locked at a version no newer than its read version.
+ * @return Whether the reads are still consistent
+ */
+static bool validate(transaction* tx) {
+    uint64_t tag = owner_tag(tx);
+    for (size_t i = 0; i < tx->nb_reads; i++) {
+        uint64_t word = atomic_load_explicit(&tx->reads[i].rec->word, memory_order_acquire);
+        if (word != tag && word != tx->reads[i].version << 1)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Moves the read version of the transaction to the current clock, if its reads are still consistent.
+ * @return Whether the transaction can continue
+ */
+static bool extend(region* reg, transaction* tx) {
+    uint64_t now = atomic_load(&reg->clock);
+    if (!validate(tx))
+        return false;
+    tx->rv = now;
+    return true;
+}
+
+/* SEGMENTS */
+
+static void link_segment(segment** list, segment* seg) {
+    seg->prev = NULL;
+    seg->next = *list;
+    if (seg->next != NULL) seg->next->prev = seg;
+    *list = seg;
+}
+
+static void unlink_segment(segment** list, segment* seg) {
+    if (seg->prev != NULL) seg->prev->next = seg->next;
+    else *list = seg->next;
+    if (seg->next != NULL) seg->next->prev = seg->prev;
+}
+
+/**
+ * @brief Releases the segments in limbo that no running transaction can read anymore. Must be called with the segments lock held.
+ *
+ * A transaction that started with a read version at least the commit version of a
+ * free started after the segment was unlinked, hence cannot reach it.
+ */
+static void reclaim_limbo(region* reg) {
+    uint64_t oldest = SLOT_IDLE;
+    for (int s = 0; s < READER_SLOTS; s++) {
+        uint64_t rv = atomic_load(&reg->slots[s].rv);
+        if (rv < oldest) oldest = rv;
+    }
+    segment* seg = reg->limbo;
+    while (seg != NULL) {
+        segment* next = seg->next;
+        if (seg->freed_at <= oldest) {
+            unlink_segment(&reg->limbo, seg);
+            free(seg);
+        }
+        seg = next;
+    }
+}
+
+/* TRANSACTIONS */
+
+static void destroy_transaction(region* reg, transaction* tx) {
+    atomic_store_explicit(&reg->slots[tx->slot].rv, SLOT_IDLE, memory_order_release);
+    free(tx->reads);
+    free(tx->locks);
+    free(tx->undo);
+    free(tx->undo_values);
+    free(tx->allocs);
+    free(tx->frees);
+    free(tx);
+}
+
+/**
+ * @brief Releases the records locked by the transaction with a given version.
+ */
+static void release_locks(transaction* tx, uint64_t version) {
+    for (size_t i = 0; i < tx->nb_locks; i++)
+        atomic_store_explicit(&tx->locks[i]->word, version << 1, memory_order_release);
+}
+
+/**
+ * @brief Aborts a transaction: rolls back its in-place writes, releases its records and the segments it allocated.
+ * @return false, for the caller to return
+ */
+static bool abort_transaction(region* reg, transaction* tx) {
+    for (size_t i = tx->nb_undo; i-- > 0; )
+        memcpy(tx->undo[i], tx->undo_values + i * reg->align, reg->align);
+    if (tx->nb_locks > 0) {
+        // A new version, so that a reader that saw a rolled back value cannot find its record unchanged
+        release_locks(tx, atomic_fetch_add(&reg->clock, 1) + 1);
+    }
+    if (tx->nb_allocs > 0) {
+        pthread_mutex_lock(&reg->segments_lock);
+        for (size_t i = 0; i < tx->nb_allocs; i++) {
+            unlink_segment(&reg->segments, tx->allocs[i]);
+            free(tx->allocs[i]);
+        }
+        pthread_mutex_unlock(&reg->segments_lock);
+    }
+    destroy_transaction(reg, tx);
+    return false;
+}
+
+/**
+ * @brief Reads one word, consistent with the read version of the transaction, which is extended if needed.
+ * @return Whether the transaction can continue
+ */
+static bool read_word(region* reg, transaction* tx, void const* addr, void* target) {
+    orec* rec = orec_of(reg, addr);
+    uint64_t tag = owner_tag(tx);
+    if (unlikely(!reserve_one((void**) &tx->reads, &tx->reads_capacity, tx->nb_reads, sizeof(read_entry))))
+        return false;
+    while (true) {
+        uint64_t before = atomic_load_explicit(&rec->word, memory_order_acquire);
+        if (before == tag) { // Written in place by this transaction
+            memcpy(target, addr, reg->align);
+            return true;
+        }
+        if (before & 1)
+            return false;
+        memcpy(target, addr, reg->align);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&rec->word, memory_order_relaxed) != before)
+            continue;
+        if ((before >> 1) > tx->rv) {
+            if (!extend(reg, tx))
+                return false;
+            continue; // Read again, as of the new read version
+        }
+        tx->reads[tx->nb_reads++] = (read_entry) { .rec = rec, .version = before >> 1 };
+        return true;
+    }
+}
+
+/**
+ * @brief Writes one word in place, locking its record first and logging its old value.
+ * @return Whether the transaction can continue
+ */
+static bool write_word(region* reg, transaction* tx, void const* source, void* addr) {
+    orec* rec = orec_of(reg, addr);
+    uint64_t tag = owner_tag(tx);
+    size_t capacity = tx->undo_capacity;
+    if (unlikely(!reserve_one((void**) &tx->undo, &tx->undo_capacity, tx->nb_undo, sizeof(void*))))
+        return false;
+    if (tx->undo_capacity != capacity) {
+        uint8_t* values = (uint8_t*) realloc(tx->undo_values, tx->undo_capacity * reg->align);
+        if (unlikely(values == NULL)) return false;
+        tx->undo_values = values;
+    }
+
+    uint64_t word = atomic_load_explicit(&rec->word, memory_order_relaxed);
+    if (word != tag) {
+        if (unlikely(!reserve_one((void**) &tx->locks, &tx->locks_capacity, tx->nb_locks, sizeof(orec*))))
+            return false;
+        while (true) {
+            if (word & 1)
+                return false;
+            // Lock at a version no newer than the read version, so that an earlier read of the stripe stays valid
+            if ((word >> 1) > tx->rv) {
+                if (!extend(reg, tx))
+                    return false;
+                word = atomic_load_explicit(&rec->word, memory_order_relaxed);
+                continue;
+            }
+            if (atomic_compare_exchange_weak_explicit(&rec->word, &word, tag, memory_order_acquire, memory_order_relaxed))
+                break;
+        }
+        atomic_thread_fence(memory_order_release); // Record locked before the word is modified
+        tx->locks[tx->nb_locks++] = rec;
+    }
+
+    tx->undo[tx->nb_undo] = addr;
+    memcpy(tx->undo_values + tx->nb_undo * reg->align, addr, reg->align);
+    tx->nb_undo++;
+    memcpy(addr, source, reg->align);
+    return true;
+}
+
+/**
+ * @brief Commits a transaction that wrote or freed: validates the reads and releases the records. The writes are already in place.
+ * @return Whether the transaction committed
+ */
+static bool commit(region* reg, transaction* tx) {
+    uint64_t wv = atomic_fetch_add(&reg->clock, 1) + 1;
+    if (wv != tx->rv + 1 && !validate(tx)) // Otherwise, no transaction committed since the last read version
+        return abort_transaction(reg, tx);
+    release_locks(tx, wv);
+
+    if (tx->nb_frees > 0) {
+        pthread_mutex_lock(&reg->segments_lock);
+        for (size_t i = 0; i < tx->nb_frees; i++) {
+            segment* seg = tx->frees[i];
+            unlink_segment(&reg->segments, seg);
+            seg->freed_at = wv;
+            link_segment(&reg->limbo, seg);
+        }
+        reclaim_limbo(reg);
+        pthread_mutex_unlock(&reg->segments_lock);
+    }
+    return true;
+}
+
+/* STM PART */
+
+/** Create (i.e. allocate + init) a new shared memory region, with one first non-free-able allocated segment of the requested size and alignment.
+ * @param size  Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
+ * @param align Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_create(size_t size, size_t align) {
+    if (size == 0 || align == 0 || (align & (align - 1)) != 0 || size % align != 0) return invalid_shared;
+
+    region* reg;
+    if (unlikely(posix_memalign((void**) &reg, CACHE_LINE, sizeof(region)) != 0)) return invalid_shared;
+    size_t start_align = align < sizeof(void*) ? sizeof(void*) : align;
+    if (unlikely(posix_memalign(&reg->start, start_align, size) != 0)) {
+        free(reg);
+        return invalid_shared;
+    }
+    if (unlikely(pthread_mutex_init(&reg->segments_lock, NULL) != 0)) {
+        free(reg->start);
+        free(reg);
+        return invalid_shared;
+    }
+    memset(reg->start, 0, size);
+    atomic_init(&reg->clock, 0);
+    for (size_t i = 0; i < LOCK_STRIPES; i++)
+        atomic_init(&reg->orecs[i].word, 0);
+    for (size_t i = 0; i < READER_SLOTS; i++)
+        atomic_init(&reg->slots[i].rv, SLOT_IDLE);
+    reg->segments = NULL;
+    reg->limbo = NULL;
+    reg->size = size;
+    reg->align = align;
+    reg->segment_align = start_align;
+    reg->header = (sizeof(segment) + start_align - 1) / start_align * start_align;
+    return reg;
+}
+
+/** Destroy (i.e. clean-up + free) a given shared memory region.
+ * @param shared Shared memory region to destroy, with no running transaction
+**/
+void tm_destroy(shared_t shared) {
+    region* reg = (region*) shared;
+    segment* lists[] = { reg->segments, reg->limbo };
+    for (size_t l = 0; l < sizeof(lists) / sizeof(lists[0]); l++) {
+        while (lists[l] != NULL) {
+            segment* next = lists[l]->next;
+            free(lists[l]);
+            lists[l] = next;
+        }
+    }
+    pthread_mutex_destroy(&reg->segments_lock);
+    free(reg->start);
+    free(reg);
+}
+
+/** [thread-safe] Return the start address of the first allocated segment in the shared memory region.
+ * @param shared Shared memory region to query
+ * @return Start address of the first allocated segment
+**/
+void* tm_start(shared_t shared) {
+    return ((region*) shared)->start;
+}
+
+/** [thread-safe] Return the size (in bytes) of the first allocated segment of the shared memory region.
+ * @param shared Shared memory region to query
+ * @return First allocated segment size
+**/
+size_t tm_size(shared_t shared) {
+    return ((region*) shared)->size;
+}
+
+/** [thread-safe] Return the alignment (in bytes) of the memory accesses on the given shared memory region.
+ * @param shared Shared memory region to query
+ * @return Alignment used globally
+**/
+size_t tm_align(shared_t shared) {
+    return ((region*) shared)->align;
+}
+
+/** [thread-safe] Begin a new transaction on the given shared memory region.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+**/
+tx_t tm_begin(shared_t shared, bool is_ro) {
+    region* reg = (region*) shared;
+    transaction* tx = (transaction*) calloc(1, sizeof(transaction));
+    if (unlikely(tx == NULL)) return invalid_tx;
+    tx->is_ro = is_ro;
+
+    // Publish a placeholder before reading the clock, so that a concurrent reclamation cannot miss this transaction
+    for (unsigned int s = slot_hint; ; s = (s + 1) % READER_SLOTS) {
+        uint64_t idle = SLOT_IDLE;
+        if (atomic_compare_exchange_weak(&reg->slots[s].rv, &idle, 0)) {
+            tx->slot = (int) s;
+            slot_hint = s;
+            break;
+        }
+    }
+    tx->rv = atomic_load(&reg->clock);
+    atomic_store(&reg->slots[tx->slot].rv, tx->rv);
+    return (tx_t) tx;
+}
+
+/** [thread-safe] End the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to end
+ * @return Whether the whole transaction committed
+**/
+bool tm_end(shared_t shared, tx_t tx) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (t->nb_locks > 0 || t->nb_frees > 0) {
+        if (!commit(reg, t))
+            return false;
+    }
+    destroy_transaction(reg, t);
+    return true;
+}
+
+/** [thread-safe] Read operation in the given transaction, source in the shared region and target in a private region.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in a private region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    for (size_t offset = 0; offset < size; offset += reg->align) {
+        if (unlikely(!read_word(reg, t, (uint8_t const*) source + offset, (uint8_t*) target + offset)))
+            return abort_transaction(reg, t);
+    }
+    return true;
+}
+
+/** [thread-safe] Write operation in the given transaction, source in a private region and target in the shared region.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in a private region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in the shared region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (unlikely(t->is_ro))
+        return abort_transaction(reg, t);
+    for (size_t offset = 0; offset < size; offset += reg->align) {
+        if (unlikely(!write_word(reg, t, (uint8_t const*) source + offset, (uint8_t*) target + offset)))
+            return abort_transaction(reg, t);
+    }
+    return true;
+}
+
+/** [thread-safe] Memory allocation in the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param size   Allocation requested size (in bytes), must be a positive multiple of the alignment
+ * @param target Pointer in private memory receiving the address of the first byte of the newly allocated, aligned segment
+ * @return Whether the whole transaction can continue (success/nomem), or not (abort_alloc)
+**/
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void** target) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (unlikely(!reserve_one((void**) &t->allocs, &t->allocs_capacity, t->nb_allocs, sizeof(segment*))))
+        return nomem_alloc;
+    segment* seg;
+    if (unlikely(posix_memalign((void**) &seg, reg->segment_align, reg->header + size) != 0))
+        return nomem_alloc;
+    memset((uint8_t*) seg + reg->header, 0, size);
+    pthread_mutex_lock(&reg->segments_lock);
+    link_segment(&reg->segments, seg);
+    pthread_mutex_unlock(&reg->segments_lock);
+    t->allocs[t->nb_allocs++] = seg;
+    *target = (uint8_t*) seg + reg->header;
+    return success_alloc;
+}
+
+/** [thread-safe] Memory freeing in the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Address of the first byte of the previously allocated segment to deallocate
+ * @return Whether the whole transaction can continue
+**/
+bool tm_free(shared_t shared, tx_t tx, void* target) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (unlikely(target == reg->start || !reserve_one((void**) &t->frees, &t->frees_capacity, t->nb_frees, sizeof(segment*))))
+        return abort_transaction(reg, t);
+    t->frees[t->nb_frees++] = (segment*) ((uint8_t*) target - reg->header);
+    return true;
+}
@@ -257,8 +257,27 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
 int main(int argc, char** argv) {
     try {
         // Parse command line option(s)
-        if (argc < 3) {
-            ::std::cout << "Usage: " << (argc > 0 ? argv[0] : "grading") << " <seed> <reference library path> <tested library path>..." << ::std::endl;
+        auto nbregions   = 1ul;   // Number of shared memory regions, each with its own group of workers
+        auto commutative = false; // Whether transfers credit the receiver with a commutative add
+        auto batched     = false; // Whether transfers read then write both balances with one vectored operation each
+        auto coroutines  = 1ul;   // Number of logical request streams each worker interleaves
+        auto argfirst    = 1;
+        for (; argfirst < argc && ::std::strncmp(argv[argfirst], "--", 2) == 0; ++argfirst) {
+            if (::std::strncmp(argv[argfirst], "--regions=", 10) == 0) {
+                nbregions = ::std::stoul(argv[argfirst] + 10);
+            } else if (::std::strcmp(argv[argfirst], "--commutative") == 0) {
+                commutative = true;
+            } else if (::std::strcmp(argv[argfirst], "--batched") == 0) {
+                batched = true;
+            } else if (::std::strncmp(argv[argfirst], "--coroutines=", 13) == 0) {
+                coroutines = ::std::max(::std::stoul(argv[argfirst] + 13), 1ul);
+            } else {
+                nbregions = 0; // Unknown option: print the usage
+                break;
+            }
+        }
+        if (argc < argfirst + 2 || nbregions == 0) {
+            ::std::cout << "Usage: " << (argc > 0 ? argv[0] : "grading") << " [--regions=<count>] [--commutative] [--batched] [--coroutines=<count>] <seed> <reference library path> <tested library path>..." << ::std::endl;
             return 1;
         }
         // Get/set/compute run parameters
@@ -275,18 +294,28 @@ int main(int argc, char** argv) {
         auto const prob_long     = 0.5f;
         auto const prob_alloc    = 0.01f;
         auto const nbrepeats     = 7;
-        auto const seed          = static_cast<Seed>(::std::stoul(argv[1]));
+        auto const seed          = static_cast<Seed>(::std::stoul(argv[argfirst]));
         auto const clk_res       = Chrono::get_resolution();
         auto const slow_factor   = 16ul;
         // Print run parameters
         ::std::cout << "⎧ #worker threads:     " << nbworkers << ::std::endl;
         ::std::cout << "⎪ #TX per worker:      " << nbtxperwrk << ::std::endl;
+        if (nbregions > 1) {
+            nbregions = ::std::min(nbregions, nbworkers);
+            ::std::cout << "⎪ #regions:            " << nbregions << ::std::endl;
+        }
         ::std::cout << "⎪ #repetitions:        " << nbrepeats << ::std::endl;
         ::std::cout << "⎪ Initial #accounts:   " << nbaccounts << ::std::endl;
         ::std::cout << "⎪ Expected #accounts:  " << expnbaccounts << ::std::endl;
         ::std::cout << "⎪ Initial balance:     " << init_balance << ::std::endl;
         ::std::cout << "⎪ Long TX probability: " << prob_long << ::std::endl;
         ::std::cout << "⎪ Allocation TX prob.: " << prob_alloc << ::std::endl;
+        if (commutative)
+            ::std::cout << "⎪ Commutative credits" << ::std::endl;
+        else if (batched)
+            ::std::cout << "⎪ Batched transfers" << ::std::endl;
+        if (coroutines > 1)
+            ::std::cout << "⎪ #streams per worker: " << coroutines << ::std::endl;
         ::std::cout << "⎪ Slow trigger factor: " << slow_factor << ::std::endl;
         ::std::cout << "⎪ Clock resolution:    ";
         if (unlikely(clk_res == Chrono::invalid_tick)) {
@@ -301,15 +330,20 @@ int main(int argc, char** argv) {
         auto maxtick_init = Chrono::invalid_tick;
         auto maxtick_perf = Chrono::invalid_tick;
         auto maxtick_chck = Chrono::invalid_tick;
-        for (auto i = 2; i < argc; ++i) {
+        for (auto i = argfirst + 1; i < argc; ++i) {
             ::std::cout << "⎧ Evaluating '" << argv[i] << "'" << (maxtick_init == Chrono::invalid_tick ? " (reference)" : "") << "..." << ::std::endl;
             // Load TM library
             TransactionalLibrary tl{argv[i]};
             // Initialize workload (shared memory lifetime bound to workload: created and destroyed at the same time)
-            WorkloadBank bank{tl, nbworkers, nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc};
+            ::std::unique_ptr<Workload> bank;
+            if (nbregions > 1) {
+                bank.reset(new WorkloadShardedBank{tl, nbregions, nbworkers, nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc, commutative, coroutines, batched});
+            } else {
+                bank.reset(new WorkloadBank{tl, nbworkers, nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc, commutative, coroutines, batched});
+            }
             try {
                 // Actual performance measurements and correctness check
-                auto res = measure(bank, nbworkers, nbrepeats, seed, maxtick_init, maxtick_perf, maxtick_chck);
+                auto res = measure(*bank, nbworkers, nbrepeats, seed, maxtick_init, maxtick_perf, maxtick_chck);
                 // Check false negative-free correctness
                 auto error = ::std::get<0>(res);
                 if (unlikely(error)) {
@@ -24,6 +24,19 @@
 #pragma once
 
 // External headers
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
 extern "C" {
 #include <dlfcn.h>
 #include <limits.h>
@@ -80,6 +93,19 @@ private:
     using FnWrite   = decltype(&STM::tm_write);
     using FnAlloc   = decltype(&STM::tm_alloc);
     using FnFree    = decltype(&STM::tm_free);
+    using FnReadElastic = decltype(&STM::tm_read_elastic);
+    using FnReadv   = decltype(&STM::tm_readv);
+    using FnWritev  = decltype(&STM::tm_writev);
+    using FnCopy    = decltype(&STM::tm_copy);
+    using FnFill    = decltype(&STM::tm_fill);
+    using FnAddI64  = decltype(&STM::tm_add_i64);
+    using FnBeginStatic = decltype(&STM::tm_begin_static);
+    using FnBeginEx = decltype(&STM::tm_begin_ex);
+    using FnRun     = decltype(&STM::tm_run);
+    using FnRunEx   = decltype(&STM::tm_run_ex);
+    using FnBeginAsync = decltype(&STM::tm_begin_async);
+    using FnAdmitted = decltype(&STM::tm_admitted);
+    using FnWaitAdmission = decltype(&STM::tm_wait_admission);
 private:
     void*     module;     // Module opaque handler
     FnCreate  tm_create;  // Module's initialization function
@@ -93,6 +119,19 @@ private:
     FnWrite   tm_write;   // Module's shared memory write function
     FnAlloc   tm_alloc;   // Module's shared memory allocation function
     FnFree    tm_free;    // Module's shared memory freeing function
+    FnReadElastic tm_read_elastic; // Module's elastic read function (optional, null if not provided)
+    FnReadv   tm_readv;   // Module's vectored read function (optional, null if not provided)
+    FnWritev  tm_writev;  // Module's vectored write function (optional, null if not provided)
+    FnCopy    tm_copy;    // Module's in-place copy function (optional, null if not provided)
+    FnFill    tm_fill;    // Module's in-place fill function (optional, null if not provided)
+    FnAddI64  tm_add_i64; // Module's commutative add function (optional, null if not provided)
+    FnBeginStatic tm_begin_static; // Module's declared-footprint transaction begin function (optional, null if not provided)
+    FnBeginEx tm_begin_ex; // Module's hinted transaction begin function (optional, null if not provided)
+    FnRun     tm_run;     // Module's run-until-commit function (optional, null if not provided)
+    FnRunEx   tm_run_ex;  // Module's hinted run-until-commit function (optional, null if not provided)
+    FnBeginAsync tm_begin_async; // Module's non-waiting transaction begin function (optional, null if not provided, like the next two)
+    FnAdmitted tm_admitted; // Module's pending transaction admission query function
+    FnWaitAdmission tm_wait_admission; // Module's pending transaction admission wait function
 private:
     /** Solve a symbol from its name, and bind it to the given function.
      * @param name Name of the symbol to resolve
@@ -107,6 +146,14 @@ private:
     template<class Signature> void solve(char const* name, Signature& func) const {
         func = solve<Signature>(name);
     }
+    /** Solve an optional symbol from its name, and bind it to the given function, or to null if not found.
+     * @param name Name of the symbol to resolve
+     * @param func Target function to bind
+    **/
+    template<class Signature> void solve_optional(char const* name, Signature& func) const {
+        auto res = ::dlsym(module, name);
+        func = res ? *reinterpret_cast<Signature*>(&res) : nullptr;
+    }
 public:
     /** Loader constructor.
      * @param path  Path to the library to load
@@ -133,6 +180,28 @@ public:
             solve("tm_alloc", tm_alloc);
             solve("tm_free", tm_free);
         }
+        { // Bind module's optional extensions
+            solve_optional("tm_read_elastic", tm_read_elastic);
+            solve_optional("tm_readv", tm_readv);
+            solve_optional("tm_writev", tm_writev);
+            solve_optional("tm_copy", tm_copy);
+            solve_optional("tm_fill", tm_fill);
+            solve_optional("tm_add_i64", tm_add_i64);
+            solve_optional("tm_begin_static", tm_begin_static);
+            solve_optional("tm_begin_ex", tm_begin_ex);
+            solve_optional("tm_run", tm_run);
+            solve_optional("tm_run_ex", tm_run_ex);
+            if (!tm_run)
+                tm_run_ex = nullptr; // Only used along with 'tm_run'
+            solve_optional("tm_begin_async", tm_begin_async);
+            solve_optional("tm_admitted", tm_admitted);
+            solve_optional("tm_wait_admission", tm_wait_admission);
+            if (!tm_begin_async || !tm_admitted || !tm_wait_admission) { // Only usable together
+                tm_begin_async = nullptr;
+                tm_admitted = nullptr;
+                tm_wait_admission = nullptr;
+            }
+        }
     }
     /** Unloader destructor.
     **/
@@ -150,6 +219,9 @@ private:
     constexpr static bool is_power_of_two(size_t align) noexcept {
         return align != 0 && (align & (align - 1)) == 0;
     }
+    /** Size of the private buffer through which copies and fills go when the library has none (in bytes).
+    **/
+    constexpr static size_t fallback_buffer = 4096;
 public:
     /** Opaque shared memory region handle class.
     **/
@@ -213,6 +285,88 @@ public:
     auto begin(bool ro) const noexcept {
         return tl.tm_begin(shared, ro);
     }
+    /** [thread-safe] Begin a new transaction on the shared memory region, with hints on what it does if the library takes them.
+     * @param ro    Whether the transaction is read-only
+     * @param hints Hints on the transaction
+     * @return Opaque transaction ID, 'STM::invalid_tx' on failure
+    **/
+    auto begin(bool ro, STM::tm_hints const& hints) const noexcept {
+        if (!tl.tm_begin_ex)
+            return tl.tm_begin(shared, ro);
+        return tl.tm_begin_ex(shared, ro, &hints);
+    }
+    /** [thread-safe] Tell whether the library runs transactions until they commit itself, with 'run'.
+     * @return Whether the library provides 'tm_run'
+    **/
+    auto can_run() const noexcept {
+        return tl.tm_run != nullptr;
+    }
+    /** [thread-safe] Run a transaction until it commits, through the library, which may keep the transaction across
+     * attempts and back off between them; to call only if 'can_run'.
+     * @param ro  Whether the transaction is read-only
+     * @param fn  Body of the transaction, returning false as soon as one of its operations fails, true to commit
+     * @param ctx Argument of the body
+     * @return Whether the transaction committed, false if it could not begin
+    **/
+    auto run(bool ro, STM::tm_run_fn fn, void* ctx) const noexcept {
+        return tl.tm_run(shared, ro, fn, ctx);
+    }
+    /** [thread-safe] Run a transaction until it commits through the library, with hints on what it does if the library
+     * takes them; to call only if 'can_run'.
+     * @param ro    Whether the transaction is read-only
+     * @param hints Hints on the transaction
+     * @param fn    Body of the transaction, returning false as soon as one of its operations fails, true to commit
+     * @param ctx   Argument of the body
+     * @return Whether the transaction committed, false if it could not begin
+    **/
+    auto run(bool ro, STM::tm_hints const& hints, STM::tm_run_fn fn, void* ctx) const noexcept {
+        if (!tl.tm_run_ex)
+            return tl.tm_run(shared, ro, fn, ctx);
+        return tl.tm_run_ex(shared, ro, &hints, fn, ctx);
+    }
+    /** [thread-safe] Begin a new read-write transaction with a declared footprint, which cannot abort if the library
+     * supports it, falling back to a plain read-write transaction otherwise.
+     * @param reads     Ranges the transaction only reads
+     * @param nb_reads  Number of ranges read
+     * @param writes    Ranges the transaction writes, and possibly reads
+     * @param nb_writes Number of ranges written
+     * @return Opaque transaction ID, 'STM::invalid_tx' on failure
+    **/
+    auto begin_static(STM::tm_range const* reads, size_t nb_reads, STM::tm_range const* writes, size_t nb_writes) const noexcept {
+        if (!tl.tm_begin_static)
+            return tl.tm_begin(shared, false);
+        return tl.tm_begin_static(shared, reads, nb_reads, writes, nb_writes);
+    }
+    /** [thread-safe] Begin a new transaction on the shared memory region without waiting for its epoch if the library
+     * supports it, pending until 'admitted' tells it was admitted; a plain transaction, admitted once begun, otherwise.
+     * @param ro     Whether the transaction is read-only
+     * @param notify Counter the library increments each time one of the pending transactions given it is admitted
+     * @return Opaque transaction ID, 'STM::invalid_tx' on failure
+    **/
+    auto begin_async(bool ro, uint32_t* notify) const noexcept {
+        if (!tl.tm_begin_async)
+            return tl.tm_begin(shared, ro);
+        return tl.tm_begin_async(shared, ro, notify);
+    }
+    /** [thread-safe] Tell whether a transaction begun with 'begin_async' was admitted into its epoch.
+     * @param tx Opaque transaction ID
+     * @return Whether the transaction was admitted, and can run
+    **/
+    auto admitted(TX tx) const noexcept {
+        if (!tl.tm_admitted)
+            return true;
+        return tl.tm_admitted(shared, tx);
+    }
+    /** [thread-safe] Wait until a counter given to 'begin_async' differs from the given value.
+     * @param notify Counter
+     * @param seen   Value last returned, 0 at first
+     * @return Value of the counter
+    **/
+    auto wait_admission(uint32_t* notify, uint32_t seen) const noexcept {
+        if (!tl.tm_wait_admission)
+            return seen; // No transaction is ever pending
+        return tl.tm_wait_admission(shared, notify, seen);
+    }
     /** [thread-safe] End the given transaction.
      * @param tx Opaque transaction ID
      * @return Whether the whole transaction is a success
@@ -220,6 +374,29 @@ public:
     auto end(TX tx) const noexcept {
         return tl.tm_end(shared, tx);
     }
+#if defined(__cpp_impl_coroutine)
+    /** [thread-safe] Make a scheduler of coroutines waiting for their epochs in this memory with 'begin_async',
+     * 'admitted', 'wait_admission' and 'end', thus with plain transactions if the library cannot leave them pending.
+     * @return Scheduler, to use on one thread
+    **/
+    auto scheduler() const {
+        STM::tm_scheduler::functions fns{
+            [](STM::shared_t memory, bool ro, uint32_t* notify) noexcept {
+                return static_cast<TransactionalMemory const*>(memory)->begin_async(ro, notify);
+            },
+            [](STM::shared_t memory, STM::tx_t tx) noexcept {
+                return static_cast<TransactionalMemory const*>(memory)->admitted(tx);
+            },
+            [](STM::shared_t memory, uint32_t* notify, uint32_t seen) noexcept {
+                return static_cast<TransactionalMemory const*>(memory)->wait_admission(notify, seen);
+            },
+            [](STM::shared_t memory, STM::tx_t tx) noexcept {
+                return static_cast<TransactionalMemory const*>(memory)->end(tx);
+            }
+        };
+        return STM::tm_scheduler{const_cast<TransactionalMemory*>(this), fns}; // The scheduler's region is this memory
+    }
+#endif
     /** [thread-safe] Read operation in the given transaction, source in the shared region and target in a private region.
      * @param tx     Transaction to use
      * @param source Source start address
@@ -230,6 +407,18 @@ public:
     auto read(TX tx, void const* source, size_t size, void* target) const noexcept {
         return tl.tm_read(shared, tx, source, size, target);
     }
+    /** [thread-safe] Elastic read operation in the given transaction, falling back to a plain read if the library has none.
+     * @param tx     Transaction to use
+     * @param source Source start address
+     * @param size   Source/target range
+     * @param target Target start address
+     * @return Whether the whole transaction can continue
+    **/
+    auto read_elastic(TX tx, void const* source, size_t size, void* target) const noexcept {
+        if (!tl.tm_read_elastic)
+            return tl.tm_read(shared, tx, source, size, target);
+        return tl.tm_read_elastic(shared, tx, source, size, target);
+    }
     /** [thread-safe] Write operation in the given transaction, source in a private region and target in the shared region.
      * @param tx     Transaction to use
      * @param source Source start address
@@ -240,6 +429,109 @@ public:
     auto write(TX tx, void const* source, size_t size, void* target) const noexcept {
         return tl.tm_write(shared, tx, source, size, target);
     }
+    /** [thread-safe] Vectored read operation in the given transaction, falling back to one plain read per entry if the library has none.
+     * @param tx  Transaction to use
+     * @param vec Entries: source in the shared region, length, target in a private region
+     * @param nb  Number of entries
+     * @return Whether the whole transaction can continue
+    **/
+    bool readv(TX tx, STM::tm_vec const* vec, size_t nb) const noexcept {
+        if (tl.tm_readv)
+            return tl.tm_readv(shared, tx, vec, nb);
+        for (size_t i = 0; i < nb; ++i) {
+            if (!tl.tm_read(shared, tx, vec[i].address, vec[i].size, vec[i].buffer))
+                return false;
+        }
+        return true;
+    }
+    /** [thread-safe] Vectored write operation in the given transaction, falling back to one plain write per entry if the library has none.
+     * @param tx  Transaction to use
+     * @param vec Entries: target in the shared region, length, source in a private region
+     * @param nb  Number of entries
+     * @return Whether the whole transaction can continue
+    **/
+    bool writev(TX tx, STM::tm_vec const* vec, size_t nb) const noexcept {
+        if (tl.tm_writev)
+            return tl.tm_writev(shared, tx, vec, nb);
+        for (size_t i = 0; i < nb; ++i) {
+            if (!tl.tm_write(shared, tx, vec[i].buffer, vec[i].size, vec[i].address))
+                return false;
+        }
+        return true;
+    }
+    /** [thread-safe] Copy operation in the given transaction, both ranges in the shared region and possibly overlapping,
+     * falling back to reads and writes through a private buffer if the library has none.
+     * @param tx     Transaction to use
+     * @param source Source start address
+     * @param size   Source/target range
+     * @param target Target start address
+     * @return Whether the whole transaction can continue
+    **/
+    bool copy(TX tx, void const* source, size_t size, void* target) const noexcept {
+        if (tl.tm_copy)
+            return tl.tm_copy(shared, tx, source, size, target);
+        unsigned char buffer[fallback_buffer];
+        auto step = alignment <= fallback_buffer ? fallback_buffer - fallback_buffer % alignment : alignment;
+        ::std::unique_ptr<unsigned char[]> large{step <= fallback_buffer ? nullptr : new (::std::nothrow) unsigned char[step]};
+        auto chunk = step <= fallback_buffer ? buffer : large.get();
+        if (unlikely(!chunk))
+            return false;
+        auto backward = reinterpret_cast<uintptr_t>(target) > reinterpret_cast<uintptr_t>(source); // Each chunk is then read before an earlier one overwrites it
+        for (size_t done = 0; done < size; done += step) {
+            auto length = ::std::min(size - done, step);
+            auto offset = backward ? size - done - length : done;
+            if (!tl.tm_read(shared, tx, static_cast<unsigned char const*>(source) + offset, length, chunk)
+             || !tl.tm_write(shared, tx, chunk, length, static_cast<unsigned char*>(target) + offset))
+                return false;
+        }
+        return true;
+    }
+    /** [thread-safe] Fill operation in the given transaction, every byte of the range set to the given value,
+     * falling back to writes from a private buffer if the library has none.
+     * @param tx     Transaction to use
+     * @param target Target start address
+     * @param size   Target range
+     * @param byte   Value of each byte
+     * @return Whether the whole transaction can continue
+    **/
+    bool fill(TX tx, void* target, size_t size, unsigned char byte) const noexcept {
+        if (tl.tm_fill)
+            return tl.tm_fill(shared, tx, target, size, byte);
+        unsigned char buffer[fallback_buffer];
+        auto step = alignment <= fallback_buffer ? fallback_buffer - fallback_buffer % alignment : alignment;
+        ::std::unique_ptr<unsigned char[]> large{step <= fallback_buffer ? nullptr : new (::std::nothrow) unsigned char[step]};
+        auto chunk = step <= fallback_buffer ? buffer : large.get();
+        if (unlikely(!chunk))
+            return false;
+        ::memset(chunk, byte, ::std::min(size, step));
+        for (size_t done = 0; done < size; done += step) {
+            if (!tl.tm_write(shared, tx, chunk, ::std::min(size - done, step), static_cast<unsigned char*>(target) + done))
+                return false;
+        }
+        return true;
+    }
+    /** [thread-safe] Add operation on a 64-bit integer in the given transaction, which does not conflict with the adds of
+     * other transactions if the library supports it, falling back to a plain read-modify-write of the word(s) otherwise.
+     * @param tx     Transaction to use
+     * @param target Address of the integer
+     * @param delta  Value to add
+     * @return Whether the whole transaction can continue
+    **/
+    bool add_i64(TX tx, void* target, int64_t delta) const noexcept {
+        if (tl.tm_add_i64)
+            return tl.tm_add_i64(shared, tx, target, delta);
+        auto size = ::std::max(alignment, sizeof(int64_t)); // Whole words, the integer in the first 8 bytes
+        unsigned char buffer[fallback_buffer];
+        ::std::unique_ptr<unsigned char[]> large{size <= fallback_buffer ? nullptr : new (::std::nothrow) unsigned char[size]};
+        auto word = size <= fallback_buffer ? buffer : large.get();
+        if (unlikely(!word) || !tl.tm_read(shared, tx, target, size, word))
+            return false;
+        uint64_t value;
+        ::memcpy(&value, word, sizeof(value));
+        value += static_cast<uint64_t>(delta);
+        ::memcpy(word, &value, sizeof(value));
+        return tl.tm_write(shared, tx, word, size, target);
+    }
     /** [thread-safe] Memory allocation operation in the given transaction, throw if no memory available.
      * @param tx     Transaction to use
      * @param size   Size to allocate
@@ -269,11 +561,15 @@ public:
         read_write = false,
         read_only  = true
     };
+    /** Tag of the borrowing constructor.
+    **/
+    struct Borrow final {};
 private:
     TransactionalMemory const& tm; // Bound transactional memory
     STM::tx_t tx; // Opaque transaction handle
     bool aborted; // Transaction was aborted
     bool is_ro;   // Whether the transaction is read-only (solely for assertion)
+    bool owned;   // Whether the destructor ends the transaction
 public:
     /** Deleted copy constructor/assignment.
     **/
@@ -283,14 +579,35 @@ public:
      * @param tm Transactional memory to bind
      * @param ro Whether the transaction is read-only
     **/
-    Transaction(TransactionalMemory const& tm, Mode ro): tm{tm}, tx{tm.begin(static_cast<bool>(ro))}, aborted{false}, is_ro{static_cast<bool>(ro)} {
+    Transaction(TransactionalMemory const& tm, Mode ro): tm{tm}, tx{tm.begin(static_cast<bool>(ro))}, aborted{false}, is_ro{static_cast<bool>(ro)}, owned{true} {
         if (unlikely(tx == STM::invalid_tx))
             throw Exception::TransactionBegin{};
     }
+    /** Begin constructor, with hints on the transaction.
+     * @param tm    Transactional memory to bind
+     * @param ro    Whether the transaction is read-only
+     * @param hints Hints on the transaction
+    **/
+    Transaction(TransactionalMemory const& tm, Mode ro, STM::tm_hints const& hints): tm{tm}, tx{tm.begin(static_cast<bool>(ro), hints)}, aborted{false}, is_ro{static_cast<bool>(ro)}, owned{true} {
+        if (unlikely(tx == STM::invalid_tx))
+            throw Exception::TransactionBegin{};
+    }
+    /** Adopting constructor, for a transaction already begun and admitted.
+     * @param tm Transactional memory to bind
+     * @param ro Whether the transaction is read-only
+     * @param tx Opaque transaction ID to take over
+    **/
+    Transaction(TransactionalMemory const& tm, Mode ro, STM::tx_t tx): tm{tm}, tx{tx}, aborted{false}, is_ro{static_cast<bool>(ro)}, owned{true} {}
+    /** Borrowing constructor, for the transaction the library runs a body in: the library ends it, not the destructor.
+     * @param tm Transactional memory to bind
+     * @param ro Whether the transaction is read-only
+     * @param tx Opaque transaction ID to borrow
+    **/
+    Transaction(TransactionalMemory const& tm, Mode ro, STM::tx_t tx, Borrow): tm{tm}, tx{tx}, aborted{false}, is_ro{static_cast<bool>(ro)}, owned{false} {}
     /** End destructor.
     **/
     ~Transaction() noexcept(false) {
-        if (likely(!aborted)) {
+        if (likely(owned && !aborted)) {
             if (unlikely(!tm.end(tx)))
                 throw Exception::TransactionRetry{};
         }
@@ -314,6 +631,17 @@ public:
             throw Exception::TransactionRetry{};
         }
     }
+    /** [thread-safe] Elastic read operation in the bound transaction, for the search phase of a traversal.
+     * @param source Source start address
+     * @param size   Source/target range
+     * @param target Target start address
+    **/
+    void read_elastic(void const* source, size_t size, void* target) {
+        if (unlikely(!tm.read_elastic(tx, source, size, target))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
     /** [thread-safe] Write operation in the bound transaction, source in a private region and target in the shared region.
      * @param source Source start address
      * @param size   Source/target range
@@ -327,6 +655,66 @@ public:
             throw Exception::TransactionRetry{};
         }
     }
+    /** [thread-safe] Vectored read operation in the bound transaction.
+     * @param vec Entries: source in the shared region, length, target in a private region
+     * @param nb  Number of entries
+    **/
+    void readv(STM::tm_vec const* vec, size_t nb) {
+        if (unlikely(!tm.readv(tx, vec, nb))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
+    /** [thread-safe] Vectored write operation in the bound transaction.
+     * @param vec Entries: target in the shared region, length, source in a private region
+     * @param nb  Number of entries
+    **/
+    void writev(STM::tm_vec const* vec, size_t nb) {
+        if (unlikely(assert_mode && is_ro))
+            throw Exception::TransactionReadOnly{};
+        if (unlikely(!tm.writev(tx, vec, nb))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
+    /** [thread-safe] Copy operation in the bound transaction, both ranges in the shared region and possibly overlapping.
+     * @param source Source start address
+     * @param size   Source/target range
+     * @param target Target start address
+    **/
+    void copy(void const* source, size_t size, void* target) {
+        if (unlikely(assert_mode && is_ro))
+            throw Exception::TransactionReadOnly{};
+        if (unlikely(!tm.copy(tx, source, size, target))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
+    /** [thread-safe] Fill operation in the bound transaction.
+     * @param target Target start address
+     * @param size   Target range
+     * @param byte   Value of each byte
+    **/
+    void fill(void* target, size_t size, unsigned char byte) {
+        if (unlikely(assert_mode && is_ro))
+            throw Exception::TransactionReadOnly{};
+        if (unlikely(!tm.fill(tx, target, size, byte))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
+    /** [thread-safe] Commutative add operation on a 64-bit integer in the bound transaction.
+     * @param target Address of the integer
+     * @param delta  Value to add
+    **/
+    void add_i64(void* target, int64_t delta) {
+        if (unlikely(assert_mode && is_ro))
+            throw Exception::TransactionReadOnly{};
+        if (unlikely(!tm.add_i64(tx, target, delta))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
     /** [thread-safe] Memory allocation operation in the bound transaction, throw if no memory available.
      * @param size Size to allocate
      * @return Target start address
@@ -397,6 +785,14 @@ public:
     operator Type() const {
         return read();
     }
+    /** Elastic read operation.
+     * @return Private copy of the content at the shared address
+    **/
+    Type read_elastic() const {
+        Type res;
+        tx.read_elastic(address, sizeof(Type), &res);
+        return res;
+    }
     /** Write operation.
      * @param source Private content to write at the shared address
     **/
@@ -448,6 +844,14 @@ public:
     operator Type*() const {
         return read();
     }
+    /** Elastic read operation.
+     * @return Private copy of the content at the shared address
+    **/
+    Type* read_elastic() const {
+        Type* res;
+        tx.read_elastic(address, sizeof(Type*), &res);
+        return res;
+    }
     /** Write operation.
      * @param source Private content to write at the shared address
     **/
@@ -600,15 +1004,117 @@ public:
     }
 };
 
+/** Batch of shared entries read or written together, with one vectored operation.
+ * The private variables given stay bound to the batch, and must outlive the operation.
+ * @param capacity Maximum number of entries
+**/
+template<size_t capacity> class SharedBatch final: private NonCopyable {
+private:
+    Transaction& tx; // Bound transaction
+    STM::tm_vec entries[capacity];
+    size_t count;
+    /** Add an entry.
+     * @param address Address in shared memory
+     * @param size    Size of the entry
+     * @param buffer  Private variable
+    **/
+    void push(void const* address, size_t size, void const* buffer) {
+        if (unlikely(assert_mode && count >= capacity))
+            throw Exception::SharedOverflow{};
+        entries[count++] = STM::tm_vec{const_cast<void*>(address), size, const_cast<void*>(buffer)};
+    }
+public:
+    /** Binding constructor.
+     * @param tx Bound transaction
+    **/
+    SharedBatch(Transaction& tx): tx{tx}, count{0} {}
+public:
+    /** Add the read of an entry.
+     * @param entry  Shared entry to read
+     * @param target Private variable receiving its content
+     * @return This batch
+    **/
+    template<class Type> SharedBatch& read(Shared<Type> const& entry, Type& target) {
+        push(entry.get(), sizeof(Type), &target);
+        return *this;
+    }
+    /** Add the write of an entry.
+     * @param entry  Shared entry to write
+     * @param source Private content to write
+     * @return This batch
+    **/
+    template<class Type> SharedBatch& write(Shared<Type> const& entry, Type const& source) {
+        push(entry.get(), sizeof(Type), &source);
+        return *this;
+    }
+    /** Read all the entries added with 'read', then empty the batch.
+    **/
+    void load() {
+        tx.readv(entries, count);
+        count = 0;
+    }
+    /** Write all the entries added with 'write', then empty the batch.
+    **/
+    void store() {
+        tx.writev(entries, count);
+        count = 0;
+    }
+};
+
 // -------------------------------------------------------------------------- //
 
-/** Repeat a given transaction until it commits.
+/** Run a given transaction until it commits with the library's 'tm_run', or 'tm_run_ex' if given hints.
+ * An exception other than a retry commits the transaction, as when it leaves a transaction's scope, then is rethrown.
+ * @param tm    Transactional memory, which 'can_run'
+ * @param mode  Transactional mode
+ * @param hints Hints on the transaction, null for none
+ * @param func  Transaction closure (Transaction& -> ...)
+ * @return Returned value (or void) when the transaction committed
+**/
+template<class Func> static auto run_transactional(TransactionalMemory const& tm, Transaction::Mode mode, STM::tm_hints const* hints, Func& func) {
+    using Result = decltype(func(::std::declval<Transaction&>()));
+    struct Call {
+        TransactionalMemory const& tm;
+        Transaction::Mode mode;
+        Func& func;
+        ::std::conditional_t<::std::is_void_v<Result>, bool, ::std::optional<Result>> result; // Of the attempt that committed
+        ::std::exception_ptr error; // Thrown by the body, rethrown once the transaction ended
+    } call{tm, mode, func, {}, nullptr};
+    auto body = [](STM::shared_t, STM::tx_t tx, void* ctx) noexcept -> bool {
+        auto& call = *static_cast<Call*>(ctx);
+        try {
+            Transaction transaction{call.tm, call.mode, tx, Transaction::Borrow{}};
+            if constexpr (::std::is_void_v<Result>) {
+                call.func(transaction);
+            } else {
+                call.result.emplace(call.func(transaction));
+            }
+            return true;
+        } catch (Exception::TransactionRetry const&) {
+            return false; // The failed operation aborted the transaction
+        } catch (...) {
+            call.error = ::std::current_exception();
+            return true;
+        }
+    };
+    auto committed = hints ? tm.run(static_cast<bool>(mode), *hints, body, &call) : tm.run(static_cast<bool>(mode), body, &call);
+    if (unlikely(!committed))
+        throw Exception::TransactionBegin{};
+    if (unlikely(call.error))
+        ::std::rethrow_exception(call.error);
+    if constexpr (!::std::is_void_v<Result>)
+        return ::std::move(*call.result);
+}
+
+/** Repeat a given transaction until it commits, through the library's 'tm_run' if it has one.
  * @param tm   Transactional memory
  * @param mode Transactional mode
  * @param func Transaction closure (Transaction& -> ...)
  * @return Returned value (or void) when the transaction committed
 **/
 template<class Func> static auto transactional(TransactionalMemory const& tm, Transaction::Mode mode, Func&& func) {
+    if (tm.can_run())
+        return run_transactional(tm, mode, nullptr, func);
     do {
         try {
             Transaction tx{tm, mode};
@@ -618,3 +1124,140 @@ template<class Func> static auto transactional(TransactionalMemory const& tm, Tr
         }
     } while (true);
 }
+
+/** Repeat a given transaction until it commits, with hints on what it does, through the library's 'tm_run' if it has one.
+ * @param tm    Transactional memory
+ * @param mode  Transactional mode
+ * @param hints Hints on the transaction
+ * @param func  Transaction closure (Transaction& -> ...)
+ * @return Returned value (or void) when the transaction committed
+**/
+template<class Func> static auto transactional(TransactionalMemory const& tm, Transaction::Mode mode, STM::tm_hints const& hints, Func&& func) {
+    if (tm.can_run())
+        return run_transactional(tm, mode, &hints, func);
+    do {
+        try {
+            Transaction tx{tm, mode, hints};
+            return func(tx);
+        } catch (Exception::TransactionRetry const&) {
+            continue;
+        }
+    } while (true);
+}
+
+// -------------------------------------------------------------------------- //
+
+/** Scheduler running the transactions of many logical requests on one thread.
+ * Each transaction waits for its epoch without blocking the thread, which meanwhile runs the transactions already
+ * admitted; once admitted, a transaction runs until it commits or aborts, and is then begun again until it commits.
+ * A transaction's body must neither wait for nor begin another transaction; it spawns the next one of its request instead.
+**/
+class TransactionScheduler final: private NonCopyable {
+private:
+    /** One transaction of a logical request.
+    **/
+    struct Task {
+        Transaction::Mode mode;
+        STM::tx_t tx; // Pending or admitted transaction, 'STM::invalid_tx' if not begun
+        ::std::function<bool(Transaction&)> body; // Transaction closure
+        ::std::function<void(bool)> then; // Continuation, given the value the body returned in the attempt that committed
+    };
+private:
+    TransactionalMemory const& tm; // Bound transactional memory
+    ::std::vector<Task> tasks; // Transactions not run yet
+    uint32_t notify; // Counter of the admissions, incremented by the library
+    uint32_t seen;   // Last value of the counter
+public:
+    /** Bind constructor.
+     * @param tm Transactional memory to bind
+    **/
+    TransactionScheduler(TransactionalMemory const& tm): tm{tm}, tasks{}, notify{0}, seen{0} {}
+private:
+    /** End the transactions of the remaining tasks, those pending once admitted, then drop the tasks.
+    **/
+    void cancel() noexcept {
+        while (!tasks.empty()) {
+            auto ended = false;
+            for (size_t i = 0; i < tasks.size();) {
+                if (tasks[i].tx != STM::invalid_tx) {
+                    if (!tm.admitted(tasks[i].tx)) {
+                        ++i;
+                        continue;
+                    }
+                    tm.end(tasks[i].tx); // Commits nothing: the body did not run
+                }
+                if (i + 1 < tasks.size())
+                    tasks[i] = ::std::move(tasks.back());
+                tasks.pop_back();
+                ended = true;
+            }
+            if (!ended && !tasks.empty())
+                seen = tm.wait_admission(&notify, seen);
+        }
+    }
+    /** Begin a task's transaction if it is not, then tell whether it was admitted.
+     * @param task Task to poll
+     * @return Whether the task can run
+    **/
+    bool poll(Task& task) {
+        if (task.tx == STM::invalid_tx) {
+            task.tx = tm.begin_async(static_cast<bool>(task.mode), &notify);
+            if (unlikely(task.tx == STM::invalid_tx)) {
+                cancel();
+                throw Exception::TransactionBegin{};
+            }
+        }
+        return tm.admitted(task.tx);
+    }
+    /** Run an admitted task's transaction, then its continuation if it committed, or spawn it again otherwise.
+     * If either throws, the transactions of the other tasks are ended before it is rethrown.
+     * @param task Task to run
+    **/
+    void run(Task&& task) {
+        try {
+            bool result;
+            try {
+                Transaction tx{tm, task.mode, task.tx};
+                result = task.body(tx);
+            } catch (Exception::TransactionRetry const&) {
+                task.tx = STM::invalid_tx;
+                tasks.push_back(::std::move(task));
+                return;
+            }
+            task.then(result);
+        } catch (...) {
+            cancel();
+            throw;
+        }
+    }
+public:
+    /** Spawn a transaction, begun at the next 'run' pass.
+     * @param mode Transactional mode
+     * @param body Transaction closure (Transaction& -> bool)
+     * @param then Continuation, run once the transaction committed (bool -> void), which may spawn the next transaction
+    **/
+    template<class Body, class Then> void spawn(Transaction::Mode mode, Body&& body, Then&& then) {
+        tasks.push_back(Task{mode, STM::invalid_tx, ::std::forward<Body>(body), ::std::forward<Then>(then)});
+    }
+    /** Run the spawned transactions, and the ones they spawn, until none remains.
+    **/
+    void run() {
+        while (!tasks.empty()) {
+            auto ran = false;
+            for (size_t i = 0; i < tasks.size();) {
+                if (!poll(tasks[i])) {
+                    ++i;
+                    continue;
+                }
+                auto task = ::std::move(tasks[i]);
+                if (i + 1 < tasks.size())
+                    tasks[i] = ::std::move(tasks.back());
+                tasks.pop_back();
+                run(::std::move(task));
+                ran = true;
+            }
+            if (!ran) // Every transaction waits for its epoch
+                seen = tm.wait_admission(&notify, seen);
+        }
+    }
+};
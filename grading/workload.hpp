@@ -24,8 +24,11 @@
 #pragma once
 
 // External headers
+#include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <random>
+#include <vector>
 
 // Internal headers
 #include "common.hpp"
@@ -43,20 +46,14 @@ using Seed = uint_fast32_t;
 /** Workload base class.
 **/
 class Workload {
-protected:
-    TransactionalLibrary const& tl;  // Associated transactional library
-    TransactionalMemory         tm;  // Built transactional memory to use
 public:
     /** Deleted copy constructor/assignment.
     **/
     Workload(Workload const&) = delete;
     Workload& operator=(Workload const&) = delete;
-    /** Transactional memory constructor.
-     * @param library Transactional library to use
-     * @param align   Shared memory region required alignment
-     * @param size    Size of the shared memory region to allocate
+    /** Default constructor.
     **/
-    Workload(TransactionalLibrary const& library, size_t align, size_t size): tl{library}, tm{tl, align, size} {}
+    Workload() = default;
     /** Virtual destructor.
     **/
     virtual ~Workload() {};
@@ -89,6 +86,7 @@ public:
     **/
     using Balance = intptr_t;
     static_assert(sizeof(Balance) >= sizeof(void*), "Balance class is too small");
+    static_assert(sizeof(Balance) == sizeof(int64_t), "Balance class does not fit the commutative adds");
 private:
     /** Shared segment of accounts class.
     **/
@@ -133,6 +131,8 @@ private:
         AccountSegment(Transaction& tx, void* address): count{tx, address}, next{tx, count.after()}, parity{tx, next.after()}, accounts{tx, parity.after()} {}
     };
 private:
+    TransactionalLibrary const& tl; // Associated transactional library
+    TransactionalMemory         tm; // Built transactional memory to use
     size_t  nbworkers;     // Number of concurrent workers
     size_t  nbtxperwrk;    // Number of transactions per worker
     size_t  nbaccounts;    // Initial number of accounts and number of accounts per segment
@@ -140,6 +140,9 @@ private:
     Balance init_balance;  // Initial account balance
     float   prob_long;     // Probability of running a long, read-only control transaction
     float   prob_alloc;    // Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+    bool    commutative;   // Whether transfers credit the receiver with a commutative add
+    bool    batched;       // Whether transfers read then write both balances with one vectored operation each
+    size_t  coroutines;    // Number of logical request streams each worker interleaves, 1 to run its transactions one after the other
     Barrier barrier;       // Barrier for thread synchronization during 'check'
 public:
     /** Bank workload constructor.
@@ -151,128 +154,317 @@ public:
      * @param init_balance  Initial account balance
      * @param prob_long     Probability of running a long, read-only control transaction
      * @param prob_alloc    Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+     * @param commutative   Whether transfers credit the receiver with a commutative add rather than a read and a write
+     * @param coroutines    Number of logical request streams each worker interleaves on a scheduler, 1 for none
+     * @param batched       Whether transfers read then write both balances with one vectored operation each (unless commutative)
     **/
-    WorkloadBank(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc): Workload{library, AccountSegment::align(), AccountSegment::size(nbaccounts)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbaccounts{nbaccounts}, expnbaccounts{expnbaccounts}, init_balance{init_balance}, prob_long{prob_long}, prob_alloc{prob_alloc}, barrier{static_cast<Barrier::Counter>(nbworkers)} {}
+    WorkloadBank(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc, bool commutative = false, size_t coroutines = 1, bool batched = false): tl{library}, tm{tl, AccountSegment::align(), AccountSegment::size(nbaccounts)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbaccounts{nbaccounts}, expnbaccounts{expnbaccounts}, init_balance{init_balance}, prob_long{prob_long}, prob_alloc{prob_alloc}, commutative{commutative}, batched{batched}, coroutines{coroutines}, barrier{static_cast<Barrier::Counter>(nbworkers)} {}
 private:
+    /** Expected number of segments of accounts, each transaction type walking through them.
+     * @return Expected number of segments
+    **/
+    size_t expected_segments() const noexcept {
+        return expnbaccounts / nbaccounts + 1;
+    }
+    /** Body of the long read-only transaction, summing the balance of each account.
+     * @param tx         Transaction to use
+     * @param nbaccounts Loosely-updated number of accounts
+     * @return Whether no inconsistency has been found
+    **/
+    bool long_body(Transaction& tx, size_t& nbaccounts) const {
+        auto count = 0ul; // Total number of accounts seen.
+        auto sum   = Balance{0}; // Total balance on all seen accounts + parity ammount.
+        auto start = tm.get_start(); // The list of accounts starts at the first word of the shared memory region.
+        while (start) {
+            AccountSegment segment{tx, start}; // We interpret the memory as a segment/array of accounts.
+            decltype(count) segment_count = segment.count;
+            count += segment_count; // And accumulate the total number of accounts.
+            sum += segment.parity; // We also sum the money that results from the destruction of accounts.
+            for (decltype(count) i = 0; i < segment_count; ++i) {
+                Balance local = segment.accounts[i];
+                if (unlikely(local < 0)) // If one account has a negative balance, there's a consistency issue.
+                    return false;
+                sum += local;
+            }
+            start = segment.next; // Accounts are stored in linked segments, we move to the next one.
+        }
+        nbaccounts = count;
+        return sum == static_cast<Balance>(init_balance * count); // Consistency check: no money should ever be destroyed or created out of thin air.
+    }
     /** Long read-only transaction, summing the balance of each account.
      * @param count Loosely-updated number of accounts
      * @return Whether no inconsistency has been found
     **/
     bool long_tx(size_t& nbaccounts) const {
-        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
-            auto count = 0ul; // Total number of accounts seen.
-            auto sum   = Balance{0}; // Total balance on all seen accounts + parity ammount.
-            auto start = tm.get_start(); // The list of accounts starts at the first word of the shared memory region.
-            while (start) {
-                AccountSegment segment{tx, start}; // We interpret the memory as a segment/array of accounts.
-                decltype(count) segment_count = segment.count;
-                count += segment_count; // And accumulate the total number of accounts.
-                sum += segment.parity; // We also sum the money that results from the destruction of accounts.
-                for (decltype(count) i = 0; i < segment_count; ++i) {
-                    Balance local = segment.accounts[i];
-                    if (unlikely(local < 0)) // If one account has a negative balance, there's a consistency issue.
-                        return false;
-                    sum += local;
-                }
-                start = segment.next; // Accounts are stored in linked segments, we move to the next one.
-            }
-            nbaccounts = count;
-            return sum == static_cast<Balance>(init_balance * count); // Consistency check: no money should ever be destroyed or created out of thin air.
+        STM::tm_hints hints{expnbaccounts + 3 * expected_segments(), 0, 0, true}; // Every account, plus the header of every segment
+        return transactional(tm, Transaction::Mode::read_only, hints, [&](Transaction& tx) {
+            return long_body(tx, nbaccounts);
         });
     }
-    /** Account (de)allocation transaction, adding accounts with initial balance or removing them.
+    /** Body of the account (de)allocation transaction, adding accounts with initial balance or removing them.
+     * @param tx      Transaction to use
      * @param trigger Trigger level that will decide whether to allocate or deallocate
     **/
-    void alloc_tx(size_t trigger) const {
-        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
-            auto count = 0ul; // Total number of accounts seen.
-            void* prev = nullptr;
-            auto start = tm.get_start();
-            while (true) {
-                AccountSegment segment{tx, start};
-                decltype(count) segment_count = segment.count;
-                count += segment_count;
-                decltype(start) segment_next = segment.next;
-                if (!segment_next) { // Currently at the last segment
-                    if (count > trigger && likely(count > 2)) { // If we have seen "too many" accounts, we will destroy one.
-                        --segment_count; // Let's remove the last account from the last segment.
-                        auto new_parity = segment.parity.read() + segment.accounts[segment_count] - init_balance; // We remove 1x the initial balance but don't break parity.
-                        if (segment_count > 0) { // Just remove one account from the (last) segment without deallocating memory.
-                            segment.count = segment_count;
-                            segment.parity = new_parity;
-                        } else { // If there's no one in the last segment anymore, we deallocate it.
-                            if (unlikely(assert_mode && prev == nullptr))
-                                throw Exception::TransactionNotLastSegment{};
-                            AccountSegment prev_segment{tx, prev};
-                            prev_segment.next.free();
-                            prev_segment.parity = prev_segment.parity.read() + new_parity;
-                        }
-                    } else { // If we don't destroy any account, then let's create a new one.
-                        if (segment_count < nbaccounts) { // If there's room in the last segment, then let's create the account in it without allocating memory.
-                            segment.accounts[segment_count] = init_balance;
-                            segment.count = segment_count + 1;
-                        } else { // Otherwise, we really need to allocate memory for the new account.
-                            AccountSegment next_segment{tx, segment.next.alloc(AccountSegment::size(nbaccounts))};
-                            next_segment.count = 1;
-                            next_segment.accounts[0] = init_balance;
-                        }
+    void alloc_body(Transaction& tx, size_t trigger) const {
+        auto count = 0ul; // Total number of accounts seen.
+        void* prev = nullptr;
+        auto start = tm.get_start();
+        while (true) {
+            AccountSegment segment{tx, start};
+            decltype(count) segment_count = segment.count.read_elastic(); // Search phase: elastic reads, tracked once we write
+            count += segment_count;
+            decltype(start) segment_next = segment.next.read_elastic();
+            if (!segment_next) { // Currently at the last segment
+                if (count > trigger && likely(count > 2)) { // If we have seen "too many" accounts, we will destroy one.
+                    --segment_count; // Let's remove the last account from the last segment.
+                    auto new_parity = segment.parity.read() + segment.accounts[segment_count] - init_balance; // We remove 1x the initial balance but don't break parity.
+                    if (segment_count > 0) { // Just remove one account from the (last) segment without deallocating memory.
+                        segment.count = segment_count;
+                        segment.parity = new_parity;
+                    } else { // If there's no one in the last segment anymore, we deallocate it.
+                        if (unlikely(assert_mode && prev == nullptr))
+                            throw Exception::TransactionNotLastSegment{};
+                        AccountSegment prev_segment{tx, prev};
+                        prev_segment.next.free();
+                        prev_segment.parity = prev_segment.parity.read() + new_parity;
+                    }
+                } else { // If we don't destroy any account, then let's create a new one.
+                    if (segment_count < nbaccounts) { // If there's room in the last segment, then let's create the account in it without allocating memory.
+                        segment.accounts[segment_count] = init_balance;
+                        segment.count = segment_count + 1;
+                    } else { // Otherwise, we really need to allocate memory for the new account.
+                        AccountSegment next_segment{tx, segment.next.alloc(AccountSegment::size(nbaccounts))};
+                        next_segment.count = 1;
+                        next_segment.accounts[0] = init_balance;
                     }
-                    return;
                 }
-                prev  = start;
-                start = segment_next;
+                return;
             }
+            prev  = start;
+            start = segment_next;
+        }
+    }
+    /** Account (de)allocation transaction, adding accounts with initial balance or removing them.
+     * @param trigger Trigger level that will decide whether to allocate or deallocate
+    **/
+    void alloc_tx(size_t trigger) const {
+        STM::tm_hints hints{2 * expected_segments() + 2, 3, 1, false}; // Rare, and conflicting with every transfer: favored
+        return transactional(tm, Transaction::Mode::read_write, hints, [&](Transaction& tx) {
+            alloc_body(tx, trigger);
         });
     }
-    /** Short read-write transaction, transferring one unit from an account to an account (potentially the same).
+    /** Body of the short read-write transaction, transferring one unit from an account to an account (potentially the same).
+     * @param tx      Transaction to use
      * @param send_id Index of the sender account
      * @param recv_id Index of the receiver account (potentially same as source)
      * @return Whether the parameters were satisfying and the transaction committed on useful work
     **/
-    bool short_tx(size_t send_id, size_t recv_id) const {
-        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
-            void* send_ptr = nullptr;
-            void* recv_ptr = nullptr;
+    bool short_body(Transaction& tx, size_t send_id, size_t recv_id) const {
+        void* send_ptr = nullptr;
+        void* recv_ptr = nullptr;
 
-            // Get the account pointers in shared memory
-            auto start = tm.get_start();
-            while (true) {
-                AccountSegment segment{tx, start};
-                size_t segment_count = segment.count;
-                if (!send_ptr) {
-                    if (send_id < segment_count) {
-                        send_ptr = segment.accounts[send_id].get();
-                        if (recv_ptr)
-                            break;
-                    } else {
-                        send_id -= segment_count;
-                    }
+        // Get the account pointers in shared memory
+        auto start = tm.get_start();
+        while (true) {
+            AccountSegment segment{tx, start};
+            size_t segment_count = segment.count.read_elastic(); // Search phase: elastic reads, tracked once we write
+            if (!send_ptr) {
+                if (send_id < segment_count) {
+                    send_ptr = segment.accounts[send_id].get();
+                    if (recv_ptr)
+                        break;
+                } else {
+                    send_id -= segment_count;
                 }
-                if (!recv_ptr) {
-                    if (recv_id < segment_count) {
-                        recv_ptr = segment.accounts[recv_id].get();
-                        if (send_ptr)
-                            break;
-                    } else {
-                        recv_id -= segment_count;
-                    }
+            }
+            if (!recv_ptr) {
+                if (recv_id < segment_count) {
+                    recv_ptr = segment.accounts[recv_id].get();
+                    if (send_ptr)
+                        break;
+                } else {
+                    recv_id -= segment_count;
                 }
-                start = segment.next;
-                if (!start) // Current segment is the last segment
-                    return false; // At least one account does not exist => do nothing
             }
+            start = segment.next.read_elastic();
+            if (!start) // Current segment is the last segment
+                return false; // At least one account does not exist => do nothing
+        }
 
-            // Transfer the money if enough fund
-            Shared<Balance> sender{tx, send_ptr}; // Shared is a template that overloads copy to use tm_read/tm_write.
-            Shared<Balance> recver{tx, recv_ptr};
-            auto send_val = sender.read();
-            if (send_val > 0) {
+        // Transfer the money if enough fund
+        Shared<Balance> sender{tx, send_ptr}; // Shared is a template that overloads copy to use tm_read/tm_write.
+        Shared<Balance> recver{tx, recv_ptr};
+        if (commutative) { // Only the sender is read: transfers to the same receiver do not conflict
+            Balance send_val = sender;
+            if (send_val > 0 && send_ptr != recv_ptr) {
                 sender = send_val - 1;
-                recver = recver.read() + 1;
+                tx.add_i64(recv_ptr, 1);
+            }
+            return true;
+        }
+        if (batched) { // Both balances read then written with one vectored operation each
+            Balance send_val, recv_val;
+            SharedBatch<2>{tx}.read(sender, send_val).read(recver, recv_val).load();
+            if (send_val > 0 && send_ptr != recv_ptr) { // A transfer to the same account changes nothing
+                Balance new_send = send_val - 1, new_recv = recv_val + 1;
+                SharedBatch<2>{tx}.write(sender, new_send).write(recver, new_recv).store();
             }
             return true;
+        }
+        auto send_val = sender.read();
+        if (send_val > 0) {
+            sender = send_val - 1;
+            recver = recver.read() + 1;
+        }
+        return true;
+    }
+    /** Short read-write transaction, transferring one unit from an account to an account (potentially the same).
+     * @param send_id Index of the sender account
+     * @param recv_id Index of the receiver account (potentially same as source)
+     * @return Whether the parameters were satisfying and the transaction committed on useful work
+    **/
+    bool short_tx(size_t send_id, size_t recv_id) const {
+        STM::tm_hints hints{2 * expected_segments() + 2, 2, 0, false}; // Searches for both accounts, then transfers
+        return transactional(tm, Transaction::Mode::read_write, hints, [&](Transaction& tx) {
+            return short_body(tx, send_id, recv_id);
+        });
+    }
+    /** Logical request stream of a worker, running its share of the worker's transactions on a scheduler.
+    **/
+    struct Stream {
+        ::std::minstd_rand engine;
+        ::std::bernoulli_distribution long_dist;
+        ::std::bernoulli_distribution alloc_dist;
+        ::std::gamma_distribution<float> alloc_trigger;
+        size_t count;     // Loosely-updated number of accounts
+        size_t remaining; // Number of transactions left to run
+    };
+    /** Spawn the next transaction of a stream, chosen as in 'run', if any is left.
+     * @param scheduler Scheduler of the worker
+     * @param stream    Stream
+     * @param error     Receives the error message if the transaction finds an inconsistency
+    **/
+    void spawn_next(TransactionScheduler& scheduler, Stream& stream, char const*& error) const {
+        if (stream.remaining == 0)
+            return;
+        --stream.remaining;
+        if (stream.long_dist(stream.engine)) {
+            scheduler.spawn(Transaction::Mode::read_only, [this, &stream](Transaction& tx) {
+                return long_body(tx, stream.count);
+            }, [this, &scheduler, &stream, &error](bool correct) {
+                if (unlikely(!correct))
+                    error = "Violated isolation or atomicity";
+                spawn_next(scheduler, stream, error);
+            });
+        } else if (stream.alloc_dist(stream.engine)) {
+            size_t trigger = stream.alloc_trigger(stream.engine);
+            scheduler.spawn(Transaction::Mode::read_write, [this, trigger](Transaction& tx) {
+                alloc_body(tx, trigger);
+                return true;
+            }, [this, &scheduler, &stream, &error](bool) {
+                spawn_next(scheduler, stream, error);
+            });
+        } else {
+            spawn_short(scheduler, stream, error);
+        }
+    }
+    /** Spawn a short transaction of a stream, spawned again with other accounts until they exist, as in 'run'.
+     * @param scheduler Scheduler of the worker
+     * @param stream    Stream
+     * @param error     Receives the error message if a transaction finds an inconsistency
+    **/
+    void spawn_short(TransactionScheduler& scheduler, Stream& stream, char const*& error) const {
+        ::std::uniform_int_distribution<size_t> account{0, stream.count - 1};
+        size_t send_id = account(stream.engine), recv_id = account(stream.engine);
+        scheduler.spawn(Transaction::Mode::read_write, [this, send_id, recv_id](Transaction& tx) {
+            return short_body(tx, send_id, recv_id);
+        }, [this, &scheduler, &stream, &error](bool done) {
+            if (unlikely(!done)) {
+                spawn_short(scheduler, stream, error);
+            } else {
+                spawn_next(scheduler, stream, error);
+            }
         });
     }
+#if defined(__cpp_impl_coroutine)
+    /** Run a body in an admitted transaction, as one attempt of 'transactional'.
+     * @param tx   Admitted transaction, 'STM::invalid_tx' if it could not begin
+     * @param mode Transactional mode
+     * @param body Transaction closure (Transaction& -> void)
+     * @return Whether the transaction committed
+    **/
+    template<class Body> bool attempt(STM::tx_t tx, Transaction::Mode mode, Body&& body) const {
+        if (unlikely(tx == STM::invalid_tx))
+            throw Exception::TransactionBegin{};
+        try {
+            Transaction transaction{tm, mode, tx};
+            body(transaction);
+        } catch (Exception::TransactionRetry const&) {
+            return false;
+        }
+        return true;
+    }
+    /** Coroutine of a stream, running its transactions as in 'run', suspended while each waits for its epoch.
+     * @param scheduler Scheduler of the worker
+     * @param stream    Stream
+     * @param error     Receives the error message if a transaction finds an inconsistency
+    **/
+    STM::tm_scheduler::task run_stream(STM::tm_scheduler& scheduler, Stream& stream, char const*& error) const {
+        for (; stream.remaining > 0; --stream.remaining) {
+            if (stream.long_dist(stream.engine)) {
+                bool correct = false;
+                while (!attempt(co_await scheduler.begin(true), Transaction::Mode::read_only, [&](Transaction& tx) {
+                    correct = long_body(tx, stream.count);
+                }));
+                if (unlikely(!correct))
+                    error = "Violated isolation or atomicity";
+            } else if (stream.alloc_dist(stream.engine)) {
+                size_t trigger = stream.alloc_trigger(stream.engine);
+                while (!attempt(co_await scheduler.begin(false), Transaction::Mode::read_write, [&](Transaction& tx) {
+                    alloc_body(tx, trigger);
+                }));
+            } else {
+                for (auto done = false; !done;) { // Other accounts until they exist
+                    ::std::uniform_int_distribution<size_t> account{0, stream.count - 1};
+                    size_t send_id = account(stream.engine), recv_id = account(stream.engine);
+                    while (!attempt(co_await scheduler.begin(false), Transaction::Mode::read_write, [&](Transaction& tx) {
+                        done = short_body(tx, send_id, recv_id);
+                    }));
+                }
+            }
+        }
+    }
+#endif
+    /** Run the worker's transactions as 'coroutines' interleaved streams, each waiting for its epochs without blocking the worker:
+     * one coroutine per stream when built as C++20, continuations on a 'TransactionScheduler' otherwise.
+     * @param seed Randomness source
+     * @return Constant null-terminated error message, 'nullptr' for none
+    **/
+    char const* run_streams(Seed seed) const {
+#if defined(__cpp_impl_coroutine)
+        auto scheduler = tm.scheduler();
+#else
+        TransactionScheduler scheduler{tm};
+#endif
+        ::std::vector<Stream> streams;
+        streams.reserve(coroutines); // Referenced by the spawned transactions
+        char const* error = nullptr;
+        for (size_t i = 0; i < coroutines; ++i) {
+            streams.push_back(Stream{::std::minstd_rand{static_cast<Seed>(seed + i)}, ::std::bernoulli_distribution{prob_long}, ::std::bernoulli_distribution{prob_alloc}, ::std::gamma_distribution<float>(expnbaccounts, 1), nbaccounts, nbtxperwrk / coroutines + (i < nbtxperwrk % coroutines ? 1 : 0)});
+#if defined(__cpp_impl_coroutine)
+            scheduler.spawn(run_stream(scheduler, streams.back(), error));
+#else
+            spawn_next(scheduler, streams.back(), error);
+#endif
+        }
+        scheduler.run();
+        if (unlikely(error))
+            return error;
+        size_t dummy; // Last long transaction
+        if (!long_tx(dummy))
+            return "Violated isolation or atomicity";
+        return nullptr;
+    }
 public:
     /**
      * Initialize the first segment of accounts and check the initial ballance (2 transactions).
@@ -298,6 +490,8 @@ public:
      * @param seed Randomness source
     **/
     virtual char const* run(Uid uid [[gnu::unused]], Seed seed) const {
+        if (coroutines > 1)
+            return run_streams(seed);
         ::std::minstd_rand engine{seed};
         ::std::bernoulli_distribution long_dist{prob_long};
         ::std::bernoulli_distribution alloc_dist{prob_alloc};
@@ -387,3 +581,49 @@ public:
         return nullptr;
     }
 };
+
+// -------------------------------------------------------------------------- //
+
+/** Sharded bank workload class: independent bank workloads, each with its own shared memory region and its own group of workers.
+**/
+class WorkloadShardedBank final: public Workload {
+private:
+    size_t nbregions; // Number of regions, worker 'uid' running on region 'uid % nbregions'
+    ::std::vector<::std::unique_ptr<WorkloadBank>> banks;
+public:
+    /** Sharded bank workload constructor, splitting the workers and the accounts evenly among the regions.
+     * @param library       Transactional library to use
+     * @param nbregions     Number of shared memory regions, at most the number of workers
+     * @param nbworkers     Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk    Number of transactions per worker
+     * @param nbaccounts    Initial number of accounts and number of accounts per segment, in total
+     * @param expnbaccounts Expected total number of accounts, in total
+     * @param init_balance  Initial account balance
+     * @param prob_long     Probability of running a long, read-only control transaction
+     * @param prob_alloc    Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+     * @param commutative   Whether transfers credit the receiver with a commutative add
+     * @param coroutines    Number of logical request streams each worker interleaves on a scheduler, 1 for none
+     * @param batched       Whether transfers read then write both balances with one vectored operation each
+    **/
+    WorkloadShardedBank(TransactionalLibrary const& library, size_t nbregions, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, WorkloadBank::Balance init_balance, float prob_long, float prob_alloc, bool commutative = false, size_t coroutines = 1, bool batched = false): nbregions{nbregions} {
+        for (size_t i = 0; i < nbregions; ++i) {
+            auto group = nbworkers / nbregions + (i < nbworkers % nbregions ? 1 : 0);
+            banks.emplace_back(new WorkloadBank{library, group, nbtxperwrk, ::std::max(nbaccounts * group / nbworkers, size_t{2}), ::std::max(expnbaccounts * group / nbworkers, size_t{2}), init_balance, prob_long, prob_alloc, commutative, coroutines, batched});
+        }
+    }
+public:
+    virtual char const* init() const {
+        for (auto&& bank: banks) {
+            auto error = bank->init();
+            if (unlikely(error))
+                return error;
+        }
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        return banks[uid % nbregions]->run(uid / nbregions, seed);
+    }
+    virtual char const* check(Uid uid, Seed seed) const {
+        return banks[uid % nbregions]->check(uid / nbregions, seed);
+    }
+};
@@ -28,8 +28,6 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
-#include <pthread.h>
-#include <semaphore.h>
 
 // -------------------------------------------------------------------------- //
 
@@ -62,47 +60,58 @@ bool     tm_write(shared_t, tx_t, void const*, size_t, void*);
 alloc_t  tm_alloc(shared_t, tx_t, size_t, void**);
 bool     tm_free(shared_t, tx_t, void*);
 
-// Added functions + structs
 
-typedef struct dual_memory_segment {
-    bool already_accessed; // use atomic operations to set this to true so that we avoid thread clashes
-    uint8_t* read_only;
-    uint8_t* read_write;
-} dual_memory_segment;
-
-
-typedef struct memory {
-    int nb_segments;
-    int segment_size; //The size of each segment is the same
-    pthread_mutex_t* lock;
-    dual_memory_segment* data; // Array of dual memory segments
-} memory;
-
-
-typedef struct batcher {
-    int count;
-    int remaining;
-    struct blocked_thread* blocked_threads_head;
-    struct blocked_thread* blocked_threads_tail;
-    pthread_mutex_t* enter_lock;
-} batcher;
-
-
-typedef struct blocked_thread {
-    int id;                          // Identifier for the thread
-    sem_t sem;                       // Semaphore for signaling
-    struct blocked_thread* next;     // Pointer to the next node
-} blocked_thread;
-
-
-memory* init_memory(void);
-void destroy_dual_memory_segment(dual_memory_segment* mem_seg);
-void destroy_memory(memory* mem);
-int allocate_segment(memory* mem); // Returns the index of the allocated segment
-
-void print_batcher(batcher* batcher);
-batcher* init_batcher(void);
-void destroy_batcher(batcher* batcher);
-void wake_up_threads(batcher* batcher);
-void enter_batcher(batcher* batcher, blocked_thread* blocked_thread);
-void leave_batcher(batcher* batcher);
\ No newline at end of file
+// -------------------------------------------------------------------------- //
+// Optional extensions: not every implementation provides them, look them up
+// with 'dlsym' when loading a library dynamically.
+
+// One entry of a vectored read or write: 'size' bytes at 'address' in the shared region, from or into 'buffer' in a private region
+typedef struct tm_vec {
+    void*  address;
+    size_t size;
+    void*  buffer;
+} tm_vec;
+
+// One range of the footprint of a static transaction: 'size' bytes at 'address' in the shared region
+typedef struct tm_range {
+    void const* address;
+    size_t      size;
+} tm_range;
+
+// What a transaction is expected to do, for the engine to prepare it: expected numbers of words read and written,
+// priority (positive to favor the transaction over its conflicts, negative to defer it, 0 for neither) and whether it is a long scan
+typedef struct tm_hints {
+    size_t reads;
+    size_t writes;
+    int    priority;
+    bool   long_scan;
+} tm_hints;
+
+// Body of a transaction run by 'tm_run', with the context given to it: returns false as soon as one of its operations fails, true to commit
+typedef bool (*tm_run_fn)(shared_t, tx_t, void*);
+
+tx_t     tm_begin_irrevocable(shared_t);
+bool     tm_read_elastic(shared_t, tx_t, void const*, size_t, void*);
+shared_t tm_create_shared(char const*, size_t, size_t, size_t);
+shared_t tm_attach(char const*);
+void     tm_detach(shared_t);
+shared_t tm_create_file(char const*, size_t, size_t, size_t);
+shared_t tm_open(char const*);
+void     tm_close(shared_t);
+bool     tm_checkpoint(shared_t, char const*);
+shared_t tm_restore(char const*);
+bool     tm_replicate(shared_t, int);
+shared_t tm_replica(int);
+bool     tm_readv(shared_t, tx_t, tm_vec const*, size_t);
+bool     tm_writev(shared_t, tx_t, tm_vec const*, size_t);
+bool     tm_copy(shared_t, tx_t, void const*, size_t, void*);
+bool     tm_fill(shared_t, tx_t, void*, size_t, unsigned char);
+bool     tm_add_i64(shared_t, tx_t, void*, int64_t);
+tx_t     tm_begin_static(shared_t, tm_range const*, size_t, tm_range const*, size_t);
+tx_t     tm_begin_ex(shared_t, bool, tm_hints const*);
+tx_t     tm_begin_timed(shared_t, bool, uint64_t);
+bool     tm_run(shared_t, bool, tm_run_fn, void*);
+bool     tm_run_ex(shared_t, bool, tm_hints const*, tm_run_fn, void*);
+tx_t     tm_begin_async(shared_t, bool, uint32_t*);
+bool     tm_admitted(shared_t, tx_t);
+uint32_t tm_wait_admission(shared_t, uint32_t*, uint32_t);
@@ -61,3 +61,236 @@ extern "C" {
     Alloc    tm_alloc(shared_t, tx_t, size_t, void**) noexcept;
     bool     tm_free(shared_t, tx_t, void*) noexcept;
 }
+
+// -------------------------------------------------------------------------- //
+// Optional extensions: not every implementation provides them, look them up
+// with 'dlsym' when loading a library dynamically.
+
+// One entry of a vectored read or write: 'size' bytes at 'address' in the shared region, from or into 'buffer' in a private region
+struct tm_vec {
+    void*  address;
+    size_t size;
+    void*  buffer;
+};
+
+// One range of the footprint of a static transaction: 'size' bytes at 'address' in the shared region
+struct tm_range {
+    void const* address;
+    size_t      size;
+};
+
+// What a transaction is expected to do, for the engine to prepare it: expected numbers of words read and written,
+// priority (positive to favor the transaction over its conflicts, negative to defer it, 0 for neither) and whether it is a long scan
+struct tm_hints {
+    size_t reads;
+    size_t writes;
+    int    priority;
+    bool   long_scan;
+};
+
+// Body of a transaction run by 'tm_run', with the context given to it: returns false as soon as one of its operations fails, true to commit
+using tm_run_fn = bool (*)(shared_t, tx_t, void*);
+
+extern "C" {
+    tx_t     tm_begin_irrevocable(shared_t) noexcept;
+    bool     tm_read_elastic(shared_t, tx_t, void const*, size_t, void*) noexcept;
+    shared_t tm_create_shared(char const*, size_t, size_t, size_t) noexcept;
+    shared_t tm_attach(char const*) noexcept;
+    void     tm_detach(shared_t) noexcept;
+    shared_t tm_create_file(char const*, size_t, size_t, size_t) noexcept;
+    shared_t tm_open(char const*) noexcept;
+    void     tm_close(shared_t) noexcept;
+    bool     tm_checkpoint(shared_t, char const*) noexcept;
+    shared_t tm_restore(char const*) noexcept;
+    bool     tm_replicate(shared_t, int) noexcept;
+    shared_t tm_replica(int) noexcept;
+    bool     tm_readv(shared_t, tx_t, tm_vec const*, size_t) noexcept;
+    bool     tm_writev(shared_t, tx_t, tm_vec const*, size_t) noexcept;
+    bool     tm_copy(shared_t, tx_t, void const*, size_t, void*) noexcept;
+    bool     tm_fill(shared_t, tx_t, void*, size_t, unsigned char) noexcept;
+    bool     tm_add_i64(shared_t, tx_t, void*, int64_t) noexcept;
+    tx_t     tm_begin_static(shared_t, tm_range const*, size_t, tm_range const*, size_t) noexcept;
+    tx_t     tm_begin_ex(shared_t, bool, tm_hints const*) noexcept;
+    tx_t     tm_begin_timed(shared_t, bool, uint64_t) noexcept;
+    bool     tm_run(shared_t, bool, tm_run_fn, void*) noexcept;
+    bool     tm_run_ex(shared_t, bool, tm_hints const*, tm_run_fn, void*) noexcept;
+    tx_t     tm_begin_async(shared_t, bool, uint32_t*) noexcept;
+    bool     tm_admitted(shared_t, tx_t) noexcept;
+    uint32_t tm_wait_admission(shared_t, uint32_t*, uint32_t) noexcept;
+}
+
+// -------------------------------------------------------------------------- //
+// Coroutine layer (C++20 only): 'co_await scheduler.begin(is_ro)' suspends the
+// calling coroutine until its transaction is admitted into an epoch, and the
+// scheduler resumes the coroutines of one thread as their transactions are
+// admitted, so that a few threads run many transactions waiting for epochs.
+
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <vector>
+
+class tm_scheduler {
+public:
+    // Functions the transactions wait for their epochs with: by default the linked 'tm_begin_async', 'tm_admitted',
+    // 'tm_wait_admission' and 'tm_end', or any functions behaving the same (e.g. loaded with 'dlsym')
+    struct functions {
+        tx_t     (*begin_async)(shared_t, bool, uint32_t*) noexcept = tm_begin_async;
+        bool     (*admitted)(shared_t, tx_t) noexcept = tm_admitted;
+        uint32_t (*wait_admission)(shared_t, uint32_t*, uint32_t) noexcept = tm_wait_admission;
+        bool     (*end)(shared_t, tx_t) noexcept = tm_end;
+    };
+    // Coroutine run by the scheduler, which owns it once spawned; an exception leaving it is rethrown by 'run',
+    // and must not leave a transaction it was given running
+    class task {
+    public:
+        struct promise_type {
+            ::std::exception_ptr error;
+            task get_return_object() noexcept { return task{::std::coroutine_handle<promise_type>::from_promise(*this)}; }
+            ::std::suspend_always initial_suspend() noexcept { return {}; }
+            ::std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { error = ::std::current_exception(); }
+        };
+        using handle = ::std::coroutine_handle<promise_type>;
+    private:
+        handle coroutine;
+        explicit task(handle coroutine) noexcept: coroutine{coroutine} {}
+        friend class tm_scheduler;
+    public:
+        task(task&& other) noexcept: coroutine{::std::exchange(other.coroutine, nullptr)} {}
+        task& operator=(task&&) = delete;
+        ~task() { if (coroutine) coroutine.destroy(); }
+    };
+    // Awaitable of 'begin': begins the transaction, suspends the coroutine until it is admitted, then gives its
+    // ID ('invalid_tx' if it could not begin), to run then end as one from 'tm_begin'
+    class admission {
+    private:
+        tm_scheduler& scheduler;
+        bool is_ro;
+        tx_t tx;
+    public:
+        admission(tm_scheduler& scheduler, bool is_ro) noexcept: scheduler{scheduler}, is_ro{is_ro}, tx{invalid_tx} {}
+        bool await_ready() noexcept {
+            tx = scheduler.fns.begin_async(scheduler.shared, is_ro, &scheduler.notify);
+            return tx == invalid_tx || scheduler.fns.admitted(scheduler.shared, tx);
+        }
+        void await_suspend(task::handle waiter) { scheduler.pending.push_back({tx, waiter}); }
+        tx_t await_resume() const noexcept { return tx; }
+    };
+private:
+    struct waiter {
+        tx_t tx; // Transaction the coroutine waits for, 'invalid_tx' for none
+        task::handle coroutine;
+    };
+    shared_t shared;
+    functions fns;
+    uint32_t notify; // Counter of the admissions, incremented by the library
+    uint32_t seen;   // Last value of the counter
+    ::std::vector<waiter> ready;    // Coroutines to resume, with their admitted transaction if any
+    ::std::vector<waiter> pending;  // Coroutines waiting for their transaction to be admitted
+    /** Resume a coroutine, then destroy it if it returned.
+     * @param coroutine Coroutine to resume
+    **/
+    void resume(task::handle coroutine) {
+        coroutine.resume();
+        if (!coroutine.done())
+            return;
+        auto error = coroutine.promise().error;
+        coroutine.destroy();
+        if (error)
+            ::std::rethrow_exception(error);
+    }
+    /** End the transactions of the coroutines not resumed yet, those pending once admitted, so that none of them
+     * holds its epoch open; the coroutines are left to the destructor.
+    **/
+    void cancel() noexcept {
+        for (auto& waiter: ready) {
+            if (waiter.tx != invalid_tx)
+                fns.end(shared, ::std::exchange(waiter.tx, invalid_tx)); // Commits nothing: the coroutine did not run
+        }
+        while (!pending.empty()) {
+            for (size_t i = 0; i < pending.size();) {
+                if (!fns.admitted(shared, pending[i].tx)) {
+                    ++i;
+                    continue;
+                }
+                fns.end(shared, ::std::exchange(pending[i].tx, invalid_tx));
+                ready.push_back(pending[i]);
+                pending[i] = pending.back();
+                pending.pop_back();
+            }
+            if (!pending.empty())
+                seen = fns.wait_admission(shared, &notify, seen);
+        }
+    }
+public:
+    /** Bind constructor.
+     * @param shared Shared memory region the transactions run on
+     * @param fns    Functions the transactions wait for their epochs with
+    **/
+    tm_scheduler(shared_t shared, functions fns): shared{shared}, fns{fns}, notify{0}, seen{0}, ready{}, pending{} {}
+    /** Bind constructor, for the linked functions.
+     * @param shared Shared memory region the transactions run on
+    **/
+    explicit tm_scheduler(shared_t shared): tm_scheduler{shared, functions{}} {}
+    tm_scheduler(tm_scheduler const&) = delete;
+    tm_scheduler& operator=(tm_scheduler const&) = delete;
+    /** Destroy the coroutines that did not return, which must have no admitted transaction.
+    **/
+    ~tm_scheduler() {
+        for (auto& waiter: ready)
+            waiter.coroutine.destroy();
+        for (auto& waiter: pending)
+            waiter.coroutine.destroy();
+    }
+    /** Begin a transaction, to 'co_await' in a task spawned on this scheduler. A transaction admitted into an epoch
+     * holds the epoch open until it ends, so the task must not suspend again before it ends its transaction.
+     * @param is_ro Whether the transaction is read-only
+     * @return Awaitable giving the admitted transaction
+    **/
+    admission begin(bool is_ro) noexcept {
+        return admission{*this, is_ro};
+    }
+    /** Take a task, started at the next 'run'.
+     * @param coroutine Task to run
+    **/
+    void spawn(task coroutine) {
+        ready.push_back({invalid_tx, ::std::exchange(coroutine.coroutine, nullptr)});
+    }
+    /** Run the spawned tasks until all of them returned: resume those whose transaction was admitted, and sleep
+     * until one is when none is. If a task throws, the transactions of the others are ended before it is rethrown.
+    **/
+    void run() {
+        while (!ready.empty() || !pending.empty()) {
+            for (size_t i = 0; i < pending.size();) {
+                if (!fns.admitted(shared, pending[i].tx)) {
+                    ++i;
+                    continue;
+                }
+                ready.push_back(pending[i]);
+                pending[i] = pending.back();
+                pending.pop_back();
+            }
+            if (ready.empty()) { // Every transaction waits for its epoch
+                seen = fns.wait_admission(shared, &notify, seen);
+                continue;
+            }
+            auto resumed = ::std::move(ready);
+            ready.clear();
+            for (size_t i = 0; i < resumed.size(); ++i) {
+                try {
+                    resume(resumed[i].coroutine);
+                } catch (...) {
+                    ready.insert(ready.end(), resumed.begin() + i + 1, resumed.end());
+                    cancel();
+                    throw;
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,555 @@
+/**
+ * @file   tm.c
+ * @author [...]
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * NOrec transaction manager: a single global sequence lock, a value log of the
+ * words read, validated by comparing values only when the sequence number moved,
+ * and buffered writes applied at commit time while holding the sequence lock.
+ * The words of the region carry no metadata at all.
+**/
+
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+#ifdef __STDC_NO_ATOMICS__
+    #error Current C11 compiler does not support atomic operations
+#endif
+
+// External headers
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Internal headers
+#include <tm.h>
+#include "macros.h"
+
+// Size of a cache line (in bytes), to keep the sequence lock and each reader slot on its own line
+#define CACHE_LINE    64
+// Number of transactions that can run at the same time (more wait for a slot)
+#define READER_SLOTS  256
+// Value of an unused reader slot
+#define SLOT_IDLE     UINT64_MAX
+
+/**
+ * @brief Snapshot of a running transaction, so that freed segments are only released once no transaction can still read them.
+ */
+typedef struct reader_slot {
+    _Atomic(uint64_t) snapshot;
+} __attribute__((aligned(CACHE_LINE))) reader_slot;
+
+/**
+ * @brief Header of a segment allocated by 'tm_alloc', followed by its words.
+ */
+typedef struct segment {
+    struct segment* prev;
+    struct segment* next;
+    uint64_t freed_at;                  // Sequence number published by the transaction that freed it, once in limbo
+} segment;
+
+/**
+ * @brief Shared memory region.
+ */
+typedef struct region {
+    _Atomic(uint64_t) seq __attribute__((aligned(CACHE_LINE))); // Sequence lock: odd while a transaction writes back
+    reader_slot slots[READER_SLOTS];
+    pthread_mutex_t segments_lock;      // Protects the two lists below
+    segment* segments;                  // Allocated segments
+    segment* limbo;                     // Segments freed by committed transactions, not released yet
+    void* start;
+    size_t size;
+    size_t align;
+    size_t segment_align;               // Alignment of the segments, at least that of a pointer
+    size_t header;                      // Size of a segment header, rounded up to the segment alignment
+} region;
+
+/**
+ * @brief Transaction descriptor. The opaque 'tx_t' is the address of this structure.
+ */
+typedef struct transaction {
+    bool is_ro;
+    uint64_t snapshot;                  // Even sequence number at which all the reads are known consistent
+    int slot;                           // Reader slot
+
+    void const** reads;                 // Words read, outside of the write buffer
+    uint8_t* read_values;               // Value seen by each read, 'align' bytes each
+    size_t nb_reads;
+    size_t reads_capacity;
+
+    void** writes;                      // Words written
+    uint8_t* values;                    // Value of each buffered write, 'align' bytes each
+    size_t nb_writes;
+    size_t writes_capacity;
+    size_t* index;                      // Open addressing index of the writes by address: write index + 1, 0 if empty
+    size_t index_capacity;              // Power of 2, at least twice the number of writes
+
+    segment** allocs;                   // Segments allocated (released if aborted)
+    size_t nb_allocs;
+    size_t allocs_capacity;
+    segment** frees;                    // Segments to free if committed
+    size_t nb_frees;
+    size_t frees_capacity;
+} transaction;
+
+// Reader slot last taken by the calling thread, tried first
+static _Thread_local unsigned int slot_hint = 0;
+
+/* HELPERS */
+
+/**
+ * @brief Grows a dynamic array so that it can hold at least one more element.
+ * @return Whether the operation is a success
+ */
+static bool reserve_one(void** array, size_t* capacity, size_t count, size_t elem_size) {
+    if (likely(count < *capacity)) return true;
+    size_t new_capacity = *capacity == 0 ? 16 : 2 * *capacity;
+    void* new_array = realloc(*array, new_capacity * elem_size);
+    if (unlikely(new_array == NULL)) return false;
+    *array = new_array;
+    *capacity = new_capacity;
+    return true;
+}
+
+/**
+ * @brief Grows a log of addresses together with its array of word values.
+ * @return Whether the operation is a success
+ */
+static bool reserve_logged(region* reg, void** addrs, uint8_t** values, size_t* capacity, size_t count) {
+    size_t old_capacity = *capacity;
+    if (unlikely(!reserve_one(addrs, capacity, count, sizeof(void*))))
+        return false;
+    if (*capacity != old_capacity) {
+        uint8_t* new_values = (uint8_t*) realloc(*values, *capacity * reg->align);
+        if (unlikely(new_values == NULL)) return false;
+        *values = new_values;
+    }
+    return true;
+}
+
+static inline size_t hash_word(region* reg, void const* addr) {
+    return (size_t) (((uintptr_t) addr / reg->align) * UINT64_C(0x9E3779B97F4A7C15) >> 16);
+}
+
+/**
+ * @brief Finds the buffered write of a word.
+ * @return Index of the write, or the number of writes if the word was not written
+ */
+static size_t find_write(region* reg, transaction* tx, void const* addr) {
+    if (tx->nb_writes == 0)
+        return 0;
+    size_t mask = tx->index_capacity - 1;
+    for (size_t i = hash_word(reg, addr) & mask; tx->index[i] != 0; i = (i + 1) & mask) {
+        if (tx->writes[tx->index[i] - 1] == addr)
+            return tx->index[i] - 1;
+    }
+    return tx->nb_writes;
+}
+
+/**
+ * @brief Rebuilds the write index with twice its capacity.
+ * @return Whether the operation is a success
+ */
+static bool grow_index(region* reg, transaction* tx) {
+    size_t capacity = tx->index_capacity == 0 ? 32 : 2 * tx->index_capacity;
+    size_t* index = (size_t*) calloc(capacity, sizeof(size_t));
+    if (unlikely(index == NULL)) return false;
+    for (size_t w = 0; w < tx->nb_writes; w++) {
+        size_t i = hash_word(reg, tx->writes[w]) & (capacity - 1);
+        while (index[i] != 0)
+            i = (i + 1) & (capacity - 1);
+        index[i] = w + 1;
+    }
+    free(tx->index);
+    tx->index = index;
+    tx->index_capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Waits for the sequence lock to be free.
+ * @return The (even) sequence number
+ */
+static uint64_t wait_even(region* reg) {
+    uint64_t seq = atomic_load_explicit(&reg->seq, memory_order_acquire);
+    while (unlikely(seq & 1)) {
+        sched_yield(); // Write back in progress
+        seq = atomic_load_explicit(&reg->seq, memory_order_acquire);
+    }
+    return seq;
+}
+
+/* SEGMENTS */
+
+static void link_segment(segment** list, segment* seg) {
+    seg->prev = NULL;
+    seg->next = *list;
+    if (seg->next != NULL) seg->next->prev = seg;
+    *list = seg;
+}
+
+static void unlink_segment(segment** list, segment* seg) {
+    if (seg->prev != NULL) seg->prev->next = seg->next;
+    else *list = seg->next;
+    if (seg->next != NULL) seg->next->prev = seg->prev;
+}
+
+/**
+ * @brief Releases the segments in limbo that no running transaction can read anymore. Must be called with the segments lock held.
+ *
+ * A transaction whose snapshot is at least the sequence number published by a free
+ * started after the segment was unlinked, hence cannot reach it.
+ */
+static void reclaim_limbo(region* reg) {
+    uint64_t oldest = SLOT_IDLE;
+    for (int s = 0; s < READER_SLOTS; s++) {
+        uint64_t snapshot = atomic_load(&reg->slots[s].snapshot);
+        if (snapshot < oldest) oldest = snapshot;
+    }
+    segment* seg = reg->limbo;
+    while (seg != NULL) {
+        segment* next = seg->next;
+        if (seg->freed_at <= oldest) {
+            unlink_segment(&reg->limbo, seg);
+            free(seg);
+        }
+        seg = next;
+    }
+}
+
+/* TRANSACTIONS */
+
+static void destroy_transaction(region* reg, transaction* tx) {
+    atomic_store_explicit(&reg->slots[tx->slot].snapshot, SLOT_IDLE, memory_order_release);
+    free(tx->reads);
+    free(tx->read_values);
+    free(tx->writes);
+    free(tx->values);
+    free(tx->index);
+    free(tx->allocs);
+    free(tx->frees);
+    free(tx);
+}
+
+/**
+ * @brief Aborts a transaction: releases the segments it allocated.
+ * @return false, for the caller to return
+ */
+static bool abort_transaction(region* reg, transaction* tx) {
+    if (tx->nb_allocs > 0) {
+        pthread_mutex_lock(&reg->segments_lock);
+        for (size_t i = 0; i < tx->nb_allocs; i++) {
+            unlink_segment(&reg->segments, tx->allocs[i]);
+            free(tx->allocs[i]);
+        }
+        pthread_mutex_unlock(&reg->segments_lock);
+    }
+    destroy_transaction(reg, tx);
+    return false;
+}
+
+/**
+ * @brief Checks that every word read still holds the value the transaction saw, and moves the snapshot to the current sequence number.
+ * @return Whether the reads are still consistent
+ */
+static bool validate(region* reg, transaction* tx) {
+    while (true) {
+        uint64_t seq = wait_even(reg);
+        for (size_t i = 0; i < tx->nb_reads; i++) {
+            if (memcmp(tx->reads[i], tx->read_values + i * reg->align, reg->align) != 0)
+                return false;
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&reg->seq, memory_order_relaxed) == seq) {
+            tx->snapshot = seq;
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief Reads one word, consistent with the snapshot of the transaction, and logs its value.
+ * @return Whether the transaction can continue
+ */
+static bool read_word(region* reg, transaction* tx, void const* addr, void* target) {
+    if (unlikely(!reserve_logged(reg, (void**) &tx->reads, &tx->read_values, &tx->reads_capacity, tx->nb_reads)))
+        return false;
+    memcpy(target, addr, reg->align);
+    atomic_thread_fence(memory_order_acquire);
+    while (atomic_load_explicit(&reg->seq, memory_order_relaxed) != tx->snapshot) {
+        if (!validate(reg, tx))
+            return false;
+        memcpy(target, addr, reg->align);
+        atomic_thread_fence(memory_order_acquire);
+    }
+    tx->reads[tx->nb_reads] = addr;
+    memcpy(tx->read_values + tx->nb_reads * reg->align, target, reg->align);
+    tx->nb_reads++;
+    return true;
+}
+
+/**
+ * @brief Buffers the write of one word.
+ * @return Whether the transaction can continue
+ */
+static bool write_word(region* reg, transaction* tx, void const* source, void* addr) {
+    size_t w = find_write(reg, tx, addr);
+    if (w == tx->nb_writes) {
+        if (unlikely(!reserve_logged(reg, (void**) &tx->writes, &tx->values, &tx->writes_capacity, tx->nb_writes)))
+            return false;
+        if (2 * (tx->nb_writes + 1) > tx->index_capacity && unlikely(!grow_index(reg, tx)))
+            return false;
+        tx->writes[w] = addr;
+        tx->nb_writes++;
+        size_t mask = tx->index_capacity - 1;
+        size_t i = hash_word(reg, addr) & mask;
+        while (tx->index[i] != 0)
+            i = (i + 1) & mask;
+        tx->index[i] = w + 1;
+    }
+    memcpy(tx->values + w * reg->align, source, reg->align);
+    return true;
+}
+
+/**
+ * @brief Commits a transaction that wrote or freed: takes the sequence lock at the snapshot, revalidating if it moved, and writes back.
+ * @return Whether the transaction committed
+ */
+static bool commit(region* reg, transaction* tx) {
+    uint64_t expected = tx->snapshot;
+    while (!atomic_compare_exchange_weak_explicit(&reg->seq, &expected, tx->snapshot + 1, memory_order_acquire, memory_order_relaxed)) {
+        if (!validate(reg, tx))
+            return abort_transaction(reg, tx);
+        expected = tx->snapshot;
+    }
+
+    for (size_t i = 0; i < tx->nb_writes; i++)
+        memcpy(tx->writes[i], tx->values + i * reg->align, reg->align);
+    uint64_t published = tx->snapshot + 2;
+    atomic_store_explicit(&reg->seq, published, memory_order_release);
+
+    if (tx->nb_frees > 0) {
+        pthread_mutex_lock(&reg->segments_lock);
+        for (size_t i = 0; i < tx->nb_frees; i++) {
+            segment* seg = tx->frees[i];
+            unlink_segment(&reg->segments, seg);
+            seg->freed_at = published;
+            link_segment(&reg->limbo, seg);
+        }
+        reclaim_limbo(reg);
+        pthread_mutex_unlock(&reg->segments_lock);
+    }
+    return true;
+}
+
+/* STM PART */
+
+/** Create (i.e. allocate + init) a new shared memory region, with one first non-free-able allocated segment of the requested size and alignment.
+ * @param size  Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
+ * @param align Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_create(size_t size, size_t align) {
+    if (size == 0 || align == 0 || (align & (align - 1)) != 0 || size % align != 0) return invalid_shared;
+
+    region* reg;
+    if (unlikely(posix_memalign((void**) &reg, CACHE_LINE, sizeof(region)) != 0)) return invalid_shared;
+    size_t start_align = align < sizeof(void*) ? sizeof(void*) : align;
+    if (unlikely(posix_memalign(&reg->start, start_align, size) != 0)) {
+        free(reg);
+        return invalid_shared;
+    }
+    if (unlikely(pthread_mutex_init(&reg->segments_lock, NULL) != 0)) {
+        free(reg->start);
+        free(reg);
+        return invalid_shared;
+    }
+    memset(reg->start, 0, size);
+    atomic_init(&reg->seq, 0);
+    for (size_t i = 0; i < READER_SLOTS; i++)
+        atomic_init(&reg->slots[i].snapshot, SLOT_IDLE);
+    reg->segments = NULL;
+    reg->limbo = NULL;
+    reg->size = size;
+    reg->align = align;
+    reg->segment_align = start_align;
+    reg->header = (sizeof(segment) + start_align - 1) / start_align * start_align;
+    return reg;
+}
+
+/** Destroy (i.e. clean-up + free) a given shared memory region.
+ * @param shared Shared memory region to destroy, with no running transaction
+**/
+void tm_destroy(shared_t shared) {
+    region* reg = (region*) shared;
+    segment* lists[] = { reg->segments, reg->limbo };
+    for (size_t l = 0; l < sizeof(lists) / sizeof(lists[0]); l++) {
+        while (lists[l] != NULL) {
+            segment* next = lists[l]->next;
+            free(lists[l]);
+            lists[l] = next;
+        }
+    }
+    pthread_mutex_destroy(&reg->segments_lock);
+    free(reg->start);
+    free(reg);
+}
+
+/** [thread-safe] Return the start address of the first allocated segment in the shared memory region.
+ * @param shared Shared memory region to query
+ * @return Start address of the first allocated segment
+**/
+void* tm_start(shared_t shared) {
+    return ((region*) shared)->start;
+}
+
+/** [thread-safe] Return the size (in bytes) of the first allocated segment of the shared memory region.
+ * @param shared Shared memory region to query
+ * @return First allocated segment size
+**/
+size_t tm_size(shared_t shared) {
+    return ((region*) shared)->size;
+}
+
+/** [thread-safe] Return the alignment (in bytes) of the memory accesses on the given shared memory region.
+ * @param shared Shared memory region to query
+ * @return Alignment used globally
+**/
+size_t tm_align(shared_t shared) {
+    return ((region*) shared)->align;
+}
+
+/** [thread-safe] Begin a new transaction on the given shared memory region.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+**/
+tx_t tm_begin(shared_t shared, bool is_ro) {
+    region* reg = (region*) shared;
+    transaction* tx = (transaction*) calloc(1, sizeof(transaction));
+    if (unlikely(tx == NULL)) return invalid_tx;
+    tx->is_ro = is_ro;
+
+    // Publish a placeholder before reading the sequence number, so that a concurrent reclamation cannot miss this transaction
+    for (unsigned int s = slot_hint; ; s = (s + 1) % READER_SLOTS) {
+        uint64_t idle = SLOT_IDLE;
+        if (atomic_compare_exchange_weak(&reg->slots[s].snapshot, &idle, 0)) {
+            tx->slot = (int) s;
+            slot_hint = s;
+            break;
+        }
+    }
+    tx->snapshot = wait_even(reg);
+    atomic_store(&reg->slots[tx->slot].snapshot, tx->snapshot);
+    return (tx_t) tx;
+}
+
+/** [thread-safe] End the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to end
+ * @return Whether the whole transaction committed
+**/
+bool tm_end(shared_t shared, tx_t tx) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (t->nb_writes > 0 || t->nb_frees > 0) {
+        if (!commit(reg, t))
+            return false;
+    }
+    destroy_transaction(reg, t);
+    return true;
+}
+
+/** [thread-safe] Read operation in the given transaction, source in the shared region and target in a private region.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in a private region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    size_t align = reg->align;
+    for (size_t offset = 0; offset < size; offset += align) {
+        void const* addr = (uint8_t const*) source + offset;
+        size_t w = find_write(reg, t, addr);
+        if (w < t->nb_writes) { // Read after write
+            memcpy((uint8_t*) target + offset, t->values + w * align, align);
+            continue;
+        }
+        if (unlikely(!read_word(reg, t, addr, (uint8_t*) target + offset)))
+            return abort_transaction(reg, t);
+    }
+    return true;
+}
+
+/** [thread-safe] Write operation in the given transaction, source in a private region and target in the shared region.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in a private region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in the shared region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (unlikely(t->is_ro))
+        return abort_transaction(reg, t);
+    for (size_t offset = 0; offset < size; offset += reg->align) {
+        if (unlikely(!write_word(reg, t, (uint8_t const*) source + offset, (uint8_t*) target + offset)))
+            return abort_transaction(reg, t);
+    }
+    return true;
+}
+
+/** [thread-safe] Memory allocation in the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param size   Allocation requested size (in bytes), must be a positive multiple of the alignment
+ * @param target Pointer in private memory receiving the address of the first byte of the newly allocated, aligned segment
+ * @return Whether the whole transaction can continue (success/nomem), or not (abort_alloc)
+**/
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void** target) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (unlikely(!reserve_one((void**) &t->allocs, &t->allocs_capacity, t->nb_allocs, sizeof(segment*))))
+        return nomem_alloc;
+    segment* seg;
+    if (unlikely(posix_memalign((void**) &seg, reg->segment_align, reg->header + size) != 0))
+        return nomem_alloc;
+    memset((uint8_t*) seg + reg->header, 0, size);
+    pthread_mutex_lock(&reg->segments_lock);
+    link_segment(&reg->segments, seg);
+    pthread_mutex_unlock(&reg->segments_lock);
+    t->allocs[t->nb_allocs++] = seg;
+    *target = (uint8_t*) seg + reg->header;
+    return success_alloc;
+}
+
+/** [thread-safe] Memory freeing in the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Address of the first byte of the previously allocated segment to deallocate
+ * @return Whether the whole transaction can continue
+**/
+bool tm_free(shared_t shared, tx_t tx, void* target) {
+    region* reg = (region*) shared;
+    transaction* t = (transaction*) tx;
+    if (unlikely(target == reg->start || !reserve_one((void**) &t->frees, &t->frees_capacity, t->nb_frees, sizeof(segment*))))
+        return abort_transaction(reg, t);
+    t->frees[t->nb_frees++] = (segment*) ((uint8_t*) target - reg->header);
+    return true;
+}
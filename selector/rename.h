@@ -0,0 +1,51 @@
+/**
+ * @file   rename.h
+ * @author [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Forced include of every engine source linked in the library: prefixes the
+ * names of the API functions with 'TM_PREFIX', so that the engines can coexist.
+**/
+
+#pragma once
+
+#define TM_RENAME_(prefix, name) prefix##name
+#define TM_RENAME(prefix, name)  TM_RENAME_(prefix, name)
+
+#define tm_create            TM_RENAME(TM_PREFIX, tm_create)
+#define tm_destroy           TM_RENAME(TM_PREFIX, tm_destroy)
+#define tm_start             TM_RENAME(TM_PREFIX, tm_start)
+#define tm_size              TM_RENAME(TM_PREFIX, tm_size)
+#define tm_align             TM_RENAME(TM_PREFIX, tm_align)
+#define tm_begin             TM_RENAME(TM_PREFIX, tm_begin)
+#define tm_end               TM_RENAME(TM_PREFIX, tm_end)
+#define tm_read              TM_RENAME(TM_PREFIX, tm_read)
+#define tm_write             TM_RENAME(TM_PREFIX, tm_write)
+#define tm_alloc             TM_RENAME(TM_PREFIX, tm_alloc)
+#define tm_free              TM_RENAME(TM_PREFIX, tm_free)
+#define tm_begin_irrevocable TM_RENAME(TM_PREFIX, tm_begin_irrevocable)
+#define tm_read_elastic      TM_RENAME(TM_PREFIX, tm_read_elastic)
+#define tm_create_shared     TM_RENAME(TM_PREFIX, tm_create_shared)
+#define tm_attach            TM_RENAME(TM_PREFIX, tm_attach)
+#define tm_detach            TM_RENAME(TM_PREFIX, tm_detach)
+#define tm_create_file       TM_RENAME(TM_PREFIX, tm_create_file)
+#define tm_open              TM_RENAME(TM_PREFIX, tm_open)
+#define tm_close             TM_RENAME(TM_PREFIX, tm_close)
+#define tm_checkpoint        TM_RENAME(TM_PREFIX, tm_checkpoint)
+#define tm_restore           TM_RENAME(TM_PREFIX, tm_restore)
+#define tm_replicate         TM_RENAME(TM_PREFIX, tm_replicate)
+#define tm_replica           TM_RENAME(TM_PREFIX, tm_replica)
+#define tm_readv             TM_RENAME(TM_PREFIX, tm_readv)
+#define tm_writev            TM_RENAME(TM_PREFIX, tm_writev)
+#define tm_copy              TM_RENAME(TM_PREFIX, tm_copy)
+#define tm_fill              TM_RENAME(TM_PREFIX, tm_fill)
+#define tm_add_i64           TM_RENAME(TM_PREFIX, tm_add_i64)
+#define tm_begin_static      TM_RENAME(TM_PREFIX, tm_begin_static)
+#define tm_begin_ex          TM_RENAME(TM_PREFIX, tm_begin_ex)
+#define tm_begin_timed       TM_RENAME(TM_PREFIX, tm_begin_timed)
+#define tm_run               TM_RENAME(TM_PREFIX, tm_run)
+#define tm_run_ex            TM_RENAME(TM_PREFIX, tm_run_ex)
+#define tm_begin_async       TM_RENAME(TM_PREFIX, tm_begin_async)
+#define tm_admitted          TM_RENAME(TM_PREFIX, tm_admitted)
+#define tm_wait_admission    TM_RENAME(TM_PREFIX, tm_wait_admission)
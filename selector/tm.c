@@ -0,0 +1,744 @@
+/**
+ * @file   tm.c
+ * @author [...]
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Transaction manager that runs one of the engines linked in the library, chosen
+ * per region at 'tm_create' time with the TM_ENGINE environment variable ('dv' by
+ * default). Every call goes through the table of functions copied in the region.
+**/
+
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+
+// External headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Internal headers
+#include <tm.h>
+#include "macros.h"
+
+/**
+ * @brief Functions of an engine.
+ */
+typedef struct engine {
+    char const* name;
+    shared_t (*create)(size_t, size_t);
+    void     (*destroy)(shared_t);
+    void*    (*start)(shared_t);
+    size_t   (*size)(shared_t);
+    size_t   (*align)(shared_t);
+    tx_t     (*begin)(shared_t, bool);
+    bool     (*end)(shared_t, tx_t);
+    bool     (*read)(shared_t, tx_t, void const*, size_t, void*);
+    bool     (*write)(shared_t, tx_t, void const*, size_t, void*);
+    alloc_t  (*alloc)(shared_t, tx_t, size_t, void**);
+    bool     (*free)(shared_t, tx_t, void*);
+    tx_t     (*begin_irrevocable)(shared_t);                              // NULL if not provided
+    bool     (*read_elastic)(shared_t, tx_t, void const*, size_t, void*); // NULL if not provided
+    bool     (*readv)(shared_t, tx_t, tm_vec const*, size_t);            // NULL if not provided
+    bool     (*writev)(shared_t, tx_t, tm_vec const*, size_t);           // NULL if not provided
+    bool     (*copy)(shared_t, tx_t, void const*, size_t, void*);         // NULL if not provided
+    bool     (*fill)(shared_t, tx_t, void*, size_t, unsigned char);       // NULL if not provided
+    bool     (*add_i64)(shared_t, tx_t, void*, int64_t);                  // NULL if not provided
+    tx_t     (*begin_static)(shared_t, tm_range const*, size_t, tm_range const*, size_t); // NULL if not provided
+    tx_t     (*begin_ex)(shared_t, bool, tm_hints const*);                // NULL if not provided
+    tx_t     (*begin_timed)(shared_t, bool, uint64_t);                    // NULL if not provided
+    bool     (*run)(shared_t, bool, tm_run_fn, void*);                    // NULL if not provided
+    bool     (*run_ex)(shared_t, bool, tm_hints const*, tm_run_fn, void*); // NULL if not provided
+    tx_t     (*begin_async)(shared_t, bool, uint32_t*);                   // NULL if not provided, like the next two
+    bool     (*admitted)(shared_t, tx_t);
+    uint32_t (*wait_admission)(shared_t, uint32_t*, uint32_t);
+    shared_t (*create_shared)(char const*, size_t, size_t, size_t);      // NULL if not provided, like the next two
+    shared_t (*attach)(char const*);
+    void     (*detach)(shared_t);
+    shared_t (*create_file)(char const*, size_t, size_t, size_t);        // NULL if not provided, like the next two
+    shared_t (*open)(char const*);
+    void     (*close)(shared_t);
+    bool     (*checkpoint)(shared_t, char const*);                        // NULL if not provided, like the next one
+    shared_t (*restore)(char const*);
+    bool     (*replicate)(shared_t, int);                                 // NULL if not provided, like the next one
+    shared_t (*replica)(int);
+} engine;
+
+#define DECLARE_ENGINE(prefix) \
+    shared_t prefix##_tm_create(size_t, size_t); \
+    void     prefix##_tm_destroy(shared_t); \
+    void*    prefix##_tm_start(shared_t); \
+    size_t   prefix##_tm_size(shared_t); \
+    size_t   prefix##_tm_align(shared_t); \
+    tx_t     prefix##_tm_begin(shared_t, bool); \
+    bool     prefix##_tm_end(shared_t, tx_t); \
+    bool     prefix##_tm_read(shared_t, tx_t, void const*, size_t, void*); \
+    bool     prefix##_tm_write(shared_t, tx_t, void const*, size_t, void*); \
+    alloc_t  prefix##_tm_alloc(shared_t, tx_t, size_t, void**); \
+    bool     prefix##_tm_free(shared_t, tx_t, void*);
+
+#define ENGINE(prefix, ...) { \
+    .name = #prefix, \
+    .create = prefix##_tm_create, \
+    .destroy = prefix##_tm_destroy, \
+    .start = prefix##_tm_start, \
+    .size = prefix##_tm_size, \
+    .align = prefix##_tm_align, \
+    .begin = prefix##_tm_begin, \
+    .end = prefix##_tm_end, \
+    .read = prefix##_tm_read, \
+    .write = prefix##_tm_write, \
+    .alloc = prefix##_tm_alloc, \
+    .free = prefix##_tm_free, \
+    __VA_ARGS__ \
+}
+
+DECLARE_ENGINE(dv)
+DECLARE_ENGINE(rwlock)
+DECLARE_ENGINE(tl2)
+DECLARE_ENGINE(norec)
+DECLARE_ENGINE(etl)
+tx_t dv_tm_begin_irrevocable(shared_t);
+bool dv_tm_read_elastic(shared_t, tx_t, void const*, size_t, void*);
+bool dv_tm_readv(shared_t, tx_t, tm_vec const*, size_t);
+bool dv_tm_writev(shared_t, tx_t, tm_vec const*, size_t);
+bool dv_tm_copy(shared_t, tx_t, void const*, size_t, void*);
+bool dv_tm_fill(shared_t, tx_t, void*, size_t, unsigned char);
+bool dv_tm_add_i64(shared_t, tx_t, void*, int64_t);
+tx_t dv_tm_begin_static(shared_t, tm_range const*, size_t, tm_range const*, size_t);
+tx_t dv_tm_begin_ex(shared_t, bool, tm_hints const*);
+tx_t dv_tm_begin_timed(shared_t, bool, uint64_t);
+bool dv_tm_run(shared_t, bool, tm_run_fn, void*);
+bool dv_tm_run_ex(shared_t, bool, tm_hints const*, tm_run_fn, void*);
+tx_t dv_tm_begin_async(shared_t, bool, uint32_t*);
+bool dv_tm_admitted(shared_t, tx_t);
+uint32_t dv_tm_wait_admission(shared_t, uint32_t*, uint32_t);
+shared_t dv_tm_create_shared(char const*, size_t, size_t, size_t);
+shared_t dv_tm_attach(char const*);
+void dv_tm_detach(shared_t);
+shared_t dv_tm_create_file(char const*, size_t, size_t, size_t);
+shared_t dv_tm_open(char const*);
+void dv_tm_close(shared_t);
+bool dv_tm_checkpoint(shared_t, char const*);
+shared_t dv_tm_restore(char const*);
+bool dv_tm_replicate(shared_t, int);
+shared_t dv_tm_replica(int);
+
+// Engines that can be selected, the first one is the default
+static engine const engines[] = {
+    ENGINE(dv, .begin_irrevocable = dv_tm_begin_irrevocable, .read_elastic = dv_tm_read_elastic,
+        .readv = dv_tm_readv, .writev = dv_tm_writev, .copy = dv_tm_copy, .fill = dv_tm_fill,
+        .add_i64 = dv_tm_add_i64, .begin_static = dv_tm_begin_static, .begin_ex = dv_tm_begin_ex,
+        .begin_timed = dv_tm_begin_timed, .run = dv_tm_run, .run_ex = dv_tm_run_ex,
+        .begin_async = dv_tm_begin_async, .admitted = dv_tm_admitted,
+        .wait_admission = dv_tm_wait_admission, .create_shared = dv_tm_create_shared, .attach = dv_tm_attach,
+        .detach = dv_tm_detach, .create_file = dv_tm_create_file, .open = dv_tm_open, .close = dv_tm_close,
+        .checkpoint = dv_tm_checkpoint, .restore = dv_tm_restore, .replicate = dv_tm_replicate, .replica = dv_tm_replica),
+    ENGINE(rwlock),
+    ENGINE(tl2),
+    ENGINE(norec),
+    ENGINE(etl),
+};
+
+/**
+ * @brief Shared memory region: the functions of its engine, and the region of the engine.
+ */
+typedef struct region {
+    engine ops;
+    shared_t inner;
+} region;
+
+/**
+ * @brief Finds the engine named by the TM_ENGINE environment variable.
+ * @return The engine, NULL if the name is unknown
+ */
+static engine const* select_engine(void) {
+    char const* name = getenv("TM_ENGINE");
+    if (name == NULL || *name == '\0')
+        return &engines[0];
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        if (strcmp(engines[i].name, name) == 0)
+            return &engines[i];
+    }
+    fprintf(stderr, "Unknown engine '%s' in TM_ENGINE\n", name);
+    return NULL;
+}
+
+/**
+ * @brief Allocates a region of the selector for a region of the given engine, not created yet.
+ * @return The region, NULL on failure
+ */
+static region* new_region(engine const* ops) {
+    region* reg = (region*) malloc(sizeof(region));
+    if (unlikely(reg == NULL)) return NULL;
+    reg->ops = *ops;
+    reg->inner = invalid_shared;
+    return reg;
+}
+
+/**
+ * @brief Returns a region whose region of the engine was just created, freeing it if that failed.
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+ */
+static shared_t finish_region(region* reg) {
+    if (reg->inner == invalid_shared) {
+        free(reg);
+        return invalid_shared;
+    }
+    return reg;
+}
+
+/** Create (i.e. allocate + init) a new shared memory region, with one first non-free-able allocated segment of the requested size and alignment.
+ * @param size  Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
+ * @param align Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_create(size_t size, size_t align) {
+    engine const* ops = select_engine();
+    if (ops == NULL) return invalid_shared;
+    region* reg = new_region(ops);
+    if (unlikely(reg == NULL)) return invalid_shared;
+    reg->inner = ops->create(size, align);
+    return finish_region(reg);
+}
+
+/** Destroy (i.e. clean-up + free) a given shared memory region.
+ * @param shared Shared memory region to destroy, with no running transaction
+**/
+void tm_destroy(shared_t shared) {
+    region* reg = (region*) shared;
+    reg->ops.destroy(reg->inner);
+    free(reg);
+}
+
+/** [thread-safe] Return the start address of the first allocated segment in the shared memory region.
+ * @param shared Shared memory region to query
+ * @return Start address of the first allocated segment
+**/
+void* tm_start(shared_t shared) {
+    region* reg = (region*) shared;
+    return reg->ops.start(reg->inner);
+}
+
+/** [thread-safe] Return the size (in bytes) of the first allocated segment of the shared memory region.
+ * @param shared Shared memory region to query
+ * @return First allocated segment size
+**/
+size_t tm_size(shared_t shared) {
+    region* reg = (region*) shared;
+    return reg->ops.size(reg->inner);
+}
+
+/** [thread-safe] Return the alignment (in bytes) of the memory accesses on the given shared memory region.
+ * @param shared Shared memory region to query
+ * @return Alignment used globally
+**/
+size_t tm_align(shared_t shared) {
+    region* reg = (region*) shared;
+    return reg->ops.align(reg->inner);
+}
+
+/** [thread-safe] Begin a new transaction on the given shared memory region.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+**/
+tx_t tm_begin(shared_t shared, bool is_ro) {
+    region* reg = (region*) shared;
+    return reg->ops.begin(reg->inner, is_ro);
+}
+
+/** [thread-safe] End the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to end
+ * @return Whether the whole transaction committed
+**/
+bool tm_end(shared_t shared, tx_t tx) {
+    region* reg = (region*) shared;
+    return reg->ops.end(reg->inner, tx);
+}
+
+/** [thread-safe] Read operation in the given transaction, source in the shared region and target in a private region.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in a private region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    region* reg = (region*) shared;
+    return reg->ops.read(reg->inner, tx, source, size, target);
+}
+
+/** [thread-safe] Write operation in the given transaction, source in a private region and target in the shared region.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in a private region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in the shared region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    region* reg = (region*) shared;
+    return reg->ops.write(reg->inner, tx, source, size, target);
+}
+
+/** [thread-safe] Memory allocation in the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param size   Allocation requested size (in bytes), must be a positive multiple of the alignment
+ * @param target Pointer in private memory receiving the address of the first byte of the newly allocated, aligned segment
+ * @return Whether the whole transaction can continue (success/nomem), or not (abort_alloc)
+**/
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void** target) {
+    region* reg = (region*) shared;
+    return reg->ops.alloc(reg->inner, tx, size, target);
+}
+
+/** [thread-safe] Memory freeing in the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Address of the first byte of the previously allocated segment to deallocate
+ * @return Whether the whole transaction can continue
+**/
+bool tm_free(shared_t shared, tx_t tx, void* target) {
+    region* reg = (region*) shared;
+    return reg->ops.free(reg->inner, tx, target);
+}
+
+/** Create a shared memory region held in a new named POSIX shared memory object, if the engine selected by TM_ENGINE has such regions.
+ * @param name     Name of the object (as for 'shm_open'), which must not exist
+ * @param capacity Size of the object (in bytes)
+ * @param size     Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
+ * @param align    Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure or if the engine has no such regions
+**/
+shared_t tm_create_shared(char const* name, size_t capacity, size_t size, size_t align) {
+    engine const* ops = select_engine();
+    if (ops == NULL || ops->create_shared == NULL) return invalid_shared;
+    region* reg = new_region(ops);
+    if (unlikely(reg == NULL)) return invalid_shared;
+    reg->inner = ops->create_shared(name, capacity, size, align);
+    return finish_region(reg);
+}
+
+/** Attach to a shared memory region created by another process with 'tm_create_shared', with the same TM_ENGINE.
+ * @param name Name of the shared memory object
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure or if the engine has no such regions
+**/
+shared_t tm_attach(char const* name) {
+    engine const* ops = select_engine();
+    if (ops == NULL || ops->attach == NULL) return invalid_shared;
+    region* reg = new_region(ops);
+    if (unlikely(reg == NULL)) return invalid_shared;
+    reg->inner = ops->attach(name);
+    return finish_region(reg);
+}
+
+/** Detach the calling process from a shared memory region, leaving it to the other processes.
+ * @param shared Shared memory region, with no running transaction in this process
+**/
+void tm_detach(shared_t shared) {
+    region* reg = (region*) shared;
+    reg->ops.detach(reg->inner);
+    free(reg);
+}
+
+/** Create a shared memory region held in a new memory-mapped file, if the engine selected by TM_ENGINE has such regions.
+ * @param path     Path of the file, which must not exist
+ * @param capacity Size of the file (in bytes)
+ * @param size     Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
+ * @param align    Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure or if the engine has no such regions
+**/
+shared_t tm_create_file(char const* path, size_t capacity, size_t size, size_t align) {
+    engine const* ops = select_engine();
+    if (ops == NULL || ops->create_file == NULL) return invalid_shared;
+    region* reg = new_region(ops);
+    if (unlikely(reg == NULL)) return invalid_shared;
+    reg->inner = ops->create_file(path, capacity, size, align);
+    return finish_region(reg);
+}
+
+/** Open a region created with 'tm_create_file' with the same TM_ENGINE, in the state of its last completed epoch.
+ * @param path Path of the file
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure or if the engine has no such regions
+**/
+shared_t tm_open(char const* path) {
+    engine const* ops = select_engine();
+    if (ops == NULL || ops->open == NULL) return invalid_shared;
+    region* reg = new_region(ops);
+    if (unlikely(reg == NULL)) return invalid_shared;
+    reg->inner = ops->open(path);
+    return finish_region(reg);
+}
+
+/** Close a region created with 'tm_create_file', writing it back to its file.
+ * @param shared Shared memory region, with no running transaction
+**/
+void tm_close(shared_t shared) {
+    region* reg = (region*) shared;
+    reg->ops.close(reg->inner);
+    free(reg);
+}
+
+/** [thread-safe] Checkpoint a region to a file, from which 'tm_restore' rebuilds it, if the engine of the region has checkpoints.
+ * @param shared Shared memory region
+ * @param path   Path of the file
+ * @return Whether the operation is a success, false if the engine has no checkpoints
+**/
+bool tm_checkpoint(shared_t shared, char const* path) {
+    region* reg = (region*) shared;
+    if (reg->ops.checkpoint == NULL)
+        return false;
+    return reg->ops.checkpoint(reg->inner, path);
+}
+
+/** Create a shared memory region from a file written by 'tm_checkpoint' with the same TM_ENGINE.
+ * @param path Path of the file
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure or if the engine has no checkpoints
+**/
+shared_t tm_restore(char const* path) {
+    engine const* ops = select_engine();
+    if (ops == NULL || ops->restore == NULL) return invalid_shared;
+    region* reg = new_region(ops);
+    if (unlikely(reg == NULL)) return invalid_shared;
+    reg->inner = ops->restore(path);
+    return finish_region(reg);
+}
+
+/** [thread-safe] Start replicating a region to a stream, if the engine of the region has replicas.
+ * @param shared Shared memory region
+ * @param fd     Connected Unix socket or pipe, owned by the region on success
+ * @return Whether the operation is a success, false if the engine has no replicas
+**/
+bool tm_replicate(shared_t shared, int fd) {
+    region* reg = (region*) shared;
+    if (reg->ops.replicate == NULL)
+        return false;
+    return reg->ops.replicate(reg->inner, fd);
+}
+
+/** Create a read replica of a region replicated with 'tm_replicate' with the same TM_ENGINE.
+ * @param fd Connected Unix socket or pipe, owned by the region on success
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure or if the engine has no replicas
+**/
+shared_t tm_replica(int fd) {
+    engine const* ops = select_engine();
+    if (ops == NULL || ops->replica == NULL) return invalid_shared;
+    region* reg = new_region(ops);
+    if (unlikely(reg == NULL)) return invalid_shared;
+    reg->inner = ops->replica(fd);
+    return finish_region(reg);
+}
+
+/** [thread-safe] Begin a new read-write transaction that cannot abort, if the engine of the region supports it.
+ * @param shared Shared memory region to start a transaction on
+ * @return Opaque transaction ID, 'invalid_tx' on failure or if the engine has no irrevocable transactions
+**/
+tx_t tm_begin_irrevocable(shared_t shared) {
+    region* reg = (region*) shared;
+    if (reg->ops.begin_irrevocable == NULL)
+        return invalid_tx;
+    return reg->ops.begin_irrevocable(reg->inner);
+}
+
+/** [thread-safe] Begin a new read-write transaction with a declared footprint that cannot abort, an irrevocable one if the engine of the region has no static transactions.
+ * @param shared    Shared memory region to start a transaction on
+ * @param reads     Ranges the transaction only reads (in the shared region)
+ * @param nb_reads  Number of ranges read
+ * @param writes    Ranges the transaction writes, and possibly reads (in the shared region)
+ * @param nb_writes Number of ranges written
+ * @return Opaque transaction ID, 'invalid_tx' on failure or if the engine has neither static nor irrevocable transactions
+**/
+tx_t tm_begin_static(shared_t shared, tm_range const* reads, size_t nb_reads, tm_range const* writes, size_t nb_writes) {
+    region* reg = (region*) shared;
+    if (reg->ops.begin_static != NULL)
+        return reg->ops.begin_static(reg->inner, reads, nb_reads, writes, nb_writes);
+    return tm_begin_irrevocable(shared);
+}
+
+/** [thread-safe] Begin a new transaction with hints on what it does, a plain one if the engine of the region takes no hints.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @param hints  Hints on the transaction, NULL for none
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+**/
+tx_t tm_begin_ex(shared_t shared, bool is_ro, tm_hints const* hints) {
+    region* reg = (region*) shared;
+    if (reg->ops.begin_ex != NULL)
+        return reg->ops.begin_ex(reg->inner, is_ro, hints);
+    return reg->ops.begin(reg->inner, is_ro);
+}
+
+/** [thread-safe] Begin a new transaction, giving up if it is not admitted in time; a plain one, which waits as long
+ * as it takes, if the engine of the region has no timed begins.
+ * @param shared     Shared memory region to start a transaction on
+ * @param is_ro      Whether the transaction is read-only
+ * @param timeout_ns Longest time to wait (in ns)
+ * @return Opaque transaction ID, 'invalid_tx' on failure, with errno set to ETIMEDOUT if it was not admitted in time
+**/
+tx_t tm_begin_timed(shared_t shared, bool is_ro, uint64_t timeout_ns) {
+    region* reg = (region*) shared;
+    if (reg->ops.begin_timed != NULL)
+        return reg->ops.begin_timed(reg->inner, is_ro, timeout_ns);
+    return reg->ops.begin(reg->inner, is_ro);
+}
+
+/**
+ * @brief Transaction run by the engine of a region, whose body is given the region of the selector rather than the engine's.
+ */
+typedef struct run_call {
+    shared_t shared;
+    tm_run_fn fn;
+    void* ctx;
+} run_call;
+
+static bool run_body(shared_t inner, tx_t tx, void* arg) {
+    run_call* call = (run_call*) arg;
+    (void) inner;
+    return call->fn(call->shared, tx, call->ctx);
+}
+
+/** [thread-safe] Run a transaction until it commits, with the retries of the engine of the region if it has its own.
+ * @param shared Shared memory region to run the transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @param fn     Body of the transaction, returning false as soon as one of its operations fails, true to commit
+ * @param ctx    Argument of the body
+ * @return Whether the transaction committed, false if it could not begin
+**/
+bool tm_run(shared_t shared, bool is_ro, tm_run_fn fn, void* ctx) {
+    region* reg = (region*) shared;
+    if (reg->ops.run != NULL) {
+        run_call call = { .shared = shared, .fn = fn, .ctx = ctx };
+        return reg->ops.run(reg->inner, is_ro, run_body, &call);
+    }
+    while (true) {
+        tx_t tx = reg->ops.begin(reg->inner, is_ro);
+        if (tx == invalid_tx)
+            return false;
+        if (fn(shared, tx, ctx) && reg->ops.end(reg->inner, tx))
+            return true;
+    }
+}
+
+/** [thread-safe] Run a transaction until it commits with hints on what it does, as in 'tm_run'; the hints are only
+ * given to the engine of the region if it takes them, either to its own retries or to each hinted begin.
+ * @param shared Shared memory region to run the transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @param hints  Hints on the transaction, NULL for none
+ * @param fn     Body of the transaction, returning false as soon as one of its operations fails, true to commit
+ * @param ctx    Argument of the body
+ * @return Whether the transaction committed, false if it could not begin
+**/
+bool tm_run_ex(shared_t shared, bool is_ro, tm_hints const* hints, tm_run_fn fn, void* ctx) {
+    region* reg = (region*) shared;
+    if (reg->ops.run_ex != NULL) {
+        run_call call = { .shared = shared, .fn = fn, .ctx = ctx };
+        return reg->ops.run_ex(reg->inner, is_ro, hints, run_body, &call);
+    }
+    if (reg->ops.run != NULL || hints == NULL)
+        return tm_run(shared, is_ro, fn, ctx);
+    while (true) {
+        tx_t tx = tm_begin_ex(shared, is_ro, hints);
+        if (tx == invalid_tx)
+            return false;
+        if (fn(shared, tx, ctx) && reg->ops.end(reg->inner, tx))
+            return true;
+    }
+}
+
+/** [thread-safe] Begin a new transaction without waiting for its epoch, a plain one, admitted once begun, if the engine
+ * of the region cannot leave transactions pending.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @param notify Counter incremented each time one of the pending transactions given it is admitted
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+**/
+tx_t tm_begin_async(shared_t shared, bool is_ro, uint32_t* notify) {
+    region* reg = (region*) shared;
+    if (reg->ops.begin_async != NULL)
+        return reg->ops.begin_async(reg->inner, is_ro, notify);
+    return reg->ops.begin(reg->inner, is_ro);
+}
+
+/** [thread-safe] Tell whether a transaction begun with 'tm_begin_async' was admitted into its epoch.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction
+ * @return Whether the transaction was admitted
+**/
+bool tm_admitted(shared_t shared, tx_t tx) {
+    region* reg = (region*) shared;
+    if (reg->ops.admitted != NULL)
+        return reg->ops.admitted(reg->inner, tx);
+    return true;
+}
+
+/** [thread-safe] Wait until a counter given to 'tm_begin_async' differs from the given value.
+ * @param shared Shared memory region of the pending transactions
+ * @param notify Counter
+ * @param seen   Value last returned, 0 at first
+ * @return The value of the counter
+**/
+uint32_t tm_wait_admission(shared_t shared, uint32_t* notify, uint32_t seen) {
+    region* reg = (region*) shared;
+    if (reg->ops.wait_admission != NULL)
+        return reg->ops.wait_admission(reg->inner, notify, seen);
+    return *notify; // No transaction is ever pending
+}
+
+/** [thread-safe] Elastic read operation, a plain read if the engine of the region has no elastic reads.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in a private region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_read_elastic(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    region* reg = (region*) shared;
+    if (reg->ops.read_elastic == NULL)
+        return reg->ops.read(reg->inner, tx, source, size, target);
+    return reg->ops.read_elastic(reg->inner, tx, source, size, target);
+}
+
+/** [thread-safe] Vectored read operation, one plain read per entry if the engine of the region has no vectored reads.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param vec    Entries: source in the shared region, length, target in a private region
+ * @param nb     Number of entries
+ * @return Whether the whole transaction can continue
+**/
+bool tm_readv(shared_t shared, tx_t tx, tm_vec const* vec, size_t nb) {
+    region* reg = (region*) shared;
+    if (reg->ops.readv != NULL)
+        return reg->ops.readv(reg->inner, tx, vec, nb);
+    for (size_t i = 0; i < nb; i++) {
+        if (!reg->ops.read(reg->inner, tx, vec[i].address, vec[i].size, vec[i].buffer))
+            return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Vectored write operation, one plain write per entry if the engine of the region has no vectored writes.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param vec    Entries: target in the shared region, length, source in a private region
+ * @param nb     Number of entries
+ * @return Whether the whole transaction can continue
+**/
+bool tm_writev(shared_t shared, tx_t tx, tm_vec const* vec, size_t nb) {
+    region* reg = (region*) shared;
+    if (reg->ops.writev != NULL)
+        return reg->ops.writev(reg->inner, tx, vec, nb);
+    for (size_t i = 0; i < nb; i++) {
+        if (!reg->ops.write(reg->inner, tx, vec[i].buffer, vec[i].size, vec[i].address))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Size of the private buffer through which copies and fills go when the engine has none (in bytes).
+ */
+#define FALLBACK_BUFFER 4096
+
+/** [thread-safe] Copy operation between two ranges of the shared region, through a private buffer if the engine of the region has no copies.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in the shared region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_copy(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    region* reg = (region*) shared;
+    if (reg->ops.copy != NULL)
+        return reg->ops.copy(reg->inner, tx, source, size, target);
+    uint8_t buffer[FALLBACK_BUFFER];
+    size_t align = reg->ops.align(reg->inner);
+    size_t step = align <= FALLBACK_BUFFER ? FALLBACK_BUFFER - FALLBACK_BUFFER % align : align;
+    uint8_t* chunk = step <= FALLBACK_BUFFER ? buffer : (uint8_t*) malloc(step);
+    if (unlikely(chunk == NULL)) {
+        fprintf(stderr, "Failed to allocate the copy buffer\n");
+        return false;
+    }
+    bool backward = (uintptr_t) target > (uintptr_t) source; // Each chunk is then read before an earlier one overwrites it
+    bool success = true;
+    for (size_t done = 0; success && done < size; done += step) {
+        size_t length = size - done < step ? size - done : step;
+        size_t offset = backward ? size - done - length : done;
+        success = reg->ops.read(reg->inner, tx, (uint8_t const*) source + offset, length, chunk)
+               && reg->ops.write(reg->inner, tx, chunk, length, (uint8_t*) target + offset);
+    }
+    if (chunk != buffer)
+        free(chunk);
+    return success;
+}
+
+/** [thread-safe] Fill operation on a range of the shared region, through a private buffer if the engine of the region has no fills.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Target start address (in the shared region)
+ * @param size   Length to fill (in bytes), must be a positive multiple of the alignment
+ * @param byte   Value of each byte
+ * @return Whether the whole transaction can continue
+**/
+bool tm_fill(shared_t shared, tx_t tx, void* target, size_t size, unsigned char byte) {
+    region* reg = (region*) shared;
+    if (reg->ops.fill != NULL)
+        return reg->ops.fill(reg->inner, tx, target, size, byte);
+    uint8_t buffer[FALLBACK_BUFFER];
+    size_t align = reg->ops.align(reg->inner);
+    size_t step = align <= FALLBACK_BUFFER ? FALLBACK_BUFFER - FALLBACK_BUFFER % align : align;
+    uint8_t* chunk = step <= FALLBACK_BUFFER ? buffer : (uint8_t*) malloc(step);
+    if (unlikely(chunk == NULL)) {
+        fprintf(stderr, "Failed to allocate the fill buffer\n");
+        return false;
+    }
+    memset(chunk, byte, step < size ? step : size);
+    bool success = true;
+    for (size_t done = 0; success && done < size; done += step)
+        success = reg->ops.write(reg->inner, tx, chunk, size - done < step ? size - done : step, (uint8_t*) target + done);
+    if (chunk != buffer)
+        free(chunk);
+    return success;
+}
+
+/** [thread-safe] Add operation on a 64-bit integer of the shared region, as a plain read-modify-write if the engine of the region has no commutative adds.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Address of the integer (in the shared region), aligned on the alignment of the region
+ * @param delta  Value to add, wrapping around on overflow
+ * @return Whether the whole transaction can continue
+**/
+bool tm_add_i64(shared_t shared, tx_t tx, void* target, int64_t delta) {
+    region* reg = (region*) shared;
+    if (reg->ops.add_i64 != NULL)
+        return reg->ops.add_i64(reg->inner, tx, target, delta);
+    uint8_t buffer[FALLBACK_BUFFER];
+    size_t align = reg->ops.align(reg->inner);
+    size_t size = align < sizeof(uint64_t) ? sizeof(uint64_t) : align; // Whole words, the integer in the first 8 bytes
+    uint8_t* word = size <= FALLBACK_BUFFER ? buffer : (uint8_t*) malloc(size);
+    if (unlikely(word == NULL)) {
+        fprintf(stderr, "Failed to allocate the add buffer\n");
+        return false;
+    }
+    bool success = reg->ops.read(reg->inner, tx, target, size, word);
+    if (success) {
+        uint64_t value;
+        memcpy(&value, word, sizeof(value));
+        value += (uint64_t) delta;
+        memcpy(word, &value, sizeof(value));
+        success = reg->ops.write(reg->inner, tx, word, size, target);
+    }
+    if (word != buffer)
+        free(word);
+    return success;
+}